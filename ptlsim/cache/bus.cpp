@@ -193,11 +193,14 @@ bool BusInterconnect::broadcast_cb(void *arg)
 	// if its full the don't broadcast untill it has a free
 	// entry and  pass the queue entry as argument to the broadcast
 	// signal so next time it doesn't need to arbitrate
+	W64 physaddr = queueEntry->request->get_physical_address();
 	bool isFull = false;
 	foreach(i, controllers.count()) {
 		if(controllers[i]->controller ==
 				queueEntry->controllerQueue->controller)
 			continue;
+		if(!controllers[i]->controller->owns_address(physaddr))
+			continue;
 		isFull |= controllers[i]->controller->is_full(true);
 	}
 	if(isFull) {
@@ -216,7 +219,9 @@ bool BusInterconnect::broadcast_cb(void *arg)
 	Controller *controller = queueEntry->controllerQueue->controller;
 
 	foreach(i, controllers.count()) {
-		if(controller != controllers[i]->controller) {
+		/* Slices of a sliced cache only see their own lines */
+		if(controller != controllers[i]->controller &&
+				controllers[i]->controller->owns_address(physaddr)) {
 			bool ret = controllers[i]->controller->
 				get_interconnect_signal()->emit(&message);
 			assert(ret);
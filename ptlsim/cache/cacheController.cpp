@@ -73,6 +73,9 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 	cacheLines_->init();
 
+    setup_slice(&new_stats, cacheLineBits_);
+    cacheLines_->set_slice_stride(slice_set_stride());
+
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
     SET_SIGNAL_CB(name, "_Cache_Miss", cacheMiss_, &CacheController::cache_miss_cb);
@@ -108,6 +111,7 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+    free_slice();
 }
 
 CacheQueueEntry* CacheController::find_dependency(MemoryRequest *request)
@@ -178,9 +182,12 @@ bool CacheController::handle_interconnect_cb(void *arg)
          */
 		if(is_full(true)) {
 			memdebug(get_name() << "Controller queue is full\n");
+			slice_request(pendingRequests_.count(), false);
 			return false;
 		}
 
+		slice_request(pendingRequests_.count(), true);
+
 		memdebug(get_name() <<
 				" Received message from upper interconnect\n");
 
@@ -542,6 +549,12 @@ bool CacheController::cache_access_cb(void *arg)
 		CacheLine *line = cacheLines_->probe(queueEntry->request);
 		bool hit = (line == NULL) ? false : line->state;
 
+		/* Retries below come back here, the shadows count a request once */
+		if(!queueEntry->shadowAccessed) {
+			access_shadow_caches(queueEntry->request);
+			queueEntry->shadowAccessed = true;
+		}
+
 		// Testing 100 % L2 Hit
         //		if(type_ == L2_CACHE)
         //			hit = true;
@@ -901,6 +914,8 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 	YAML_KEY_VAL(out, "config", (wt_disabled_ ? "writeback" : "writethrough"));
 
+	dump_slice_configuration(out);
+
 	out << YAML::EndMap;
 }
 
@@ -80,6 +80,7 @@ struct CacheQueueEntry : public FixStateListObject
 		bool annuled;
 		bool prefetch;
 		bool prefetchCompleted;
+		bool shadowAccessed;
 
 		void init() {
 			request = NULL;
@@ -93,6 +94,7 @@ struct CacheQueueEntry : public FixStateListObject
 			annuled = false;
 			prefetch = false;
 			prefetchCompleted = false;
+			shadowAccessed = false;
 		}
 
 		ostream& print(ostream& os) const {
@@ -235,6 +237,10 @@ class CacheController : public Controller
 			wt_disabled_ = flag;
 		}
 
+		CacheLinesBase* get_cache_lines() {
+			return cacheLines_;
+		}
+
 		void print(ostream& os) const;
 
 		bool is_full(bool fromInterconnect = false) const {
@@ -29,6 +29,7 @@
 #define CACHE_LINES_H
 
 #include <logic.h>
+#include <arena.h>
 
 namespace Memory {
 
@@ -74,8 +75,11 @@ namespace Memory {
     struct CacheLinesBase
     {
         public:
+            MACHINE_ARENA_ALLOCATED
+
             virtual void init()=0;
             virtual W64 tagOf(W64 address)=0;
+            virtual void set_slice_stride(int stride)=0;
             virtual int latency() const =0;
             virtual CacheLine* probe(MemoryRequest *request)=0;
             virtual CacheLine* insert(MemoryRequest *request,
@@ -102,6 +106,7 @@ namespace Memory {
             int readPorts_;
             int writePorts_;
             W64 lastAccessCycle_;
+            int sliceStride_;
 
         public:
             typedef AssociativeArray<W64, CacheLine, SET_COUNT,
@@ -113,6 +118,8 @@ namespace Memory {
             CacheLines(int readPorts, int writePorts);
             void init();
             W64 tagOf(W64 address);
+            int setOf(W64 address) const;
+            void set_slice_stride(int stride) { sliceStride_ = stride; }
             int latency() const { return LATENCY; };
             CacheLine* probe(MemoryRequest *request);
             CacheLine* insert(MemoryRequest *request, W64& oldTag);
@@ -188,6 +195,7 @@ namespace Memory {
             readPorts_(readPorts)
             , writePorts_(writePorts)
     {
+        sliceStride_ = 1;
         lastAccessCycle_ = 0;
         readPortUsed_ = 0;
         writePortUsed_ = 0;
@@ -210,13 +218,25 @@ namespace Memory {
             return floor(address, LINE_SIZE);
         }
 
+    /* Set index of an address, a slice skips the lines of the other slices */
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
+        int CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::setOf(W64 address) const
+        {
+            if likely (sliceStride_ == 1)
+                return base_t::setof(address);
+
+            W64 line = (address >> log2(LINE_SIZE)) / sliceStride_;
+            return lowbits(line, log2(SET_COUNT));
+        }
+
 
     // Return true if valid line is found, else return false
     template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
         CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::probe(MemoryRequest *request)
         {
             W64 physAddress = request->get_physical_address();
-            CacheLine *line = base_t::probe(physAddress);
+            CacheLine *line = base_t::sets[setOf(physAddress)].probe(
+                    base_t::tagof(physAddress));
 
             return line;
         }
@@ -225,7 +245,8 @@ namespace Memory {
         CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::insert(MemoryRequest *request, W64& oldTag)
         {
             W64 physAddress = request->get_physical_address();
-            CacheLine *line = base_t::select(physAddress, oldTag);
+            CacheLine *line = base_t::sets[setOf(physAddress)].select(
+                    base_t::tagof(physAddress), oldTag);
 
             return line;
         }
@@ -233,7 +254,9 @@ namespace Memory {
     template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
         int CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::invalidate(MemoryRequest *request)
         {
-            return base_t::invalidate(request->get_physical_address());
+            W64 physAddress = request->get_physical_address();
+            return base_t::sets[setOf(physAddress)].invalidate(
+                    base_t::tagof(physAddress));
         }
 
 
@@ -50,6 +50,7 @@ CacheController::CacheController(W8 coreid, const char *name,
     , isLowestPrivate_(false)
     , directory_(NULL)
     , lowerCont_(NULL)
+    , notifyCore_(false)
     , coherence_logic_(NULL)
 {
     memoryHierarchy_->add_cache_mem_controller(this);
@@ -66,6 +67,9 @@ CacheController::CacheController(W8 coreid, const char *name,
 
     cacheLines_->init();
 
+    setup_slice(new_stats, cacheLineBits_);
+    cacheLines_->set_slice_stride(slice_set_stride());
+
 
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
@@ -92,6 +96,7 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+    free_slice();
     delete new_stats;
 }
 
@@ -168,9 +173,12 @@ bool CacheController::handle_upper_interconnect(Message &message)
     /* set full flag if buffer is full */
     if(is_full()) {
         memoryHierarchy_->set_controller_full(this, true);
+        slice_request(pendingRequests_.count(), false);
         return false;
     }
 
+    slice_request(pendingRequests_.count(), true);
+
     CacheQueueEntry *queueEntry = pendingRequests_.alloc();
 
     if(queueEntry == NULL) {
@@ -180,7 +188,7 @@ bool CacheController::handle_upper_interconnect(Message &message)
     queueEntry->request = message.request;
     queueEntry->sender  = (Interconnect*)message.sender;
     queueEntry->isSnoop = false;
-    queueEntry->m_arg   = message.arg;
+    queueEntry->set_arg(message);
     queueEntry->source  = (Controller*)message.origin;
     queueEntry->dest    = (Controller*)message.dest;
     queueEntry->request->incRefCounter();
@@ -219,7 +227,7 @@ bool CacheController::handle_lower_interconnect(Message &message)
             " Received message from lower interconnect\n");
 
     CacheQueueEntry *queueEntry = find_match(message.request);
-    if(queueEntry) queueEntry->m_arg = message.arg;
+    if(queueEntry) queueEntry->set_arg(message);
 
     if (queueEntry && queueEntry->annuled)
         return true;
@@ -265,7 +273,7 @@ bool CacheController::handle_lower_interconnect(Message &message)
                 evictEntry->request = message.request;
                 evictEntry->request->incRefCounter();
                 evictEntry->isSnoop = true;
-                evictEntry->m_arg   = message.arg;
+                evictEntry->set_arg(message);
                 evictEntry->eventFlags[CACHE_ACCESS_EVENT]++;
                 marss_add_event(&cacheAccess_, 1,
                         evictEntry);
@@ -376,6 +384,9 @@ bool CacheController::complete_request(Message &message,
 
         queueEntry->line = line;
         handle_cache_insert(queueEntry, oldTag);
+
+        if (oldTag != InvalidTag<W64>::INVALID && oldTag != (W64)-1)
+            line_invalidated(oldTag);
         queueEntry->line->init(cacheLines_->tagOf(queueEntry->
                     request->get_physical_address()));
     }
@@ -460,6 +471,7 @@ void CacheController::register_interconnect(Interconnect *interconnect,
     switch(type) {
         case INTERCONN_TYPE_UPPER:
             upperInterconnect_ = interconnect;
+            find_core_port(interconnect);
             break;
         case INTERCONN_TYPE_UPPER2:
             upperInterconnect2_ = interconnect;
@@ -505,6 +517,21 @@ void CacheController::get_directory(Interconnect *interconn)
     }
 }
 
+void CacheController::find_core_port(Interconnect *interconn)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    foreach (i, machine.connections.count()) {
+        ConnectionDef *conn_def = machine.connections[i];
+
+        if (strcmp(conn_def->name.buf, interconn->get_name()) == 0) {
+            foreach (j, conn_def->connections.count()) {
+                if (conn_def->connections[j]->type == INTERCONN_TYPE_D)
+                    notifyCore_ = true;
+            }
+        }
+    }
+}
+
 void CacheController::register_upper_interconnect(Interconnect *interconnect)
 {
     upperInterconnect_ = interconnect;
@@ -536,7 +563,14 @@ bool CacheController::cache_hit_cb(void *arg)
              * free queue entries we delay this by 2 cycles */
             marss_add_event(&cacheHit_, 2, queueEntry);
         } else {
+            /* The entry may be freed by the coherence logic */
+            CacheLine *line = queueEntry->line;
+            W64 lineaddr = queueEntry->request->get_physical_address();
+
             coherence_logic_->handle_interconn_hit(queueEntry);
+
+            if (!coherence_logic_->is_line_valid(line))
+                line_invalidated(lineaddr);
         }
     } else {
         coherence_logic_->handle_local_hit(queueEntry);
@@ -555,8 +589,10 @@ bool CacheController::cache_miss_cb(void *arg)
 
     if(queueEntry->request->get_type() == MEMORY_OP_EVICT &&
             !is_lowest_private()) {
-        if(queueEntry->line)
+        if(queueEntry->line) {
             coherence_logic_->invalidate_line(queueEntry->line);
+            line_invalidated(queueEntry->request->get_physical_address());
+        }
         clear_entry_cb(queueEntry);
         return true;
     }
@@ -639,6 +675,9 @@ bool CacheController::cache_access_cb(void *arg)
         CacheLine *line	= cacheLines_->probe(queueEntry->request);
         queueEntry->line = line;
 
+        if (!queueEntry->isSnoop)
+            access_shadow_caches(queueEntry->request);
+
         if(line) hit = true;
         else hit = false;
 
@@ -719,8 +758,12 @@ bool CacheController::wait_interconnect_cb(void *arg)
     message.dest     = queueEntry->dest;
     bool success     = false;
 
-    if (queueEntry->line) message.arg = &(queueEntry->line->state);
-    else message.arg = NULL;
+    if (queueEntry->line) {
+        message.arg = &(queueEntry->line->state);
+        message.argIsState = true;
+    } else {
+        message.arg = NULL;
+    }
 
     if(queueEntry->sendTo == upperInterconnect_ ||
             queueEntry->sendTo == upperInterconnect2_) {
@@ -885,6 +928,7 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "latency", cacheLines_->get_access_latency());
 	YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 
+	dump_slice_configuration(out);
 	coherence_logic_->dump_configuration(out);
 
 	out << YAML::EndMap;
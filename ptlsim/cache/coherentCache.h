@@ -76,6 +76,7 @@ namespace Memory {
                 Controller    *dest;
                 CacheLine     *line;
                 void *m_arg;
+                W32 m_state; /* copy of the sender's line state */
                 bool annuled;
                 bool evicting;
                 bool isSnoop;
@@ -88,6 +89,7 @@ namespace Memory {
                     sendTo       = NULL;
                     line         = NULL;
                     m_arg        = NULL;
+                    m_state      = 0;
                     depends      = -1;
                     waitFor      = -1;
                     dependsAddr  = -1;
@@ -111,10 +113,21 @@ namespace Memory {
                     sendTo = ent->sendTo;
                     dest = ent->dest;
                     source = ent->source;
-                    m_arg = ent->m_arg;
+                    m_state = ent->m_state;
+                    m_arg = (ent->m_arg == &ent->m_state) ? &m_state :
+                        ent->m_arg;
                     request->incRefCounter();
                 }
 
+                void set_arg(const Message& message) {
+                    if (message.argIsState) {
+                        m_state = *(W8*)message.arg;
+                        m_arg = &m_state;
+                    } else {
+                        m_arg = message.arg;
+                    }
+                }
+
                 ostream& print(ostream& os) const {
                     if(!request) {
                         os << "Free Request Entry";
@@ -190,6 +203,10 @@ namespace Memory {
                 Controller *directory_;
                 Controller *lowerCont_;
 
+                // Set when the upper interconnect is a core's data port, the
+                // core is then told about every line this cache loses
+                bool notifyCore_;
+
                 // All signals of cache
                 Signal clearEntry_;
                 Signal cacheHit_;
@@ -228,6 +245,13 @@ namespace Memory {
                         *queueEntry);
 
                 void get_directory(Interconnect *interconn);
+                void find_core_port(Interconnect *interconn);
+
+                void line_invalidated(W64 lineaddr) {
+                    if unlikely (notifyCore_)
+                        memoryHierarchy_->line_invalidated(idx, lineaddr,
+                                cacheLineBits_);
+                }
 
             public:
                 CacheController(W8 coreid, const char *name,
@@ -30,7 +30,9 @@
 
 #include <globals.h>
 #include <superstl.h>
+#include <arena.h>
 #include <memoryRequest.h>
+#include <llcSlice.h>
 
 namespace Memory {
 
@@ -44,6 +46,9 @@ struct Message : public FixStateListObject {
 	bool hasData;
 	bool isShared;
 	void *arg;
+	/* arg points to the sender's cache line state, which can change once
+	 * the message is sent, so a receiver keeps a copy of the value */
+	bool argIsState;
 
 	ostream& print(ostream& os) const {
 		if(sender == NULL) {
@@ -67,6 +72,7 @@ struct Message : public FixStateListObject {
 		request = NULL;
 		hasData = false;
 		arg = NULL;
+		argIsState = false;
         isShared = 0;
 	}
 };
@@ -77,6 +83,8 @@ static inline ostream& operator <<(ostream& os, const Message& msg)
 }
 
 class MemoryHierarchy;
+class ShadowCache;
+struct SliceStats;
 
 class Controller
 {
@@ -84,11 +92,25 @@ class Controller
         stringbuf name_;
 		Signal handle_interconnect_;
 		bool isPrivate_;
+		dynarray<ShadowCache*> shadowCaches_;
+
+		void update_shadow_caches(MemoryRequest *request);
+
+		/* Position in a sliced cache, sliceCount_ is 1 otherwise */
+		W8 sliceId_;
+		W8 sliceCount_;
+		W8 sliceHash_;
+		W8 sliceLineBits_;
+		SliceStats *sliceStats_;
+
+		void update_slice_stats(int pending, bool accepted);
 
 	public:
 		MemoryHierarchy *memoryHierarchy_;
 		W8 idx;
 
+		MACHINE_ARENA_ALLOCATED
+
 		Controller(W8 coreid, const char *name,
 				MemoryHierarchy *memoryHierarchy)
 			: handle_interconnect_("handle_interconnect")
@@ -98,6 +120,12 @@ class Controller
 			name_ << name;
 			isPrivate_ = false;
 
+			sliceId_ = 0;
+			sliceCount_ = 1;
+			sliceHash_ = SLICE_HASH_MODULO;
+			sliceLineBits_ = 6;
+			sliceStats_ = NULL;
+
 			handle_interconnect_.connect(signal_mem_ptr \
 					(*this, &Controller::handle_interconnect_cb));
 		}
@@ -139,6 +167,52 @@ class Controller
 
 		bool is_private() { return isPrivate_; }
 
+		void add_shadow_cache(ShadowCache *shadow) {
+			shadowCaches_.push(shadow);
+		}
+
+		/* Make this a slice if it has a 'slice_hash' option */
+		void setup_slice(Statable *stats_parent, int line_bits);
+
+		/* Free the slice stats, before their parent stats go away */
+		void free_slice();
+
+		bool is_slice() const { return sliceCount_ > 1; }
+
+		/* True if this controller keeps the line of 'physaddr' */
+		bool owns_address(W64 physaddr) const {
+			if likely (sliceCount_ <= 1)
+				return true;
+			return get_slice(physaddr, sliceLineBits_, sliceCount_,
+					sliceHash_) == sliceId_;
+		}
+
+		/*
+		 * 'modulo' slices own every n-th line, their set index skips the
+		 * slice select bits so all sets are used
+		 */
+		int slice_set_stride() const {
+			return (sliceCount_ > 1 && sliceHash_ == SLICE_HASH_MODULO) ?
+				sliceCount_ : 1;
+		}
+
+		/* True if 'other' is a slice of the same cache as this one */
+		bool same_sliced_cache(const Controller *other) const;
+
+		void dump_slice_configuration(YAML::Emitter &out) const;
+
+		/* Account a request from above, 'pending' is the queue length */
+		void slice_request(int pending, bool accepted) {
+			if unlikely (sliceStats_)
+				update_slice_stats(pending, accepted);
+		}
+
+		/* Let the shadow caches following this cache see 'request' */
+		void access_shadow_caches(MemoryRequest *request) {
+			if unlikely (shadowCaches_.count())
+				update_shadow_caches(request);
+		}
+
 };
 
 static inline ostream& operator <<(ostream& os, const Controller&
@@ -171,6 +171,9 @@ int CPUController::access_fast_path(Interconnect *interconnect,
 			fastPathLat = int_L1_d_->access_fast_path(this, request);
             N_STAT_UPDATE(stats.dcache_latency, [fastPathLat]++, kernel_req);
 		}
+
+        if(fastPathLat < 0 && request->get_type() != MEMORY_OP_WRITE)
+            memoryHierarchy_->l1_read_miss(request);
 	}
 
     if unlikely (fastPathLat == 0)
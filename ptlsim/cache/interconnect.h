@@ -49,6 +49,9 @@ class Interconnect
 
 	public:
 		MemoryHierarchy *memoryHierarchy_;
+
+		MACHINE_ARENA_ALLOCATED
+
 		Interconnect(const char *name, MemoryHierarchy *memoryHierarchy)
 			: controller_request_("Controller Request")
 			, memoryHierarchy_(memoryHierarchy)
@@ -0,0 +1,132 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <memoryStats.h>
+#include <controller.h>
+#include <llcSlice.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+/*
+ * Physical address bits XORed into each slice index bit, as reverse
+ * engineered for Intel's LLC complex addressing (Maurice et al., RAID 2015).
+ */
+static const W64 slice_xor_masks[3] = {
+    0x1b5f575440ULL,
+    0x2eb5faa880ULL,
+    0x3cccc93100ULL,
+};
+
+int Memory::get_slice(W64 physaddr, int line_bits, int slices, int hash)
+{
+    if (hash == SLICE_HASH_XOR) {
+        int slice = 0;
+        for (int i = 0; (1 << i) < slices; i++) {
+            slice |= (popcount64(physaddr & slice_xor_masks[i]) & 1) << i;
+        }
+        return slice;
+    }
+
+    return (physaddr >> line_bits) % slices;
+}
+
+void Controller::setup_slice(Statable *stats_parent, int line_bits)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    stringbuf hash;
+    if (!machine.get_option(get_name(), "slice_hash", hash))
+        return;
+
+    int slices = 1;
+    machine.get_option(get_name(), "slices", slices);
+
+    if (strcmp(hash.buf, "modulo") == 0) {
+        sliceHash_ = SLICE_HASH_MODULO;
+    } else if (strcmp(hash.buf, "xor") == 0) {
+        sliceHash_ = SLICE_HASH_XOR;
+    } else {
+        stringbuf err;
+        err << "::ERROR::Unknown slice_hash '" << hash << "' for " <<
+            get_name() << ", use 'modulo' or 'xor'" << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(0);
+    }
+
+    if (sliceHash_ == SLICE_HASH_XOR && slices != 2 && slices != 4 &&
+            slices != 8) {
+        stringbuf err;
+        err << "::ERROR::" << get_name() << " has " << slices <<
+            " slices, slice_hash 'xor' needs 2, 4 or 8" << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(0);
+    }
+
+    if (slices <= 1)
+        return;
+
+    assert(slices < 256 && idx < slices);
+
+    sliceId_ = idx;
+    sliceCount_ = slices;
+    sliceLineBits_ = line_bits;
+    sliceStats_ = new SliceStats("slice", stats_parent);
+}
+
+void Controller::free_slice()
+{
+    delete sliceStats_;
+    sliceStats_ = NULL;
+}
+
+static int name_prefix_length(const char *name)
+{
+    int len = strlen(name);
+    while (len > 0 && isdigit(name[len - 1])) len--;
+    return len;
+}
+
+bool Controller::same_sliced_cache(const Controller *other) const
+{
+    if (!is_slice() || other->sliceCount_ != sliceCount_ ||
+            other->sliceHash_ != sliceHash_) {
+        return false;
+    }
+
+    int len = name_prefix_length(get_name());
+    return (name_prefix_length(other->get_name()) == len &&
+            strncmp(get_name(), other->get_name(), len) == 0);
+}
+
+void Controller::dump_slice_configuration(YAML::Emitter &out) const
+{
+    if (!is_slice())
+        return;
+
+    YAML_KEY_VAL(out, "slice", (int)sliceId_);
+    YAML_KEY_VAL(out, "slices", (int)sliceCount_);
+    YAML_KEY_VAL(out, "slice_hash",
+            (sliceHash_ == SLICE_HASH_XOR ? "xor" : "modulo"));
+}
+
+void Controller::update_slice_stats(int pending, bool accepted)
+{
+    if (!accepted) {
+        sliceStats_->queue_full++;
+        return;
+    }
+
+    sliceStats_->requests++;
+    sliceStats_->occupancy += pending;
+}
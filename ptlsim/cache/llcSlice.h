@@ -0,0 +1,41 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Sliced shared caches. All instances of a cache entry that has a
+ * 'slice_hash' option form one cache: instance i only keeps the lines that
+ * hash to slice i, and has its own ports, pending queue and stats. The bus
+ * hands a request only to the owning slice and the switch redirects it
+ * there, so the slices can sit on either one:
+ *
+ *   caches:
+ *     - type: l2_2M_slice
+ *       name_prefix: L2_
+ *       insts: 4
+ *       option:
+ *           slice_hash: xor   # or 'modulo'
+ *
+ * 'modulo' takes the line address modulo the number of slices. 'xor' uses
+ * the published address hash of Intel's sliced LLC, each slice index bit is
+ * the parity of a set of physical address bits; it needs 2, 4 or 8 slices.
+ */
+
+#ifndef LLC_SLICE_H
+#define LLC_SLICE_H
+
+#include <globals.h>
+
+namespace Memory {
+
+    enum SliceHash {
+        SLICE_HASH_MODULO,
+        SLICE_HASH_XOR,
+    };
+
+    int get_slice(W64 physaddr, int line_bits, int slices, int hash);
+
+};
+
+#endif // LLC_SLICE_H
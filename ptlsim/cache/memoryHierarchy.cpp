@@ -49,6 +49,13 @@
 
 using namespace Memory;
 
+/*
+ * Submission ring of the core running its cycle on this host thread, -1
+ * outside of the core pipelines. Events added while it is set go into that
+ * ring (see merge_submitted_events()).
+ */
+static __thread int submitting_core = -1;
+
 MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
   machine_(machine)
   , someStructIsFull_(false)
@@ -59,6 +66,9 @@ MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
     RequestPool* pool = new RequestPool();
     requestPool_.push(pool);
   }
+
+  lineInvalidateSignals_.resize(NUM_SIM_CORES, NULL);
+  threadContexts_.resize(NUM_SIM_CORES * MAX_CONTEXTS, NULL);
 }
 
 MemoryHierarchy::~MemoryHierarchy()
@@ -90,6 +100,8 @@ bool MemoryHierarchy::access_cache(MemoryRequest *request)
 
 void MemoryHierarchy::clock()
 {
+  merge_submitted_events();
+
   // First clock all the cpu controllers
   foreach(i, cpuControllers_.count()) {
     CPUController *cpuController = (CPUController*)(
@@ -113,6 +125,54 @@ void MemoryHierarchy::clock()
 void MemoryHierarchy::reset()
 {
   eventQueue_.reset();
+  foreach(i, NUM_SIM_CORES) {
+    submitRings_[i].reset();
+    submitOverflow_[i].clear();
+  }
+}
+
+void MemoryHierarchy::begin_core_cycle(int coreid)
+{
+  assert(coreid >= 0 && coreid < NUM_SIM_CORES);
+
+  if (config.mem_event_rings)
+    submitting_core = coreid;
+}
+
+void MemoryHierarchy::end_core_cycle()
+{
+  submitting_core = -1;
+}
+
+/*
+ * Move the events submitted by cores into the event queue. Rings are always
+ * drained in core id order and the queue keeps events of the same cycle in
+ * insertion order, so the result does not depend on when each core ran. A
+ * core's overflow holds events it added after its ring filled up, they go
+ * in after the ring's. Only called from clock(), while no core runs.
+ */
+void MemoryHierarchy::merge_submitted_events()
+{
+  SubmittedEvent submitted;
+
+  foreach(i, NUM_SIM_CORES) {
+    while(submitRings_[i].pop(submitted))
+      add_submitted_event(submitted);
+
+    foreach(j, submitOverflow_[i].size())
+      add_submitted_event(submitOverflow_[i][j]);
+
+    submitOverflow_[i].clear();
+  }
+}
+
+void MemoryHierarchy::add_submitted_event(const SubmittedEvent& submitted)
+{
+  Event *event = eventQueue_.alloc();
+  assert(event);
+  event->setup(submitted.signal, submitted.clock, submitted.arg);
+  memdebug("Adding submitted event:" << *event);
+  sort_event_queue(event);
 }
 
 int MemoryHierarchy::flush(uint8_t coreid)
@@ -300,6 +360,20 @@ void MemoryHierarchy::sort_event_queue_tail(Event *event)
 
 void MemoryHierarchy::add_event(Signal *signal, int delay, void *arg)
 {
+  if(submitting_core >= 0 && delay > 0) {
+    SubmittedEvent submitted = {signal, sim_cycle + delay, arg};
+    dynarray<SubmittedEvent>& overflow = submitOverflow_[submitting_core];
+
+    /* Once the ring was full, later events queue behind it in the overflow
+     * until clock() drains both */
+    if likely (!overflow.size() &&
+        submitRings_[submitting_core].push(submitted))
+      return;
+
+    overflow.push(submitted);
+    return;
+  }
+
   Event *event = eventQueue_.alloc();
   if(eventQueue_.count() == 1)
     assert(event == eventQueue_.head());
@@ -30,6 +30,7 @@
 
 #include <globals.h>
 #include <superstl.h>
+#include <arena.h>
 
 #include <ptlsim.h>
 #include <machine.h>
@@ -73,14 +74,14 @@
 #endif
 
 #define GET_STRINGBUF_PTR(var_name, ...)  \
-  stringbuf *var_name = new stringbuf(); \
+  stringbuf *var_name = machine_arena.track(new (machine_arena) stringbuf()); \
 *var_name << __VA_ARGS__; \
 
 #define SET_SIGNAL_CB(name, name_postfix, signal, cb) \
 { \
-  stringbuf *sg_n = new stringbuf(); \
-  *sg_n << name, name_postfix; \
-  signal.set_name(sg_n->buf); \
+  stringbuf sg_n; \
+  sg_n << name, name_postfix; \
+  signal.set_name(sg_n.buf); \
   signal.connect(signal_mem_ptr(*this, cb)); \
 }
 
@@ -168,6 +169,12 @@ namespace Memory {
 
   extern MemoryInterlockBuffer interlocks;
 
+  // Argument of the line invalidate signal, line_bits is the L1-D line size
+  struct LineInvalidation {
+    W64 lineaddr;
+    int line_bits;
+  };
+
   //
   // MemoryHierarchy provides interface with core
   //
@@ -200,8 +207,42 @@ namespace Memory {
           bool is_icache,
           bool is_write);
 
+      // Cores that replay loads on coherence activity register a signal
+      // here, the L1-D emits it with a LineInvalidation when it loses a line
+      void set_line_invalidate_signal(W8 coreid, Signal *signal) {
+        lineInvalidateSignals_[coreid] = signal;
+      }
+
+      void line_invalidated(W8 coreid, W64 lineaddr, int line_bits) {
+        if unlikely (lineInvalidateSignals_[coreid]) {
+          LineInvalidation inv = {lineaddr, line_bits};
+          lineInvalidateSignals_[coreid]->emit((void*)&inv);
+        }
+      }
+
+      // Cores register the Context of each thread so that L1 misses can be
+      // counted for the context that issued the request
+      void set_thread_context(W8 coreid, W8 threadid, Context *ctx) {
+        threadContexts_[coreid * MAX_CONTEXTS + threadid] = ctx;
+      }
+
+      void l1_read_miss(MemoryRequest *request) {
+        Context *ctx = threadContexts_[request->get_coreid() * MAX_CONTEXTS +
+          request->get_threadid()];
+        if likely (ctx)
+          ctx->l1_read_misses++;
+      }
+
       void clock();
 
+      // Events with a delay that a core adds between these two calls go
+      // through its submission ring when -mem-event-rings is set. Accesses
+      // still run the controllers inline, and events without delay still
+      // execute at once, so the core phase is not isolated from the rest
+      // of the hierarchy yet.
+      void begin_core_cycle(int coreid);
+      void end_core_cycle();
+
       void reset();
 
       // return the number of cycle used to flush the caches
@@ -276,12 +317,36 @@ namespace Memory {
       // Request pool
       dynarray<RequestPool*> requestPool_;
 
+      // Per core signal for L1-D line invalidations, NULL if unused
+      dynarray<Signal*> lineInvalidateSignals_;
+
+      // Context of each core's threads, indexed by coreid * MAX_CONTEXTS +
+      // threadid
+      dynarray<Context*> threadContexts_;
+
       // Message pool
       FixStateList<Message, 128> messageQueue_;
 
       // Event Queue
       FixStateList<Event, 2048> eventQueue_;
 
+      // Events added by cores during their cycle. Each core owns one ring,
+      // and clock() merges them into eventQueue_ in core order, which is the
+      // order they were issued in serial mode. When its ring is full a core
+      // appends to its own overflow list until clock() drained it, so the
+      // ring keeps a single producer and a single consumer.
+      struct SubmittedEvent {
+        Signal *signal;
+        W64    clock;
+        void   *arg;
+      };
+
+      SPSCRing<SubmittedEvent, 256> submitRings_[NUM_SIM_CORES];
+      dynarray<SubmittedEvent> submitOverflow_[NUM_SIM_CORES];
+
+      void merge_submitted_events();
+      void add_submitted_event(const SubmittedEvent& submitted);
+
       void sort_event_queue(Event *event);
       void sort_event_queue_tail(Event *event);
 
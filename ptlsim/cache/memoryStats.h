@@ -161,6 +161,51 @@ struct CPUControllerStats : public BaseCacheStats
     { }
 };
 
+struct ShadowCacheStats : public Statable
+{
+    struct access_sub : public Statable
+    {
+        StatObj<W64> read;
+        StatObj<W64> write;
+
+        access_sub(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , read("read", this)
+              , write("write", this)
+        {}
+    };
+
+    access_sub hit;
+    access_sub miss;
+    StatObj<W64> evict;
+
+    ShadowCacheStats(const char *name, Statable *parent=NULL)
+        : Statable(name, parent)
+          , hit("hit", this)
+          , miss("miss", this)
+          , evict("evict", this)
+    {}
+};
+
+struct SliceStats : public Statable
+{
+    StatObj<W64> requests;
+    StatObj<W64> queue_full;
+    StatObj<W64> occupancy;
+    StatEquation<W64, double, StatObjFormulaDiv> avg_occupancy;
+
+    SliceStats(const char *name, Statable *parent=NULL)
+        : Statable(name, parent)
+          , requests("requests", this)
+          , queue_full("queue_full", this)
+          , occupancy("occupancy", this)
+          , avg_occupancy("avg_occupancy", this)
+    {
+        avg_occupancy.add_elem(&occupancy);
+        avg_occupancy.add_elem(&requests);
+    }
+};
+
 static const char* mesi_state_names[4] = {
     "Modified", "Exclusive", "Shared", "Invalid"
 };
@@ -53,6 +53,22 @@ P2PInterconnect::P2PInterconnect(const char *name,
 	controllers_[1] = NULL;
 
     memoryHierarchy->add_interconnect(this);
+
+    SET_SIGNAL_CB(name, "_deliver", deliver_, &P2PInterconnect::deliver_cb);
+
+    BaseMachine &machine = memoryHierarchy->get_machine();
+
+    if (!machine.get_option(name, "latency", latency_))
+        latency_ = 0;
+
+    if (!machine.get_option(name, "width_bytes", widthBytes_))
+        widthBytes_ = 0;
+
+    if (!machine.get_option(name, "queue_size", queueSize_))
+        queueSize_ = 16;
+
+    assert(latency_ >= 0 && widthBytes_ >= 0);
+    queueSize_ = max(1, min(queueSize_, P2P_MAX_QUEUE_SIZE));
 }
 
 /**
@@ -67,9 +83,11 @@ void P2PInterconnect::register_controller(Controller *controller)
 {
 	if(controllers_[0] == NULL) {
 		controllers_[0] = controller;
+		links_[1].receiver = controller;
 		return;
 	} else if(controllers_[1] == NULL) {
 		controllers_[1] = controller;
+		links_[0].receiver = controller;
 		return;
 	}
 
@@ -79,28 +97,25 @@ void P2PInterconnect::register_controller(Controller *controller)
 }
 
 /**
- * @brief Controller Request entry point
+ * @brief Pass a message to the controller at the other end
  *
- * @param arg Message sent from Controller containing request
+ * @param receiver Controller receiving the message
+ * @param request Memory Request
+ * @param hasData Message carries a cache line
+ * @param arg Sender's argument
+ * @param argIsState arg points to a cache line state
  *
- * @return True if message is successfully forwared else False
+ * @return True if receiver accepted the message
  */
-bool P2PInterconnect::controller_request_cb(void *arg)
+bool P2PInterconnect::forward(Controller *receiver, MemoryRequest *request,
+		bool hasData, void *arg, bool argIsState)
 {
-    /*
-     * P2P is 0 latency interconnect so directly
-     * pass it to next controller
-     */
-	Message *msg = (Message*)arg;
-
-	Controller *receiver = get_other_controller(
-			(Controller*)msg->sender);
-
 	Message& message = *memoryHierarchy_->get_message();
 	message.sender = (void *)this;
-	message.request = msg->request;
-	message.hasData = msg->hasData;
-	message.arg = msg->arg;
+	message.request = request;
+	message.hasData = hasData;
+	message.arg = arg;
+	message.argIsState = argIsState;
 
 	bool ret_val;
 	ret_val = receiver->get_interconnect_signal()->emit((void *)&message);
@@ -109,7 +124,120 @@ bool P2PInterconnect::controller_request_cb(void *arg)
 	memoryHierarchy_->free_message(&message);
 
 	return ret_val;
+}
+
+/**
+ * @brief Controller Request entry point
+ *
+ * @param arg Message sent from Controller containing request
+ *
+ * @return True if message is successfully forwared or queued else False
+ */
+bool P2PInterconnect::controller_request_cb(void *arg)
+{
+	Message *msg = (Message*)arg;
+
+	Controller *sender = (Controller*)msg->sender;
+	Controller *receiver = get_other_controller(sender);
+
+	if (!is_timed())
+		return forward(receiver, msg->request, msg->hasData, msg->arg,
+				msg->argIsState);
+
+	P2PLink &link = get_link(sender);
+
+	if (link.queue.count() >= queueSize_)
+		return false;
+
+	P2PQueueEntry *entry = link.queue.alloc();
+	entry->request = msg->request;
+	entry->arg = msg->arg;
+	entry->hasData = msg->hasData;
 
+	/* The line can change before delivery, send the state it had now */
+	entry->argIsState = msg->argIsState;
+	if (msg->argIsState)
+		entry->state = *(W8*)msg->arg;
+
+	entry->request->incRefCounter();
+	ADD_HISTORY_ADD(entry->request);
+
+	/* The wires are busy for one cycle per flit */
+	int flits = 1;
+	if (msg->hasData && widthBytes_ > 0)
+		flits = (P2P_LINE_BYTES + widthBytes_ - 1) / widthBytes_;
+
+	W64 start = max(sim_cycle, link.freeCycle);
+	link.freeCycle = start + flits;
+	entry->arriveCycle = start + flits - 1 + latency_;
+
+	if (!link.deliverPending) {
+		link.deliverPending = true;
+		marss_add_event(&deliver_, entry->arriveCycle - sim_cycle,
+				(void*)&link);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Deliver the message at the head of a link once it has arrived
+ *
+ * @param arg P2PLink whose queue is delivered
+ *
+ * @return Always True
+ */
+bool P2PInterconnect::deliver_cb(void *arg)
+{
+	P2PLink *link = (P2PLink*)arg;
+	P2PQueueEntry *entry = link->queue.head();
+
+	if (entry && entry->arriveCycle <= sim_cycle) {
+		memdebug("P2P delivering: " << *entry << endl);
+
+		void *arg = (entry->argIsState) ? (void*)&entry->state : entry->arg;
+
+		if (forward(link->receiver, entry->request, entry->hasData,
+					arg, entry->argIsState)) {
+			entry->request->decRefCounter();
+			ADD_HISTORY_REM(entry->request);
+			link->queue.free(entry);
+			entry = link->queue.head();
+		}
+	}
+
+	if (!entry) {
+		link->deliverPending = false;
+		return true;
+	}
+
+	/* A rejected message is retried in the next cycle */
+	int delay = 1;
+	if (entry->arriveCycle > sim_cycle)
+		delay = entry->arriveCycle - sim_cycle;
+
+	marss_add_event(&deliver_, delay, (void*)link);
+	return true;
+}
+
+/**
+ * @brief Remove queued messages of an annuled request
+ *
+ * @param request Memory Request that is annuled
+ */
+void P2PInterconnect::annul_request(MemoryRequest *request)
+{
+	foreach (i, 2) {
+		P2PQueueEntry *entry;
+		foreach_list_mutable (links_[i].queue.list(),
+				entry, entry_t, nextentry_t) {
+			if (entry->request->is_same(request)) {
+				entry->request->decRefCounter();
+				ADD_HISTORY_REM(entry->request);
+				links_[i].queue.free(entry);
+			}
+		}
+	}
 }
 
 /**
@@ -123,6 +251,11 @@ bool P2PInterconnect::controller_request_cb(void *arg)
 int P2PInterconnect::access_fast_path(Controller *controller,
 		MemoryRequest *request)
 {
+	/* Only direct links can be skipped by fast path hits, a link with a
+	 * width still has to model its bandwidth */
+	if (is_timed())
+		return -1;
+
 	Controller *receiver = get_other_controller(controller);
 	return receiver->access_fast_path(this, request);
 }
@@ -165,8 +298,9 @@ void P2PInterconnect::dump_configuration(YAML::Emitter &out) const
 	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
 
 	YAML_KEY_VAL(out, "type", "interconnect");
-	/* Currently we have 0 latency */
-	YAML_KEY_VAL(out, "latency", 0);
+	YAML_KEY_VAL(out, "latency", latency_);
+	YAML_KEY_VAL(out, "width_bytes", widthBytes_);
+	YAML_KEY_VAL(out, "queue_size", queueSize_);
 
 	out << YAML::EndMap;
 }
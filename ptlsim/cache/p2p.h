@@ -30,24 +30,110 @@
 
 #include <interconnect.h>
 
+/* Per direction limit of the 'queue_size' option */
+#define P2P_MAX_QUEUE_SIZE 64
+
+/* Messages with data carry one cache line over the wires */
+#define P2P_LINE_BYTES 64
+
 namespace Memory {
 
 /**
- * @brief Point-to-Point un-buffered Interconnect class
+ * @brief Message travelling over one direction of a P2P link
+ */
+struct P2PQueueEntry : public FixStateListObject
+{
+	MemoryRequest *request;
+	void *arg;
+	bool hasData;
+	W64 arriveCycle;
+
+	/* Sender's line state when the message was queued, see Message */
+	bool argIsState;
+	W32 state;
+
+	void init() {
+		request = NULL;
+		arg = NULL;
+		argIsState = false;
+		state = 0;
+		hasData = 0;
+		arriveCycle = 0;
+	}
+
+	ostream& print(ostream& os) const {
+		if (!request) {
+			os << "Free entry";
+			return os;
+		}
+
+		os << "request[", *request, "] ";
+		os << "hasData[", hasData, "] ";
+		os << "arrive[", arriveCycle, "]";
+		return os;
+	}
+};
+
+static inline ostream& operator <<(ostream& os, const P2PQueueEntry& entry)
+{
+	return entry.print(os);
+}
+
+/**
+ * @brief One direction of a P2P link
+ *
+ * Messages are delivered in order. The head message blocks the ones behind
+ * it while the receiver rejects it.
+ */
+struct P2PLink
+{
+	Controller *receiver;
+	FixStateList<P2PQueueEntry, P2P_MAX_QUEUE_SIZE> queue;
+
+	/* First cycle the wires are free to start sending a new message */
+	W64 freeCycle;
+	bool deliverPending;
+
+	P2PLink() {
+		receiver = NULL;
+		freeCycle = 0;
+		deliverPending = false;
+	}
+};
+
+/**
+ * @brief Point-to-Point Interconnect class
+ *
+ * This interconnect connects two controllers, think of it as set of wires
+ * that connect two caches directly. By default it has no latency and no
+ * buffers: a message is passed to the other controller in the same call.
  *
- * This interconnect model is very simple un-buffered model that connects two
- * controllers.  Think of this interconnect as set of wires that connect two
- * caches directly.  This model doesn't have any buffers and currently its
- * latency is set to 0 cycle.
+ * With the 'latency' (cycles) or 'width_bytes' (bytes per cycle) machine
+ * options set each direction becomes a queue of up to 'queue_size'
+ * messages. A message holds the wires for one cycle per flit, a cache line
+ * takes P2P_LINE_BYTES / width_bytes flits, and it is delivered 'latency'
+ * cycles after its last flit was sent. A full queue rejects new messages,
+ * the sender retries them after get_delay() cycles.
  */
 class P2PInterconnect : public Interconnect
 {
 	private:
 		Controller *controllers_[2];
 
+		/* links_[i] carries messages sent by controllers_[i] */
+		P2PLink links_[2];
+		Signal deliver_;
+
+		int latency_;
+		int widthBytes_;
+		int queueSize_;
+
 		bool send_request(Controller *sender, MemoryRequest *request,
 				bool hasData);
 
+		bool forward(Controller *receiver, MemoryRequest *request,
+				bool hasData, void *arg, bool argIsState);
+
 		/**
 		 * @brief Get the controller connected to other end
 		 *
@@ -65,10 +151,19 @@ class P2PInterconnect : public Interconnect
 			return NULL;
 		}
 
+		P2PLink& get_link(Controller *sender) {
+			return links_[(sender == controllers_[0]) ? 0 : 1];
+		}
+
+		/* Zero latency links with unlimited width are direct calls */
+		bool is_timed() const {
+			return (latency_ > 0 || widthBytes_ > 0);
+		}
 
 	public:
 		P2PInterconnect(const char *name, MemoryHierarchy *memoryHierarchy);
 		bool controller_request_cb(void *arg);
+		bool deliver_cb(void *arg);
 		void register_controller(Controller *controller);
 		int access_fast_path(Controller *controller,
 				MemoryRequest *request);
@@ -76,6 +171,10 @@ class P2PInterconnect : public Interconnect
 
 		void print(ostream& os) const {
 			os << "--P2P Interconnect: ", get_name(), endl;
+			foreach (i, 2) {
+				if (links_[i].queue.count())
+					os << "Link ", i, " queue:", endl, links_[i].queue;
+			}
 		}
 
 		/**
@@ -90,8 +189,7 @@ class P2PInterconnect : public Interconnect
 			return 1;
 		}
 
-		void annul_request(MemoryRequest *request) {
-		}
+		void annul_request(MemoryRequest *request);
 
 		void dump_configuration(YAML::Emitter &out) const;
 };
@@ -0,0 +1,448 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <ring.h>
+#include <machine.h>
+
+using namespace Memory;
+using namespace Memory::RingInterconnect;
+
+Ring::Ring(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Interconnect(name, memoryHierarchy)
+    , tickPending_(false)
+    , lastTick_(sim_cycle)
+    , new_stats(name, &memoryHierarchy->get_machine())
+{
+    memoryHierarchy_->add_interconnect(this);
+
+    SET_SIGNAL_CB(name, "_tick", tick, &Ring::tick_cb);
+
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    int num_stops;
+    if (!machine.get_option(name, "stops", num_stops))
+        num_stops = 0;
+
+    if (!machine.get_option(name, "hop_latency", hopLatency_))
+        hopLatency_ = 1;
+
+    if (!machine.get_option(name, "queue_size", queueSize_))
+        queueSize_ = 16;
+
+    if (!machine.get_option(name, "starvation_cycles", starvationCycles_))
+        starvationCycles_ = 16;
+
+    assert(num_stops >= 0 && starvationCycles_ >= 0);
+    hopLatency_ = max(hopLatency_, 1);
+    queueSize_ = max(1, min(queueSize_, RING_MAX_QUEUE_SIZE));
+
+    offset[RING_CW] = 0;
+    offset[RING_CCW] = 0;
+
+    fixedStops_ = (num_stops > 0);
+    foreach (i, num_stops) {
+        add_stop();
+    }
+}
+
+Ring::~Ring()
+{
+    foreach (i, stops.count()) {
+        delete stops[i];
+    }
+}
+
+void Ring::add_stop()
+{
+    stops.push(new RingStop());
+
+    foreach (dir, RING_DIRECTIONS) {
+        slots[dir].resize(stops.count() * hopLatency_);
+        foreach (i, slots[dir].count()) {
+            slots[dir][i].init();
+        }
+    }
+}
+
+void Ring::register_controller(Controller *controller)
+{
+    if (!fixedStops_)
+        add_stop();
+
+    controllerStop.push(controllers.count() % stops.count());
+    controllers.push(controller);
+}
+
+int Ring::access_fast_path(Controller *controller,
+        MemoryRequest *request)
+{
+    return -1;
+}
+
+int Ring::get_stop(Controller *cont) const
+{
+    foreach (i, controllers.count()) {
+        if (controllers[i] == cont)
+            return controllerStop[i];
+    }
+
+    assert(0);
+    return -1;
+}
+
+int Ring::get_hops(int source, int dest, int dir) const
+{
+    int n = stops.count();
+    int cw = (dest - source + n) % n;
+
+    return (dir == RING_CW) ? cw : (n - cw) % n;
+}
+
+/* Shortest path, clockwise on a tie */
+int Ring::get_direction(int source, int dest) const
+{
+    if (get_hops(source, dest, RING_CW) <= get_hops(source, dest, RING_CCW))
+        return RING_CW;
+
+    return RING_CCW;
+}
+
+RingSlot& Ring::get_slot(int dir, int stop)
+{
+    int n = slots[dir].count();
+    int pos = stop * hopLatency_;
+
+    if (dir == RING_CW)
+        return slots[dir][(pos - offset[dir] + n) % n];
+
+    return slots[dir][(pos + offset[dir]) % n];
+}
+
+void Ring::schedule_tick()
+{
+    if (!tickPending_) {
+        marss_add_event(&tick, 1, NULL);
+        tickPending_ = true;
+    }
+}
+
+void Ring::annul_request(MemoryRequest *request)
+{
+    foreach (i, stops.count()) {
+        FixStateList<RingQueueEntry, RING_MAX_QUEUE_SIZE> *queues[2] = {
+            &stops[i]->injection, &stops[i]->ejection
+        };
+
+        foreach (q, 2) {
+            RingQueueEntry *entry;
+            foreach_list_mutable (queues[q]->list(),
+                    entry, entry_t, nextentry_t) {
+                if (entry->msg.request->is_same(request)) {
+                    entry->msg.request->decRefCounter();
+                    ADD_HISTORY_REM(entry->msg.request);
+                    queues[q]->free(entry);
+                }
+            }
+        }
+    }
+
+    foreach (dir, RING_DIRECTIONS) {
+        foreach (i, slots[dir].count()) {
+            RingSlot &slot = slots[dir][i];
+
+            if (slot.valid && slot.msg.request->is_same(request)) {
+                slot.msg.request->decRefCounter();
+                ADD_HISTORY_REM(slot.msg.request);
+                slot.valid = false;
+            }
+        }
+    }
+}
+
+bool Ring::controller_request_cb(void *arg)
+{
+    Message *msg = (Message*)arg;
+
+    int source = get_stop((Controller*)msg->sender);
+    RingStop *stop = stops[source];
+
+    if (stop->injection.count() >= queueSize_) {
+        new_stats.injection_full++;
+        return false;
+    }
+
+    RingQueueEntry *entry = stop->injection.alloc();
+    RingMessage &rmsg = entry->msg;
+
+    rmsg.request  = msg->request;
+    rmsg.source   = (Controller*)msg->sender;
+    rmsg.dest     = (Controller*)msg->dest;
+    rmsg.arg      = msg->arg;
+    rmsg.hasData  = msg->hasData;
+    rmsg.isShared = msg->isShared;
+    rmsg.argIsState = msg->argIsState;
+    if (rmsg.argIsState)
+        rmsg.state = *(W8*)msg->arg;
+    rmsg.request->incRefCounter();
+    ADD_HISTORY_ADD(rmsg.request);
+
+    assert(rmsg.dest);
+
+    /* Messages for a sliced cache go to the slice that owns the line */
+    W64 physaddr = rmsg.request->get_physical_address();
+
+    if (!rmsg.dest->owns_address(physaddr)) {
+        foreach (i, controllers.count()) {
+            Controller *cont = controllers[i];
+            if (cont->same_sliced_cache(rmsg.dest) &&
+                    cont->owns_address(physaddr)) {
+                rmsg.dest = cont;
+                break;
+            }
+        }
+    }
+
+    rmsg.destStop = get_stop(rmsg.dest);
+    rmsg.dir = get_direction(source, rmsg.destStop);
+    rmsg.queuedCycle = sim_cycle;
+
+    schedule_tick();
+
+    return true;
+}
+
+/* Move the messages that reached this stop into its ejection queue */
+void Ring::eject(int s)
+{
+    RingStop *stop = stops[s];
+
+    foreach (dir, RING_DIRECTIONS) {
+        RingSlot &slot = get_slot(dir, s);
+
+        if (!slot.valid || slot.msg.destStop != s)
+            continue;
+
+        /* A full ejection queue sends the message around again */
+        if (stop->ejection.count() >= queueSize_) {
+            new_stats.ejection_full++;
+            continue;
+        }
+
+        stop->ejection.alloc()->msg = slot.msg;
+        slot.valid = false;
+    }
+}
+
+void Ring::inject(int s)
+{
+    RingStop *stop = stops[s];
+    RingQueueEntry *entry = stop->injection.head();
+
+    /* Give up reserved slots that came back when nothing uses them */
+    foreach (dir, RING_DIRECTIONS) {
+        RingSlot &slot = get_slot(dir, s);
+
+        if (slot.reserved == s && !slot.valid && (!entry ||
+                    entry->msg.dir != dir || entry->msg.destStop == s)) {
+            slot.reserved = -1;
+            stop->reserved[dir] = false;
+        }
+    }
+
+    if (!entry)
+        return;
+
+    RingMessage &msg = entry->msg;
+    W64 wait = sim_cycle - msg.queuedCycle;
+
+    /* Controllers on the same stop don't use the ring */
+    if (msg.destStop == s) {
+        if (stop->ejection.count() >= queueSize_)
+            return;
+
+        stop->ejection.alloc()->msg = msg;
+        stop->injection.free(entry);
+        new_stats.injected++;
+        new_stats.injection_wait += wait;
+        return;
+    }
+
+    RingSlot &slot = get_slot(msg.dir, s);
+
+    if (!slot.valid && (slot.reserved < 0 || slot.reserved == s)) {
+        if (slot.reserved == s)
+            stop->reserved[msg.dir] = false;
+
+        slot.valid = true;
+        slot.reserved = -1;
+        slot.msg = msg;
+        stop->injection.free(entry);
+
+        new_stats.injected++;
+        new_stats.injection_wait += wait;
+        new_stats.hops += get_hops(s, msg.destStop, msg.dir);
+        return;
+    }
+
+    /* Starving, keep the next slot for this stop */
+    if (wait >= (W64)starvationCycles_ && !stop->reserved[msg.dir] &&
+            slot.reserved < 0) {
+        slot.reserved = s;
+        stop->reserved[msg.dir] = true;
+        new_stats.reservations++;
+    }
+}
+
+/* Hand the head of the ejection queue to its controller */
+bool Ring::deliver(int s)
+{
+    RingStop *stop = stops[s];
+    RingQueueEntry *entry = stop->ejection.head();
+
+    if (entry) {
+        RingMessage &rmsg = entry->msg;
+
+        Message *msg = memoryHierarchy_->get_message();
+        msg->sender   = this;
+        msg->origin   = rmsg.source;
+        msg->dest     = rmsg.dest;
+        msg->request  = rmsg.request;
+        msg->arg      = (rmsg.argIsState) ? (void*)&rmsg.state : rmsg.arg;
+        msg->argIsState = rmsg.argIsState;
+        msg->hasData  = rmsg.hasData;
+        msg->isShared = rmsg.isShared;
+
+        bool success = rmsg.dest->get_interconnect_signal()->emit(msg);
+
+        memoryHierarchy_->free_message(msg);
+
+        memdebug("Ring delivering: " << rmsg << " success: " <<
+                success << endl);
+
+        if (success) {
+            rmsg.request->decRefCounter();
+            ADD_HISTORY_REM(rmsg.request);
+            stop->ejection.free(entry);
+        }
+    }
+
+    return (!stop->ejection.empty() || !stop->injection.empty());
+}
+
+bool Ring::tick_cb(void *arg)
+{
+    tickPending_ = false;
+
+    foreach (dir, RING_DIRECTIONS) {
+        offset[dir] = (offset[dir] + 1) % slots[dir].count();
+    }
+
+    foreach (i, stops.count()) {
+        eject(i);
+    }
+
+    foreach (i, stops.count()) {
+        inject(i);
+    }
+
+    bool active = false;
+
+    foreach (dir, RING_DIRECTIONS) {
+        new_stats.slot_cycles += (sim_cycle - lastTick_) *
+            slots[dir].count();
+
+        foreach (i, slots[dir].count()) {
+            RingSlot &slot = slots[dir][i];
+
+            if (slot.valid)
+                new_stats.busy_slot_cycles++;
+
+            if (slot.valid || slot.reserved >= 0)
+                active = true;
+        }
+    }
+
+    lastTick_ = sim_cycle;
+
+    foreach (i, stops.count()) {
+        if (deliver(i))
+            active = true;
+    }
+
+    if (active)
+        schedule_tick();
+
+    return true;
+}
+
+void Ring::print(ostream& os) const
+{
+    os << "--Ring-Interconnect: ", get_name(), endl;
+
+    foreach (i, stops.count()) {
+        os << "Stop ", i, " injection:", endl;
+        os << stops[i]->injection;
+        os << "Stop ", i, " ejection:", endl;
+        os << stops[i]->ejection;
+    }
+
+    foreach (dir, RING_DIRECTIONS) {
+        foreach (i, slots[dir].count()) {
+            const RingSlot &slot = slots[dir][i];
+
+            if (slot.valid || slot.reserved >= 0) {
+                os << (dir == RING_CW ? "cw" : "ccw"), " slot ", i;
+                os << " reserved[", slot.reserved, "] ";
+                if (slot.valid)
+                    os << slot.msg;
+                os << endl;
+            }
+        }
+    }
+
+    os << "--End-Ring-Interconnect\n";
+}
+
+/**
+ * @brief Dump Ring Interconnect Configuration in YAML Format
+ *
+ * @param out YAML Object
+ */
+void Ring::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "interconnect");
+    YAML_KEY_VAL(out, "stops", stops.count());
+    YAML_KEY_VAL(out, "hop_latency", hopLatency_);
+    YAML_KEY_VAL(out, "queue_size", queueSize_);
+    YAML_KEY_VAL(out, "starvation_cycles", starvationCycles_);
+
+    out << YAML::EndMap;
+}
+
+struct RingBuilder : public InterconnectBuilder
+{
+    RingBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Ring(name, &mem);
+    }
+};
+
+RingBuilder ringBuilder("ring");
@@ -0,0 +1,263 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Bidirectional slotted ring. Each direction is a ring of slots that moves
+ * one position per cycle, the stops sit 'hop_latency' positions apart. A
+ * message waits in the injection queue of its stop until an empty slot in
+ * the shorter direction passes by, rides it to the destination stop and is
+ * moved into that stop's ejection queue, which hands it to the controller.
+ * If the ejection queue is full the message stays on the ring and goes
+ * around again.
+ *
+ *   - type: ring
+ *     option:
+ *         stops: 4                  # default is one stop per controller
+ *         hop_latency: 1            # cycles between neighbouring stops
+ *         queue_size: 16            # injection and ejection entries per stop
+ *         starvation_cycles: 16     # injection wait before reserving a slot
+ *
+ * With 'stops' set the i-th connected controller is placed on stop
+ * i % stops, so listing the cores' caches before the LLC slices puts each
+ * core next to its slice. A stop whose message has waited
+ * 'starvation_cycles' reserves the next slot that passes it, upstream stops
+ * can't inject into a reserved slot, so it comes back empty.
+ */
+
+#ifndef RING_INTERCONNECT_H
+#define RING_INTERCONNECT_H
+
+#include <interconnect.h>
+#include <memoryHierarchy.h>
+
+/* Per stop limit of the 'queue_size' option */
+#define RING_MAX_QUEUE_SIZE 64
+
+namespace Memory {
+
+namespace RingInterconnect {
+
+    enum Direction {
+        RING_CW,
+        RING_CCW,
+        RING_DIRECTIONS,
+    };
+
+    /**
+     * @brief Message in a queue or in a ring slot
+     */
+    struct RingMessage
+    {
+        MemoryRequest *request;
+        Controller    *source;
+        Controller    *dest;
+        void          *arg;
+        bool           hasData;
+        bool           isShared;
+        int            destStop;
+        int            dir;
+        W64            queuedCycle;
+
+        /* Sender's line state when the message was queued, see Message */
+        bool           argIsState;
+        W32            state;
+
+        void init() {
+            request     = NULL;
+            source      = NULL;
+            dest        = NULL;
+            arg         = NULL;
+            hasData     = 0;
+            isShared    = 0;
+            destStop    = 0;
+            dir         = RING_CW;
+            queuedCycle = 0;
+            argIsState  = 0;
+            state       = 0;
+        }
+
+        ostream& print(ostream& os) const {
+            if (!request) {
+                os << "Free entry";
+                return os;
+            }
+
+            os << "request[", *request, "] ";
+            os << "source[", source->get_name(), "] ";
+            os << "dest[", dest->get_name(), "] ";
+            os << "stop[", destStop, "] ";
+            os << "dir[", (dir == RING_CW ? "cw" : "ccw"), "]";
+            return os;
+        }
+    };
+
+    static inline ostream& operator <<(ostream& os, const RingMessage& msg)
+    {
+        return msg.print(os);
+    }
+
+    struct RingQueueEntry : public FixStateListObject
+    {
+        RingMessage msg;
+
+        void init() {
+            msg.init();
+        }
+
+        ostream& print(ostream& os) const {
+            return msg.print(os);
+        }
+    };
+
+    static inline ostream& operator <<(ostream& os,
+            const RingQueueEntry& entry)
+    {
+        return entry.print(os);
+    }
+
+    /**
+     * @brief One slot of a ring direction
+     *
+     * 'reserved' is the stop that reserved this slot, or -1.
+     */
+    struct RingSlot
+    {
+        bool        valid;
+        int         reserved;
+        RingMessage msg;
+
+        void init() {
+            valid = false;
+            reserved = -1;
+            msg.init();
+        }
+    };
+
+    struct RingStop
+    {
+        FixStateList<RingQueueEntry, RING_MAX_QUEUE_SIZE> injection;
+        FixStateList<RingQueueEntry, RING_MAX_QUEUE_SIZE> ejection;
+
+        /* This stop has a slot reserved in the direction */
+        bool reserved[RING_DIRECTIONS];
+
+        RingStop() {
+            injection.reset();
+            ejection.reset();
+            reserved[RING_CW] = false;
+            reserved[RING_CCW] = false;
+        }
+    };
+
+    struct RingStats : public Statable
+    {
+        StatObj<W64> slot_cycles;
+        StatObj<W64> busy_slot_cycles;
+        StatEquation<W64, double, StatObjFormulaDiv> utilization;
+
+        StatObj<W64> injected;
+        StatObj<W64> injection_wait;
+        StatEquation<W64, double, StatObjFormulaDiv> avg_injection_wait;
+
+        StatObj<W64> hops;
+        StatObj<W64> injection_full;
+        StatObj<W64> ejection_full;
+        StatObj<W64> reservations;
+
+        RingStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , slot_cycles("slot_cycles", this)
+              , busy_slot_cycles("busy_slot_cycles", this)
+              , utilization("utilization", this)
+              , injected("injected", this)
+              , injection_wait("injection_wait", this)
+              , avg_injection_wait("avg_injection_wait", this)
+              , hops("hops", this)
+              , injection_full("injection_full", this)
+              , ejection_full("ejection_full", this)
+              , reservations("reservations", this)
+        {
+            utilization.add_elem(&busy_slot_cycles);
+            utilization.add_elem(&slot_cycles);
+
+            avg_injection_wait.add_elem(&injection_wait);
+            avg_injection_wait.add_elem(&injected);
+        }
+    };
+
+    /**
+     * @brief Ring Interconnect between controllers
+     */
+    class Ring : public Interconnect
+    {
+        private:
+            dynarray<Controller*> controllers;
+            dynarray<int> controllerStop;
+            dynarray<RingStop*> stops;
+            dynarray<RingSlot> slots[RING_DIRECTIONS];
+
+            /* Positions the slots moved since the start */
+            int offset[RING_DIRECTIONS];
+
+            Signal tick;
+            bool tickPending_;
+            W64 lastTick_;
+
+            bool fixedStops_;
+            int hopLatency_;
+            int queueSize_;
+            int starvationCycles_;
+
+            RingStats new_stats;
+
+            void schedule_tick();
+            void add_stop();
+            RingSlot& get_slot(int dir, int stop);
+            void eject(int stop);
+            void inject(int stop);
+            bool deliver(int stop);
+
+        public:
+            Ring(const char *name, MemoryHierarchy *memoryHierarchy);
+            ~Ring();
+
+            bool controller_request_cb(void *arg);
+            void register_controller(Controller *controller);
+            int  access_fast_path(Controller *controller,
+                    MemoryRequest *request);
+            void annul_request(MemoryRequest *request);
+            int  get_delay() { return hopLatency_; }
+            void dump_configuration(YAML::Emitter &out) const;
+
+            int  get_stop(Controller *cont) const;
+            int  get_hops(int source, int dest, int dir) const;
+            int  get_direction(int source, int dest) const;
+
+            bool tick_cb(void *arg);
+
+            void print(ostream& os) const;
+
+            void print_map(ostream& os) {
+                os << "Ring Interconnect: ", get_name(), endl;
+                os << "\tconnected to: ", endl;
+
+                foreach (i, controllers.count()) {
+                    os << "\t\tcontroller[", i, "]: ";
+                    os << controllers[i]->get_name();
+                    os << " stop ", controllerStop[i], endl;
+                }
+            }
+    };
+
+    static inline ostream& operator <<(ostream& os, const Ring &ring)
+    {
+        ring.print(os);
+        return os;
+    }
+};
+
+};
+
+#endif // RING_INTERCONNECT_H
@@ -0,0 +1,83 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <shadowCache.h>
+#include <controller.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+ShadowCache::ShadowCache(const char *name, int type,
+        MemoryHierarchy *memoryHierarchy)
+    : stats_(name, &memoryHierarchy->get_machine())
+{
+    name_ << name;
+
+    cacheLines_ = get_cachelines(type);
+    cacheLines_->init();
+}
+
+void ShadowCache::access(MemoryRequest *request)
+{
+    OP_TYPE type = request->get_type();
+    bool kernel_req = request->is_kernel();
+
+    if(type != MEMORY_OP_READ && type != MEMORY_OP_WRITE)
+        return;
+
+    CacheLine *line = cacheLines_->probe(request);
+
+    if(line && line->state) {
+        if(type == MEMORY_OP_READ) {
+            N_STAT_UPDATE(stats_.hit.read, ++, kernel_req);
+        } else {
+            N_STAT_UPDATE(stats_.hit.write, ++, kernel_req);
+        }
+        return;
+    }
+
+    if(type == MEMORY_OP_READ) {
+        N_STAT_UPDATE(stats_.miss.read, ++, kernel_req);
+    } else {
+        N_STAT_UPDATE(stats_.miss.write, ++, kernel_req);
+    }
+
+    /* Allocate on every miss, the followed cache decides nothing here */
+    W64 oldTag = InvalidTag<W64>::INVALID;
+    line = cacheLines_->insert(request, oldTag);
+
+    if(oldTag != InvalidTag<W64>::INVALID) {
+        N_STAT_UPDATE(stats_.evict, ++, kernel_req);
+    }
+
+    line->init(cacheLines_->tagOf(request->get_physical_address()));
+    line->state = 1;
+}
+
+void ShadowCache::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "shadow_cache");
+    YAML_KEY_VAL(out, "size", cacheLines_->get_size());
+    YAML_KEY_VAL(out, "sets", cacheLines_->get_set_count());
+    YAML_KEY_VAL(out, "ways", cacheLines_->get_way_count());
+    YAML_KEY_VAL(out, "line_size", cacheLines_->get_line_size());
+
+    out << YAML::EndMap;
+}
+
+void Controller::update_shadow_caches(MemoryRequest *request)
+{
+    foreach (i, shadowCaches_.count()) {
+        shadowCaches_[i]->access(request);
+    }
+}
@@ -0,0 +1,63 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Shadow caches: tag only caches that see the same accesses as a cache of the
+ * simulated hierarchy, so miss rates of other cache designs can be measured
+ * in the same run. They keep their own tags, replacement state and stats but
+ * never send requests or affect timing. A machine defines them next to its
+ * caches and names the cache each instance follows with 'shadow_of':
+ *
+ *   shadow_caches:
+ *     - type: l2_1M_mesi
+ *       name_prefix: L2_1M_SHADOW_
+ *       insts: 1
+ *       shadow_of: L2_      # instance i follows L2_<i>
+ */
+
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <arena.h>
+#include <memoryRequest.h>
+#include <memoryStats.h>
+#include <cacheLines.h>
+
+namespace Memory {
+
+class MemoryHierarchy;
+
+class ShadowCache
+{
+    private:
+        stringbuf name_;
+        CacheLinesBase *cacheLines_;
+        ShadowCacheStats stats_;
+
+    public:
+        MACHINE_ARENA_ALLOCATED
+
+        ShadowCache(const char *name, int type,
+                MemoryHierarchy *memoryHierarchy);
+
+        /* Replay a read or write that the followed cache looked up */
+        void access(MemoryRequest *request);
+
+        void dump_configuration(YAML::Emitter &out) const;
+
+        char* get_name() const {
+            return name_.buf;
+        }
+
+        const ShadowCacheStats& get_stats() const {
+            return stats_;
+        }
+};
+
+};
+
+#endif // SHADOW_CACHE_H
@@ -265,12 +265,16 @@ BusQueueEntry* BusInterconnect::arbitrate_round_robin()
     return NULL;
 }
 
-bool BusInterconnect::can_broadcast(BusControllerQueue *queue)
+bool BusInterconnect::can_broadcast(BusControllerQueue *queue,
+        W64 physaddr)
 {
     bool isFull = false;
     foreach(i, controllers.count()) {
         if(controllers[i]->controller == queue->controller)
             continue;
+        /* A full slice only holds back requests for its own lines */
+        if(!controllers[i]->controller->owns_address(physaddr))
+            continue;
         isFull |= controllers[i]->controller->is_full(true);
     }
     if(isFull) {
@@ -313,7 +317,8 @@ bool BusInterconnect::broadcast_cb(void *arg)
      * entry and  pass the queue entry as argument to the broadcast
      * signal so next time it doesn't need to arbitrate
      */
-    if(!can_broadcast(queueEntry->controllerQueue)) {
+    if(!can_broadcast(queueEntry->controllerQueue,
+                queueEntry->request->get_physical_address())) {
         memdebug("Bus cant do addr broadcast\n");
         set_bus_busy(true);
         marss_add_event(&broadcast_,
@@ -339,7 +344,8 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
         return true;
     }
 
-	if(!can_broadcast(queueEntry->controllerQueue)) {
+	if(!can_broadcast(queueEntry->controllerQueue,
+				queueEntry->request->get_physical_address())) {
 		set_bus_busy(true);
 		marss_add_event(&broadcastCompleted_,
 				2, NULL);
@@ -370,9 +376,14 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
     message.origin = NULL;
 
     Controller *controller = queueEntry->controllerQueue->controller;
+    W64 physaddr = queueEntry->request->get_physical_address();
 
     foreach(i, controllers.count()) {
-        if(controller != controllers[i]->controller) {
+        if(!controllers[i]->controller->owns_address(physaddr)) {
+            /* Slices of a sliced cache only see their own lines */
+            if(pendingEntry)
+                pendingEntry->responseReceived[i] = true;
+        } else if(controller != controllers[i]->controller) {
             bool ret = controllers[i]->controller->
                 get_interconnect_signal()->emit(&message);
             assert(ret);
@@ -463,7 +474,8 @@ bool BusInterconnect::data_broadcast_cb(void *arg)
      * entry and  pass the queue entry as argument to the broadcast
      * signal so next time it doesn't need to arbitrate
      */
-    if(!can_broadcast(pendingEntry->controllerQueue)) {
+    if(!can_broadcast(pendingEntry->controllerQueue,
+                pendingEntry->request->get_physical_address())) {
         marss_add_event(&dataBroadcast_,
                 latency_, arg);
         return true;
@@ -497,12 +509,17 @@ bool BusInterconnect::data_broadcast_completed_cb(void *arg)
     message.isShared = pendingEntry->shared;
     message.origin = NULL;
 
+    W64 physaddr = pendingEntry->request->get_physical_address();
+
     foreach(i, controllers.count()) {
         if(pendingEntry->controllerWithData == controllers[i]->controller) {
             /* Don't send the data message back to the responding controller */
             continue;
         }
 
+        if(!controllers[i]->controller->owns_address(physaddr))
+            continue;
+
         bool ret = controllers[i]->controller->
             get_interconnect_signal()->emit(&message);
         assert(ret);
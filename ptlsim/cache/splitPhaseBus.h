@@ -148,7 +148,7 @@ class BusInterconnect : public Interconnect
         int arbitrate_latency_;
 
 		BusQueueEntry *arbitrate_round_robin();
-		bool can_broadcast(BusControllerQueue *queue);
+		bool can_broadcast(BusControllerQueue *queue, W64 physaddr);
 
 	public:
 		BusInterconnect(const char *name, MemoryHierarchy *memoryHierarchy);
@@ -16,26 +16,68 @@ using namespace Memory::SwitchInterconnect;
 
 Switch::Switch(const char *name, MemoryHierarchy *memoryHierarchy)
     : Interconnect(name, memoryHierarchy)
+    , rrNext_(0)
+    , nextSeq_(0)
+    , arbitratePending_(false)
+    , new_stats(name, &memoryHierarchy->get_machine())
 {
     memoryHierarchy_->add_interconnect(this);
 
-    SET_SIGNAL_CB(name, "_send", send, &Switch::send_cb);
+    SET_SIGNAL_CB(name, "_arbitrate", arbitrate, &Switch::arbitrate_cb);
     SET_SIGNAL_CB(name, "_send_complete", send_complete,
             &Switch::send_complete_cb);
 
-    if(!memoryHierarchy_->get_machine().get_option(name, "latency", latency_)) {
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    if(!machine.get_option(name, "latency", latency_)) {
         latency_ = SWITCH_DELAY;
     }
+
+    if (!machine.get_option(name, "queue_size", queueSize_))
+        queueSize_ = 16;
+
+    queueSize_ = max(1, min(queueSize_, SWITCH_MAX_QUEUE_SIZE));
+
+    int line_size;
+    if (!machine.get_option(name, "line_size", line_size))
+        line_size = 64;
+
+    lineBits_ = msbindex64(max(line_size, 1));
+
+    arbitration_ = SWITCH_ARB_ROUND_ROBIN;
+
+    stringbuf arb;
+    if (machine.get_option(name, "arbitration", arb)) {
+        if (strcmp(arb.buf, "round_robin") == 0) {
+            arbitration_ = SWITCH_ARB_ROUND_ROBIN;
+        } else if (strcmp(arb.buf, "age") == 0) {
+            arbitration_ = SWITCH_ARB_AGE;
+        } else if (strcmp(arb.buf, "priority") == 0) {
+            arbitration_ = SWITCH_ARB_PRIORITY;
+        } else {
+            stringbuf err;
+            err << "::ERROR::Unknown arbitration '" << arb << "' for " <<
+                name << ", use 'round_robin', 'age' or 'priority'" << endl;
+            ptl_logfile << err;
+            cout << err;
+            assert(0);
+        }
+    }
 }
 
 Switch::~Switch()
 {
+    foreach (i, controllers.count()) {
+        delete controllers[i]->stats;
+        delete controllers[i];
+    }
 }
 
 void Switch::register_controller(Controller *controller)
 {
     ControllerQueue *cq = new ControllerQueue();
     cq->controller = controller;
+    cq->stats = new PortStats(controller->get_name(), &new_stats);
 
     controllers.push(cq);
 }
@@ -49,22 +91,24 @@ int Switch::access_fast_path(Controller *controller,
 void Switch::annul_request(MemoryRequest *request)
 {
     foreach (i, controllers.count()) {
-
-        QueueEntry *entry;
-        foreach_list_mutable (controllers[i]->queue.list(),
-                entry, entry_t, nextentry_t) {
-
-            if (entry->request->is_same(request)) {
-                entry->annuled = true;
-                entry->request->decRefCounter();
-                ADD_HISTORY_REM(entry->request);
-                controllers[i]->queue.free(entry);
-
-                if (entry->in_use) {
-                    /* If this entry is in use then clear its
-                     * receiver controllers flag */
-                    ControllerQueue* dq = get_queue(entry->dest);
-                    dq->recv_busy = 0;
+        foreach (vc, SWITCH_VC_COUNT) {
+
+            QueueEntry *entry;
+            foreach_list_mutable (controllers[i]->queue[vc].list(),
+                    entry, entry_t, nextentry_t) {
+
+                if (entry->request->is_same(request)) {
+                    entry->annuled = true;
+                    entry->request->decRefCounter();
+                    ADD_HISTORY_REM(entry->request);
+                    controllers[i]->queue[vc].free(entry);
+
+                    if (entry->in_use) {
+                        /* If this entry is in use then clear its
+                         * receiver controllers flag */
+                        ControllerQueue* dq = get_queue(entry->dest);
+                        dq->recv_busy = 0;
+                    }
                 }
             }
         }
@@ -76,46 +120,162 @@ bool Switch::controller_request_cb(void *arg)
     Message *msg = (Message*)arg;
 
     ControllerQueue *cq = get_queue((Controller*)msg->sender);
+    int vc = get_vc(*msg);
 
-    QueueEntry *queueEntry = cq->queue.alloc();
-
-    if (!queueEntry) {
+    if (cq->queue[vc].count() >= queueSize_) {
+        cq->stats->queue_full[vc]++;
         return false;
     }
 
+    QueueEntry *queueEntry = cq->queue[vc].alloc();
+
     *queueEntry << *msg;
+    queueEntry->seq = nextSeq_++;
     ADD_HISTORY_ADD(queueEntry->request);
 
-    if (!cq->queue_in_use) {
-        marss_add_event(&send, 1, cq);
-        cq->queue_in_use = 1;
+    /* Messages for a sliced cache go to the slice that owns the line */
+    W64 physaddr = queueEntry->request->get_physical_address();
+
+    if (queueEntry->dest && !queueEntry->dest->owns_address(physaddr)) {
+        foreach (i, controllers.count()) {
+            Controller *cont = controllers[i]->controller;
+            if (cont->same_sliced_cache(queueEntry->dest) &&
+                    cont->owns_address(physaddr)) {
+                queueEntry->dest = cont;
+                break;
+            }
+        }
     }
 
+    schedule_arbitrate();
+
     return true;
 }
 
-bool Switch::send_cb(void *arg)
+void Switch::schedule_arbitrate()
 {
-    ControllerQueue *cq = (ControllerQueue*)arg;
-    QueueEntry *queueEntry = cq->queue.head();
+    if (!arbitratePending_) {
+        marss_add_event(&arbitrate, 1, NULL);
+        arbitratePending_ = true;
+    }
+}
 
-    if (queueEntry == NULL) {
-        cq->queue_in_use = 0;
-        return true;
+/* Lower key is granted first, the tiebreak orders equal keys */
+void Switch::set_candidate_order(Candidate &cand)
+{
+    int slots = controllers.count() * SWITCH_VC_COUNT;
+    W64 age = cand.cq->queue[cand.vc].head()->arrive_cycle;
+
+    switch (arbitration_) {
+        case SWITCH_ARB_AGE:
+            cand.key = age;
+            cand.tiebreak = cand.slot;
+            break;
+        case SWITCH_ARB_PRIORITY:
+            cand.key = (cand.vc == SWITCH_VC_RESPONSE) ? 0 :
+                (cand.vc == SWITCH_VC_SNOOP) ? 1 : 2;
+            cand.tiebreak = age * slots + cand.slot;
+            break;
+        default:
+            cand.key = (cand.slot - rrNext_ + slots) % slots;
+            cand.tiebreak = 0;
+            break;
     }
+}
 
-    /* Check if destination is available or not */
-    ControllerQueue *dest_cq = get_queue(queueEntry->dest);
+/* True if another channel of the port has an older message for the line */
+bool Switch::has_older_message(ControllerQueue *cq, int vc,
+        QueueEntry *entry)
+{
+    W64 line = entry->request->get_physical_address() >> lineBits_;
 
-    if (queueEntry->annuled || dest_cq->recv_busy) {
-        marss_add_event(&send, 2, cq);
-        return true;
+    foreach (i, SWITCH_VC_COUNT) {
+        if (i == vc)
+            continue;
+
+        QueueEntry *other;
+        foreach_list_mutable (cq->queue[i].list(), other, entry_t,
+                nextentry_t) {
+            if (other->seq > entry->seq)
+                break;
+
+            if (other->dest == entry->dest && (other->request->
+                        get_physical_address() >> lineBits_) == line) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Switch::arbitrate_cb(void *arg)
+{
+    arbitratePending_ = false;
+    candidates.clear();
+
+    foreach (i, controllers.count()) {
+        ControllerQueue *cq = controllers[i];
+
+        foreach (vc, SWITCH_VC_COUNT) {
+            QueueEntry *queueEntry = cq->queue[vc].head();
+
+            if (queueEntry == NULL || queueEntry->in_use)
+                continue;
+
+            Candidate cand;
+            cand.cq = cq;
+            cand.vc = vc;
+            cand.slot = i * SWITCH_VC_COUNT + vc;
+            set_candidate_order(cand);
+
+            /* Insert sorted, there are only a few ports */
+            int pos = candidates.count();
+            candidates.push(cand);
+            while (pos > 0 && (candidates[pos - 1].key > cand.key ||
+                        (candidates[pos - 1].key == cand.key &&
+                         candidates[pos - 1].tiebreak > cand.tiebreak))) {
+                candidates[pos] = candidates[pos - 1];
+                pos--;
+            }
+            candidates[pos] = cand;
+        }
     }
 
-    /* Set destination as busy and signal send_complete */
-    queueEntry->in_use = 1;
-    dest_cq->recv_busy = 1;
-    marss_add_event(&send_complete, latency_, cq);
+    bool granted = false;
+
+    foreach (i, candidates.count()) {
+        Candidate &cand = candidates[i];
+        QueueEntry *queueEntry = cand.cq->queue[cand.vc].head();
+        ControllerQueue *dest_cq = get_queue(queueEntry->dest);
+
+        if (has_older_message(cand.cq, cand.vc, queueEntry)) {
+            cand.cq->stats->stall_cycles[cand.vc]++;
+            schedule_arbitrate();
+            continue;
+        }
+
+        /* Check if source and destination are available or not */
+        if (cand.cq->send_busy || dest_cq->recv_busy) {
+            cand.cq->stats->stall_cycles[cand.vc]++;
+            schedule_arbitrate();
+            continue;
+        }
+
+        /* Set both ends as busy and signal send_complete */
+        queueEntry->in_use = 1;
+        cand.cq->send_busy = 1;
+        cand.cq->send_vc = cand.vc;
+        dest_cq->recv_busy = 1;
+        marss_add_event(&send_complete, latency_, cand.cq);
+
+        /* Round robin starts after the first grant in next cycle */
+        if (!granted) {
+            rrNext_ = (cand.slot + 1) % (controllers.count() *
+                    SWITCH_VC_COUNT);
+            granted = true;
+        }
+    }
 
     return true;
 }
@@ -123,16 +283,13 @@ bool Switch::send_cb(void *arg)
 bool Switch::send_complete_cb(void *arg)
 {
     ControllerQueue *cq = (ControllerQueue*)arg;
-    QueueEntry *queueEntry = cq->queue.head();
+    QueueEntry *queueEntry = cq->queue[cq->send_vc].head();
 
-    if (queueEntry == NULL) {
-        cq->queue_in_use = 0;
-        return true;
-    }
+    cq->send_busy = 0;
 
-    if (queueEntry->annuled) {
-        /* Try to send new packet arrived in queue */
-        marss_add_event(&send, latency_, cq);
+    if (queueEntry == NULL || !queueEntry->in_use) {
+        /* Entry was annuled, try to send new packets in the queues */
+        schedule_arbitrate();
         return true;
     }
 
@@ -150,18 +307,21 @@ bool Switch::send_complete_cb(void *arg)
     memdebug("Switch sending message success: " << success << endl);
 
 	/* If destination is not accepting current controller's request
-	 * so retry after AVG_WAIT_DELAY and meanwhile mark the
+	 * so retry in next arbitration and meanwhile mark the
 	 * destination controller as available , else on success
 	 * remove the entry from queue. */
 
 	if (success) {
+		cq->stats->sent[cq->send_vc]++;
 		queueEntry->request->decRefCounter();
 		ADD_HISTORY_REM(queueEntry->request);
-		cq->queue.free(queueEntry);
+		cq->queue[cq->send_vc].free(queueEntry);
+	} else {
+		queueEntry->in_use = 0;
 	}
 
 	dest_cq->recv_busy = 0;
-	marss_add_event(&send, 1, cq);
+	schedule_arbitrate();
 	return true;
 }
 
@@ -187,9 +347,13 @@ void Switch::dump_configuration(YAML::Emitter &out) const
 
 	YAML_KEY_VAL(out, "type", "interconnect");
 	YAML_KEY_VAL(out, "latency", latency_);
-	if (controllers.size() > 0)
-		YAML_KEY_VAL(out, "per_cont_queue_size",
-				controllers[0]->queue.size());
+	YAML_KEY_VAL(out, "virtual_channels", (int)SWITCH_VC_COUNT);
+	YAML_KEY_VAL(out, "per_vc_queue_size", queueSize_);
+	YAML_KEY_VAL(out, "arbitration",
+			(arbitration_ == SWITCH_ARB_AGE ? "age" :
+			 arbitration_ == SWITCH_ARB_PRIORITY ? "priority" :
+			 "round_robin"));
+	YAML_KEY_VAL(out, "line_size", 1 << lineBits_);
 
 	out << YAML::EndMap;
 }
@@ -20,11 +20,79 @@
 #include <machine.h>
 
 #define SWITCH_DELAY 2
+#define SWITCH_MAX_QUEUE_SIZE 64
 
 namespace Memory {
 
+/*
+ * Each switch port has a request, a response and a snoop virtual channel
+ * with its own queue, so a request waiting on a busy destination does not
+ * hold back the responses queued behind it. Every cycle the heads of all
+ * channels are arbitrated, a head is granted if its source port and its
+ * destination are both idle:
+ *
+ *   - type: switch
+ *     option:
+ *         latency: 2                 # cycles per transfer
+ *         queue_size: 16             # entries per virtual channel
+ *         arbitration: round_robin   # or 'age' or 'priority'
+ *         line_size: 64              # bytes per line for message ordering
+ *
+ * 'age' grants the oldest message first, 'priority' grants responses, then
+ * snoops, then requests, oldest first within a channel. Messages of a port
+ * to the same destination and line are sent in the order they came in, so
+ * an eviction can't pass the response for the line. Each port reports
+ * per channel the messages sent, the cycles a ready head was not granted
+ * and the messages refused because the channel was full.
+ */
 namespace SwitchInterconnect {
 
+    enum VirtualChannel {
+        SWITCH_VC_REQUEST,
+        SWITCH_VC_RESPONSE,
+        SWITCH_VC_SNOOP,
+        SWITCH_VC_COUNT,
+    };
+
+    enum Arbitration {
+        SWITCH_ARB_ROUND_ROBIN,
+        SWITCH_ARB_AGE,
+        SWITCH_ARB_PRIORITY,
+    };
+
+    static const char* vc_names[SWITCH_VC_COUNT] = {
+        "request", "response", "snoop"
+    };
+
+    /* Evicts carry invalidations and eviction notices, data other than a
+     * write-back answers a request */
+    static inline int get_vc(const Message &msg)
+    {
+        OP_TYPE type = msg.request->get_type();
+
+        if (type == MEMORY_OP_EVICT)
+            return SWITCH_VC_SNOOP;
+
+        if (msg.hasData && type != MEMORY_OP_UPDATE)
+            return SWITCH_VC_RESPONSE;
+
+        return SWITCH_VC_REQUEST;
+    }
+
+    struct PortStats : public Statable
+    {
+        StatArray<W64, SWITCH_VC_COUNT> sent;
+        StatArray<W64, SWITCH_VC_COUNT> stall_cycles;
+        StatArray<W64, SWITCH_VC_COUNT> queue_full;
+
+        PortStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , sent("sent", this, vc_names)
+              , stall_cycles("stall_cycles", this, vc_names)
+              , queue_full("queue_full", this, vc_names)
+        {}
+    };
+
     struct QueueEntry : public FixStateListObject
     {
         MemoryRequest *request;
@@ -35,6 +103,12 @@ namespace SwitchInterconnect {
         bool           in_use;
         bool           has_data;
         bool           shared;
+        W64            arrive_cycle;
+        W64            seq;
+
+        /* Sender's line state when the message was queued, see Message */
+        bool           arg_is_state;
+        W32            state;
 
         void init() {
             request  = NULL;
@@ -45,6 +119,10 @@ namespace SwitchInterconnect {
             in_use   = 0;
             has_data = 0;
             shared   = 0;
+            arrive_cycle = 0;
+            seq      = 0;
+            arg_is_state = 0;
+            state    = 0;
         }
 
         void setup(const Message &msg) {
@@ -54,6 +132,10 @@ namespace SwitchInterconnect {
             m_arg    = msg.arg;
             has_data = msg.hasData;
             shared   = msg.isShared;
+            arrive_cycle = sim_cycle;
+            arg_is_state = msg.argIsState;
+            if (arg_is_state)
+                state = *(W8*)msg.arg;
             request->incRefCounter();
         }
 
@@ -61,7 +143,8 @@ namespace SwitchInterconnect {
             msg.origin   = source;
             msg.dest     = dest;
             msg.request  = request;
-            msg.arg      = m_arg;
+            msg.arg      = (arg_is_state) ? (void*)&state : m_arg;
+            msg.argIsState = arg_is_state;
             msg.hasData  = has_data;
             msg.isShared = shared;
         }
@@ -101,37 +184,67 @@ namespace SwitchInterconnect {
     /**
      * @brief Represent connection to each controller
      *
-     * It contains an incoming queue and a flag that indicate
-     * if this controller can accept a packet or not.
+     * It contains one incoming queue per virtual channel and flags
+     * that indicate if this controller is sending or receiving a
+     * packet.
      */
     struct ControllerQueue {
         bool        recv_busy;
-        bool        queue_in_use;
+        bool        send_busy;
+        int         send_vc;
         Controller *controller;
-        FixStateList<QueueEntry, 16> queue;
+        PortStats  *stats;
+        FixStateList<QueueEntry, SWITCH_MAX_QUEUE_SIZE> queue[SWITCH_VC_COUNT];
 
         ControllerQueue() {
-            recv_busy    = false;
-            queue_in_use = false;
-            controller   = NULL;
-            queue.reset();
+            recv_busy  = false;
+            send_busy  = false;
+            send_vc    = 0;
+            controller = NULL;
+            stats      = NULL;
+            foreach (i, SWITCH_VC_COUNT) {
+                queue[i].reset();
+            }
         }
     };
 
+    /* A channel head waiting for a grant and its arbitration order */
+    struct Candidate {
+        ControllerQueue *cq;
+        int vc;
+        int slot;
+        W64 key;
+        W64 tiebreak;
+    };
+
     /**
      * @brief Create a Switch Interconnect between controllers
      *
-     * It creates NxN switch with fixed per controller queue.
+     * It creates NxN switch with per controller virtual channel queues.
      */
     class Switch : public Interconnect
     {
         private:
             dynarray<ControllerQueue*> controllers;
+            dynarray<Candidate> candidates;
 
-            Signal send;
+            Signal arbitrate;
             Signal send_complete;
 
             int latency_;
+            int queueSize_;
+            int arbitration_;
+            int rrNext_;
+            int lineBits_;
+            W64 nextSeq_;
+            bool arbitratePending_;
+
+            Statable new_stats;
+
+            void schedule_arbitrate();
+            void set_candidate_order(Candidate &cand);
+            bool has_older_message(ControllerQueue *cq, int vc,
+                    QueueEntry *entry);
 
         public:
             Switch(const char *name, MemoryHierarchy *memoryHierarchy);
@@ -147,7 +260,7 @@ namespace SwitchInterconnect {
 
             ControllerQueue* get_queue(Controller *cont);
 
-            bool send_cb(void *arg);
+            bool arbitrate_cb(void *arg);
             bool send_complete_cb(void *arg);
 
             void print(ostream& os) const {
@@ -155,8 +268,12 @@ namespace SwitchInterconnect {
                 foreach (i, controllers.count()) {
                     ControllerQueue *cq = controllers[i];
                     os << "Controller ", cq->controller->get_name(), " ";
-                    os << "busy: ", cq->recv_busy, " Queue:", endl;
-                    os << cq->queue;
+                    os << "busy: ", cq->recv_busy, " sending: ",
+                       cq->send_busy, endl;
+                    foreach (j, SWITCH_VC_COUNT) {
+                        os << vc_names[j], " Queue:", endl;
+                        os << cq->queue[j];
+                    }
                 }
                 os << "--End-Switch-Interconnect\n";
             }
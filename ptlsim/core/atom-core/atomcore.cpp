@@ -14,6 +14,7 @@
 #include <branchpred.h>
 #include <decode.h>
 #include <memoryHierarchy.h>
+#include <rtm.h>
 
 //#define DISABLE_LDST_FWD
 
@@ -161,6 +162,7 @@ void AtomOp::reset()
         stores[i] = NULL;
         rflags[i] = 0;
         load_requestd[i] = false;
+        load_virtaddr[i] = 0;
     }
 
     uuid = -1;
@@ -266,8 +268,12 @@ bool AtomOp::fetch()
         /* Check if we can't execute all uops in one FU cluster then
          * we split the AtomOp and put remaining uops into next AtomOp.
          */
-        if(!(fu_mask & fuinfo[op.opcode].fu) ||
-                !(port_mask & fuinfo[op.opcode].port)) {
+        const UopTableEntry& uopinfo = thread->core.uop_table.get(op.opcode,
+                op.size);
+        W32 uop_fu = uopinfo.units & bitmask(FU_COUNT);
+        W32 uop_port = uopinfo.units >> FU_COUNT;
+
+        if(!(fu_mask & uop_fu) || !(port_mask & uop_port)) {
             ret_value = true;
             is_nonpipe = true;
             break;
@@ -277,12 +283,11 @@ bool AtomOp::fetch()
         thread->bb_transop_index++;
         thread->st_fetch.uops++;
 
-        /* Update AtomOp from fuinfo */
-        fu_mask &= fuinfo[op.opcode].fu;
-        port_mask &= fuinfo[op.opcode].port;
-        execution_cycles = max(fuinfo[op.opcode].latency,
-                execution_cycles);
-        is_nonpipe |= ~(fuinfo[op.opcode].pipelined); 
+        /* Update AtomOp from the core's uop table */
+        fu_mask &= uop_fu;
+        port_mask &= uop_port;
+        execution_cycles = max((int)uopinfo.latency, (int)execution_cycles);
+        is_nonpipe |= !uopinfo.pipelined;
 
         if unlikely (isclass(op.opcode, OPCLASS_BARRIER)) {
             thread->stall_frontend = true;
@@ -945,6 +950,7 @@ W8 AtomOp::execute_load(TransOp& uop, int idx)
 
     state.reg.rddata = get_load_data(addr, uop);
     state.reg.rdflags = 0;
+    load_virtaddr[idx] = cache_virtaddr;
 
     return ISSUE_OK;
 }
@@ -1501,6 +1507,8 @@ void AtomOp::update_reg_mem()
                         Memory::MEMORY_OP_WRITE,
                         uuid);
                 if(config.checker_enabled && !thread->ctx.kernel_mode) {
+                    /* storemask_virt() marks SMC pages for the other stores */
+                    smc_setdirty(buf->addr);
                     add_checker_store(buf, uops[i].size);
                 } else {
                     buf->write_to_ram(thread->ctx);
@@ -1557,6 +1565,9 @@ void AtomOp::writeback_eom()
         thread->st_branch_predictions.updates++;
     }
 
+    thread->callgraph.commit(thread->ctx,
+            isclass(last_uop.opcode, OPCLASS_BRANCH) ? predinfo.bptype : 0);
+
     ATOMOPLOG2("Commited.. new eip:0x", hexstring(thread->ctx.eip, 48));
 
 #ifdef TRACE_RIP
@@ -1716,6 +1727,7 @@ AtomThread::AtomThread(AtomCore& core, W8 threadid, Context& ctx)
       , st_cycles("cycles", this)
       , assists("assists", this, assist_names)
       , lassists("lassists", this, light_assist_names)
+      , fast_string(core, threadid, this)
 {
     stringbuf th_name;
     th_name << "thread_" << threadid;
@@ -1810,6 +1822,7 @@ void AtomThread::reset()
 
     exception_op = NULL;
     pause_counter = 0;
+    fast_string.reset();
     running = 0;
     ready = 1;
 
@@ -1863,6 +1876,11 @@ bool AtomThread::fetch()
         return true;
     }
 
+    if(fast_string.clock()) {
+        st_fetch.stop.fast_string++;
+        return true;
+    }
+
     // Fetch an instruction
     while(fetchcount < MAX_FETCH_WIDTH) {
 
@@ -1998,22 +2016,18 @@ bool AtomThread::fetch_check_current_bb()
         current_bb = NULL;
     }
 
-    BasicBlock *bb = bbcache[ctx.cpu_index](fetchrip);
+    /* translate() checks cached blocks that predate a guest TLB flush */
+    current_bb = bbcache[ctx.cpu_index].translate(ctx, fetchrip);
 
-    if likely (bb) {
-        current_bb = bb;
-    } else {
-        current_bb = bbcache[ctx.cpu_index].translate(ctx, fetchrip);
-
-        if unlikely (!current_bb) {
-            if(fetchrip.rip == ctx.eip) {
-                // Its a page fault in I-Cache
-                itlb_exception = true;
-                itlb_exception_addr = ctx.exec_fault_addr;
-                ATOMTHLOG1("ITLB Execption addr ",
-                        hexstring(itlb_exception_addr,48), " fetchrip ",
-                        hexstring(fetchrip.rip,48));
-            }
+    /* A stale block still in use is not a fault, retry next cycle */
+    if unlikely (!current_bb && !bbcache[ctx.cpu_index].busy) {
+        if(fetchrip.rip == ctx.eip) {
+            // Its a page fault in I-Cache
+            itlb_exception = true;
+            itlb_exception_addr = ctx.exec_fault_addr;
+            ATOMTHLOG1("ITLB Execption addr ",
+                    hexstring(itlb_exception_addr,48), " fetchrip ",
+                    hexstring(fetchrip.rip,48));
         }
     }
 
@@ -2564,6 +2578,14 @@ bool AtomThread::writeback()
         assert(0);
     }
 
+    /* Another CPU or one of our stores aborted the transaction */
+    if unlikely (ctx.rtm_doomed) {
+        ATOMTHLOG1("transaction aborted, restart at fallback");
+        rtm_rollback(ctx);
+        flush_pipeline();
+        return false;
+    }
+
     /* If commit-buffer is empty and we have itlb_exception or interrupt
      * pending then handle them first. */
     if(commitbuf.empty() || pause_counter > 0) {
@@ -2655,6 +2677,35 @@ bool AtomThread::commit_queue()
         return handle_exception();
     }
 
+    /*
+     * Loads join the transaction read set and abort conflicting
+     * transactions only when they commit, so wrong path loads don't. A load
+     * that aborted a transaction that wrote its line has read the discarded
+     * data, fetch the instruction again.
+     */
+    if unlikely (rtm_active_transactions) {
+        bool reload = false;
+
+        foreach_forward(commitbuf, i) {
+            AtomOp* op = commitbuf[i].op;
+
+            foreach (j, op->num_uops_used) {
+                if (op->load_virtaddr[j]) {
+                    reload |= !rtm_load(ctx, op->load_virtaddr[j],
+                            1 << op->uops[j].size);
+                }
+            }
+
+            if (op->eom) break;
+        }
+
+        if unlikely (reload) {
+            ATOMTHLOG1("load read data of an aborted transaction");
+            flush_pipeline();
+            return false;
+        }
+    }
+
     foreach_forward(commitbuf, i) {
         BufferEntry& buf = commitbuf[i];
 
@@ -2680,6 +2731,12 @@ bool AtomThread::commit_queue()
         if(buf.op->eom || commit_result == COMMIT_BARRIER) {
             total_insns_committed++;
             st_commit.insns++;
+
+            if(ctx.kernel_mode) {
+                ctx.kernel_instructions_commited++;
+            } else {
+                ctx.user_instructions_commited++;
+            }
             break;
         }
     }
@@ -2797,7 +2854,13 @@ bool AtomThread::handle_barrier()
 {
     int assistid = ctx.eip;
     assist_func_t assist = (assist_func_t)(Waddr)assistid_to_func[assistid];
-    
+
+    /* Assists that can't run in a transaction abort it instead */
+    if unlikely (rtm_check_assist(ctx, assistid)) {
+        flush_pipeline();
+        return false;
+    }
+
     if(assistid == ASSIST_WRITE_CR3) {
         flush_pipeline();
     }
@@ -2818,6 +2881,10 @@ bool AtomThread::handle_barrier()
         stall_frontend = false;
     }
 
+    if(assistid == ASSIST_REP_STRING) {
+        fast_string.start(ctx);
+    }
+
     return true;
 }
 
@@ -2998,18 +3065,61 @@ AtomCore::AtomCore(BaseMachine& machine, int num_threads, const char* name)
 	sg_name << name << "-run-cycle";
 	run_cycle.set_name(sg_name.buf);
 	run_cycle.connect(signal_mem_ptr(*this, &AtomCore::runcycle));
-	marss_register_per_cycle_event(&run_cycle);
+	marss_register_per_cycle_event(&run_cycle, get_coreid());
 
     foreach(i, threadcount) {
         Context& ctx = machine.get_next_context();
 
         AtomThread* thread = new AtomThread(*this, i, ctx);
         threads[i] = thread;
+        memoryHierarchy->set_thread_context(get_coreid(), i, &ctx);
     }
 
+    init_uop_table(name);
+
     reset();
 }
 
+/* Names of the uop table units: all FUs followed by the issue ports */
+static const char* uop_unit_names[FU_COUNT + 2] = {
+    "alu0", "alu1", "alu2", "alu3",
+    "fp0", "fp1", "fp2", "fp3",
+    "agu0", "agu1", "agu2", "agu3",
+    "port0", "port1",
+};
+
+/**
+ * @brief Load the built in uop table and apply the 'uop_table' file from the
+ * core config
+ *
+ * @param name Name of the core in the machine config
+ */
+void AtomCore::init_uop_table(const char* name)
+{
+    /* Units used by the built in table are the ones this core has */
+    W32 present_units = 0;
+
+    foreach (i, OP_MAX_OPCODE) {
+        W32 units = fuinfo[i].fu | (fuinfo[i].port << FU_COUNT);
+        uop_table.set(i, fuinfo[i].latency, fuinfo[i].pipelined, units);
+        present_units |= units;
+    }
+
+    stringbuf table_file;
+    if (machine.get_option(name, "uop_table", table_file)) {
+        bool loaded = uop_table.load(table_file.buf, uop_unit_names,
+                FU_COUNT + 2, present_units);
+        if (!loaded) {
+            stringbuf err;
+            err << "::ERROR::Can't load uop table '" << table_file
+                << "' of core '" << name << "'." << endl;
+            ptl_logfile << err << flush;
+            cerr << err << flush;
+            exit(1);
+        }
+    }
+}
+
 AtomCore::~AtomCore()
 {
 }
@@ -12,6 +12,9 @@
 #define MARSS_ATOM_CORE_H
 
 #include <basecore.h>
+#include <uoptable.h>
+#include <faststring.h>
+#include <callgraph.h>
 #include <branchpred.h>
 #include <statelist.h>
 #include <decode.h>
@@ -573,6 +576,7 @@ namespace ATOM_CORE_MODEL {
         uopimpl_func_t synthops[MAX_UOPS_PER_ATOMOP];
         TransOp        uops[MAX_UOPS_PER_ATOMOP];
         bool           load_requestd[MAX_UOPS_PER_ATOMOP];
+        Waddr          load_virtaddr[MAX_UOPS_PER_ATOMOP];
         W16            rflags[MAX_UOPS_PER_ATOMOP];
         W8             num_uops_used;
         W64            uuid;
@@ -879,6 +883,7 @@ namespace ATOM_CORE_MODEL {
                 StatObj<W64> assist;
                 StatObj<W64> branch_taken;
                 StatObj<W64> max_branch;
+                StatObj<W64> fast_string;
 
                 stop(Statable *parent)
                     : Statable("stop", parent)
@@ -889,6 +894,7 @@ namespace ATOM_CORE_MODEL {
                       , assist("assist", this)
                       , branch_taken("branch_taken", this)
                       , max_branch("max_branch_in_flight", this)
+                      , fast_string("fast_string", this)
                 {}
             } stop;
 
@@ -1020,6 +1026,12 @@ namespace ATOM_CORE_MODEL {
 
         StatArray<W64, ASSIST_COUNT> assists;
         StatArray<W64, L_ASSIST_COUNT> lassists;
+
+        /* Timing of fast-string assists */
+        FastStringUnit fast_string;
+
+        /* Shadow call stack for -callgraph */
+        CallGraph callgraph;
     };
 
     static inline ostream& operator <<(ostream& os, const AtomThread& th)
@@ -1111,6 +1123,12 @@ namespace ATOM_CORE_MODEL {
         // multiple instructions to same FU in one cycle
         W64 fu_available:32, fu_used:32;
         W8  port_available;
+
+        // Uop latencies, FUs and ports, copied from fuinfo and optionally
+        // overridden by the 'uop_table' option. The units mask has the FU
+        // bits followed by the port bits.
+        UopTable uop_table;
+        void init_uop_table(const char* name);
     };
 
     static inline ostream& operator <<(ostream& os, const AtomCore& core)
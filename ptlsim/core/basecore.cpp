@@ -28,7 +28,11 @@ void BaseCore::update_memory_hierarchy_ptr() {
 extern "C" void ptl_flush_bbcache(int8_t context_id) {
     if(in_simulation) {
       foreach(i, NUM_SIM_CORES) {
-        bbcache[i].flush(context_id);
+        /* A TLB flush keeps decoded blocks, they are checked when fetched */
+        if (context_id < 0)
+            bbcache[i].flush(context_id);
+        else
+            bbcache[i].flush_tlb(context_id);
         // Get the current ptlsim machine and call its flush tlb
         PTLsimMachine* machine = PTLsimMachine::getcurrent();
 
@@ -23,6 +23,8 @@ namespace Core {
         W8 coreid;
 
         public:
+            MACHINE_ARENA_ALLOCATED
+
             BaseCore(BaseMachine& machine, const char* name);
             virtual ~BaseCore() {}
 
@@ -0,0 +1,188 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <callgraph.h>
+
+using namespace Core;
+
+/* A call this far from the top frame's stack pointer is on another stack */
+static const W64 STACK_SWITCH_DISTANCE = 1 << 20;
+
+struct CallPathCounts {
+    W64 cycles;
+    W64 l1_misses;
+};
+
+static Hashtable<const char*, CallPathCounts, 4096> callgraph_paths;
+
+CallGraph::CallGraph()
+    : enabled(config.callgraph_filename.set())
+      , kernel_mode(false)
+      , cr3(0)
+      , next_sample(0)
+      , last_sample(0)
+      , last_l1_misses(0)
+{
+    if (enabled) {
+        user.frames.resize(config.callgraph_depth);
+        kernel.frames.resize(config.callgraph_depth);
+    }
+
+    user.reset();
+    kernel.reset();
+}
+
+/* Drop the frames that returned, their return address is below 'limit' */
+void CallGraph::Stack::pop_below(W64 limit)
+{
+    while (depth > 0 && depth <= frames.size() &&
+            frames[depth - 1].sp < limit) {
+        depth--;
+    }
+}
+
+void CallGraph::Stack::push(W64 target, W64 sp)
+{
+    if (depth > 0 && depth <= frames.size()) {
+        W64 top_sp = frames[depth - 1].sp;
+
+        if (sp > top_sp + STACK_SWITCH_DISTANCE ||
+                sp + STACK_SWITCH_DISTANCE < top_sp) {
+            reset();
+        } else {
+            pop_below(sp + 1);
+        }
+    }
+
+    if (depth < frames.size()) {
+        frames[depth].target = target;
+        frames[depth].sp = sp;
+    }
+
+    depth++;
+}
+
+void CallGraph::Stack::ret(W64 sp)
+{
+    /* Frames past the configured depth are not stored, assume they match */
+    if (depth > frames.size()) {
+        depth--;
+        return;
+    }
+
+    pop_below(sp);
+}
+
+/* A new address space or a kernel entry starts new shadow stacks */
+void CallGraph::check_context(Context& ctx)
+{
+    if unlikely (ctx.cr[3] != cr3) {
+        cr3 = ctx.cr[3];
+        user.reset();
+        kernel.reset();
+    }
+
+    if unlikely (ctx.kernel_mode != kernel_mode) {
+        kernel_mode = ctx.kernel_mode;
+        if (kernel_mode)
+            kernel.reset();
+    }
+}
+
+void CallGraph::update_stack(Context& ctx, int bptype)
+{
+    check_context(ctx);
+
+    Stack& stack = (kernel_mode) ? kernel : user;
+    W64 sp = ctx.regs[R_ESP];
+
+    if (bptype & BRANCH_HINT_CALL) {
+        stack.push(ctx.eip, sp);
+    } else {
+        stack.ret(sp);
+    }
+}
+
+void CallGraph::sample(Context& ctx)
+{
+    check_context(ctx);
+
+    W64 cycles = sim_cycle - last_sample;
+    W64 l1_misses = ctx.l1_read_misses - last_l1_misses;
+
+    /* The first sample only starts counting */
+    bool first = (next_sample == 0);
+
+    last_sample = sim_cycle;
+    last_l1_misses = ctx.l1_read_misses;
+    next_sample = sim_cycle + max(config.callgraph_sample, (W64)1);
+
+    if unlikely (first)
+        return;
+
+    stringbuf path;
+    path << "cr3_0x" << hexstring(cr3, 64);
+    user.add_path(path);
+
+    if (kernel_mode) {
+        path << ";[kernel]";
+        kernel.add_path(path);
+    }
+
+    CallPathCounts* counts = callgraph_paths.get(path.buf);
+
+    if (!counts) {
+        CallPathCounts zero = {0, 0};
+        counts = callgraph_paths.add(path.buf, zero);
+    }
+
+    counts->cycles += cycles;
+    counts->l1_misses += l1_misses;
+}
+
+void CallGraph::Stack::add_path(stringbuf& path) const
+{
+    int stored = min(depth, frames.size());
+
+    foreach (i, stored) {
+        path << ";0x" << hexstring(frames[i].target, 64);
+    }
+
+    if (depth > stored)
+        path << ";[deeper]";
+}
+
+/**
+ * @brief Write the sampled call paths in folded stack format
+ */
+void write_callgraph_profile()
+{
+    if (!config.callgraph_filename.set())
+        return;
+
+    stringbuf miss_filename;
+    miss_filename << config.callgraph_filename << ".l1_misses";
+
+    ofstream cycle_file(config.callgraph_filename.buf);
+    ofstream miss_file(miss_filename.buf);
+
+    Hashtable<const char*, CallPathCounts, 4096>::Iterator iter(
+            &callgraph_paths);
+    KeyValuePair<const char*, CallPathCounts>* kvp;
+
+    while ((kvp = iter.next())) {
+        if (kvp->value.cycles)
+            cycle_file << kvp->key, " ", kvp->value.cycles, endl;
+        if (kvp->value.l1_misses)
+            miss_file << kvp->key, " ", kvp->value.l1_misses, endl;
+    }
+
+    if (!cycle_file || !miss_file)
+        ptl_logfile << "Unable to write call graph profile to ",
+                    config.callgraph_filename, endl;
+}
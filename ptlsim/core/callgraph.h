@@ -0,0 +1,83 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Call path profiling of guest code (-callgraph <file>).
+ *
+ * Each hardware thread keeps a shadow call stack built from its committed
+ * call and ret instructions: a call pushes its target and the stack pointer
+ * it left behind, a ret pops every frame whose return address is now below
+ * the stack pointer, which also covers longjmp and exception unwinding. A
+ * call whose stack pointer is far away from the top frame, or a new CR3,
+ * means the guest switched stacks and starts a new shadow stack. Kernel code
+ * has its own shadow stack that is started on every entry from user mode.
+ *
+ * Every -callgraph-sample cycles the cycles and L1 read misses since the
+ * last sample are charged to the current path. At the end of simulation
+ * the paths are written in the folded stack format of flame graph tools,
+ * one 'frame;frame;frame count' line per path, cycles to <file> and L1 read
+ * misses to <file>.l1_misses. Frames are function entry addresses, under a
+ * root frame naming the address space (CR3).
+ */
+
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include <ptlsim.h>
+#include <branchpred.h>
+
+namespace Core {
+
+    class CallGraph {
+        public:
+            CallGraph();
+
+            /* Update with a committed instruction, 'bptype' has its branch hints */
+            inline void commit(Context& ctx, int bptype) {
+                if likely (!enabled)
+                    return;
+
+                if unlikely (bptype & (BRANCH_HINT_CALL | BRANCH_HINT_RET))
+                    update_stack(ctx, bptype);
+
+                if unlikely (sim_cycle >= next_sample)
+                    sample(ctx);
+            }
+
+        private:
+            struct Frame {
+                W64 target;
+                W64 sp;
+            };
+
+            struct Stack {
+                dynarray<Frame> frames;
+                int depth;          /* May exceed frames.size() */
+
+                void reset() { depth = 0; }
+                void push(W64 target, W64 sp);
+                void ret(W64 sp);
+                void pop_below(W64 limit);
+                void add_path(stringbuf& path) const;
+            };
+
+            void check_context(Context& ctx);
+            void update_stack(Context& ctx, int bptype);
+            void sample(Context& ctx);
+
+            bool enabled;
+            bool kernel_mode;
+            W64 cr3;
+            Stack user;
+            Stack kernel;
+
+            W64 next_sample;
+            W64 last_sample;
+            W64 last_l1_misses;
+    };
+
+};
+
+#endif // CALLGRAPH_H
@@ -0,0 +1,138 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <faststring.h>
+#include <memoryRequest.h>
+
+using namespace Core;
+using namespace Memory;
+
+FastStringUnit::FastStringUnit(BaseCore& core, W8 threadid, Statable *parent)
+    : Statable("fast_string", parent)
+      , chunks("chunks", this)
+      , bytes("bytes", this)
+      , lines_read("lines_read", this)
+      , lines_written("lines_written", this)
+      , stall_cycles("stall_cycles", this)
+      , core(core)
+      , threadid(threadid)
+      , seq(0)
+      , resume_rip(INVALIDRIP)
+{
+    stringbuf sig_name;
+    sig_name << "Core" << core.get_coreid() << "-Th" << threadid << "-fast-string";
+    signal.set_name(sig_name.buf);
+    signal.connect(signal_mem_ptr(*this, &FastStringUnit::wakeup));
+
+    reset();
+}
+
+/*
+ * Drop the current chunk. Called on pipeline flush, which also drops its
+ * requests from the memory hierarchy.
+ */
+void FastStringUnit::reset()
+{
+    active = false;
+    reads_left = writes_left = reads_pending = 0;
+    seq++;
+}
+
+void FastStringUnit::start(Context& ctx)
+{
+    /* The assist restarts at the same rip while the string isn't done */
+    bool resumed = (resume_rip == ctx.reg_selfrip);
+    resume_rip = (ctx.eip == ctx.reg_selfrip) ? ctx.reg_selfrip : INVALIDRIP;
+
+    if (!ctx.fast_string_bytes)
+        return;
+
+    W64 len = ctx.fast_string_bytes;
+
+    seq++;
+    active = true;
+    rip = ctx.reg_selfrip;
+    issue_cycle = sim_cycle + ((resumed) ? 0 : config.fast_string_startup);
+
+    dst = floor(ctx.fast_string_dst, LINE_SIZE);
+    writes_left = (ceil(ctx.fast_string_dst + len, LINE_SIZE) - dst) / LINE_SIZE;
+
+    if (ctx.fast_string_src) {
+        src = floor(ctx.fast_string_src, LINE_SIZE);
+        reads_left = (ceil(ctx.fast_string_src + len, LINE_SIZE) - src) / LINE_SIZE;
+    } else {
+        reads_left = 0;
+    }
+
+    reads_pending = 0;
+
+    chunks++;
+    bytes += len;
+}
+
+/* Returns true if the request completed without a callback */
+bool FastStringUnit::issue(W64 physaddr, OP_TYPE type)
+{
+    MemoryRequest *request = core.memoryHierarchy->get_free_request(core.get_coreid());
+    assert(request != NULL);
+
+    request->init(core.get_coreid(), threadid, physaddr, 0, sim_cycle,
+            false, rip, seq, type);
+    request->set_coreSignal(&signal);
+
+    return core.memoryHierarchy->access_cache(request);
+}
+
+bool FastStringUnit::clock()
+{
+    if likely (!active)
+        return false;
+
+    if (sim_cycle >= issue_cycle) {
+        if (reads_left && core.memoryHierarchy->is_cache_available(
+                    core.get_coreid(), threadid, false)) {
+            if (!issue(src, MEMORY_OP_READ))
+                reads_pending++;
+            src += LINE_SIZE;
+            reads_left--;
+            lines_read++;
+        }
+
+        if (writes_left && core.memoryHierarchy->is_cache_available(
+                    core.get_coreid(), threadid, false)) {
+            issue(dst, MEMORY_OP_WRITE);
+            dst += LINE_SIZE;
+            writes_left--;
+            lines_written++;
+        }
+    }
+
+    /* Keep the frontend held this cycle, the next one finds it idle */
+    if (!reads_left && !writes_left && !reads_pending)
+        active = false;
+
+    stall_cycles++;
+    return true;
+}
+
+bool FastStringUnit::wakeup(void *arg)
+{
+    MemoryRequest *request = (MemoryRequest*)arg;
+
+    if (request->get_type() == MEMORY_OP_WRITE ||
+            request->get_owner_uuid() != seq) {
+        return true;
+    }
+
+    if (reads_pending > 0 && --reads_pending == 0 &&
+            !reads_left && !writes_left) {
+        active = false;
+    }
+
+    return true;
+}
@@ -0,0 +1,66 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Timing of fast-string 'rep movs' and 'rep stos' (-fast-strings).
+ *
+ * The ASSIST_REP_STRING assist moves one page bounded chunk of the string
+ * and leaves its guest physical range in the context. The thread hands that
+ * chunk to its FastStringUnit, which issues one line read and one line
+ * write per cycle to the memory hierarchy. The first chunk of an instruction
+ * waits -fast-string-startup cycles before it issues, the chunks after it
+ * start right away. The frontend is held until the last read returns; writes are
+ * posted like committed stores.
+ */
+
+#ifndef FAST_STRING_H
+#define FAST_STRING_H
+
+#include <basecore.h>
+
+namespace Core {
+
+    class FastStringUnit : public Statable {
+        public:
+            enum { LINE_SIZE = 64 };
+
+            FastStringUnit(BaseCore& core, W8 threadid, Statable *parent);
+
+            void reset();
+
+            /* Queue the line requests of the chunk the last assist moved */
+            void start(Context& ctx);
+
+            /* Issue queued lines, returns true while the frontend must stall */
+            bool clock();
+
+            StatObj<W64> chunks;
+            StatObj<W64> bytes;
+            StatObj<W64> lines_read;
+            StatObj<W64> lines_written;
+            StatObj<W64> stall_cycles;
+
+        private:
+            bool wakeup(void *arg);
+            bool issue(W64 physaddr, Memory::OP_TYPE type);
+
+            BaseCore& core;
+            W8 threadid;
+            Signal signal;
+
+            bool active;
+            W64 rip;
+            W64 resume_rip;     /* Instruction with chunks left, or INVALIDRIP */
+            W64 seq;            /* Tags requests of the current chunk */
+            W64 issue_cycle;    /* First cycle after the startup overhead */
+            W64 src, dst;       /* Next line to read and write */
+            int reads_left;
+            int writes_left;
+            int reads_pending;
+    };
+
+};
+
+#endif // FAST_STRING_H
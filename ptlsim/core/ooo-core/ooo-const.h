@@ -271,6 +271,7 @@ namespace OOO_CORE_MODEL {
 #endif
 
     extern const char* phys_reg_file_names[PHYS_REG_FILE_COUNT];
+    extern const char* fu_names[FU_COUNT];
 
 };
 
@@ -437,7 +437,8 @@ int ReorderBufferEntry::issue() {
         return ISSUE_COMPLETED;
     }
 
-    W32 executable_on_fu = fuinfo[uop.opcode].fu & clusters[cluster].fu_mask & core.fu_avail;
+    const UopTableEntry& uopinfo = core.uop_table.get(uop.opcode, uop.size);
+    W32 executable_on_fu = uopinfo.units & clusters[cluster].fu_mask & core.fu_avail;
 
     /* Are any FUs available in this cycle? */
     if unlikely (!executable_on_fu) {
@@ -496,7 +497,13 @@ int ReorderBufferEntry::issue() {
     fu = lsbindex(executable_on_fu);
     clearbit(core.fu_avail, fu);
     core.robs_on_fu[fu] = this;
-    cycles_left = fuinfo[uop.opcode].latency;
+    cycles_left = uopinfo.latency;
+    core.core_stats.issue.fu[fu]++;
+
+    if unlikely (!uopinfo.pipelined) {
+        setbit(core.fu_nonpipe_busy, fu);
+        core.fu_busy_cycles[fu] = uopinfo.latency;
+    }
     changestate(thread.rob_issued_list[cluster]);
 
     IssueState state;
@@ -1476,6 +1483,7 @@ int ReorderBufferEntry::issueload(LoadStoreQueueEntry& state, Waddr& origaddr, W
     thread.thread_stats.dcache.load.size[sizeshift]++;
 
     state.physaddr = (annul) ? INVALID_PHYSADDR : (physaddr >> 3);
+    state.snooped = 0;
 
     W64 data;
 
@@ -2340,6 +2348,63 @@ bool OooCore::dcache_wakeup(void *arg) {
     return true;
 }
 
+/**
+ * @brief L1-D lost a line to a snoop, an eviction or a replacement
+ *
+ * Loads complete out of order, which is only safe under x86-TSO as long as
+ * no other core can observe it. A completed load is only reordered if an
+ * older load is still waiting for its data, so once the line of such a load
+ * leaves the L1-D another core may have written it in between, and the load
+ * is marked for commit to take a machine clear. The loads of the macro-op at
+ * the ROB head are never marked, nothing older can be outstanding there.
+ *
+ * @param arg Pointer to the LineInvalidation
+ *
+ * @return Always true
+ */
+bool OooCore::line_invalidated(void *arg) {
+    LineInvalidation* inv = (LineInvalidation*)arg;
+    W64 line = inv->lineaddr >> inv->line_bits;
+
+    foreach (i, threadcount) {
+        ThreadContext* thread = threads[i];
+
+        if (thread->ROB.empty())
+            continue;
+
+        /* Last ROB slot of the macro-op at the head */
+        int head_end = thread->ROB.head;
+        foreach_forward(thread->ROB, k) {
+            head_end = k;
+            if (thread->ROB[k].uop.eom)
+                break;
+        }
+
+        int head_span = add_index_modulo(head_end, -thread->ROB.head,
+                thread->ROB.size);
+        bool older_pending = false;
+
+        foreach_forward(thread->LSQ, j) {
+            LoadStoreQueueEntry& ldbuf = thread->LSQ[j];
+
+            if (ldbuf.store)
+                continue;
+
+            bool complete = (ldbuf.addrvalid & ldbuf.datavalid);
+            int robpos = add_index_modulo(ldbuf.rob->index(),
+                    -thread->ROB.head, thread->ROB.size);
+
+            if (complete && older_pending && robpos > head_span &&
+                    ((ldbuf.physaddr << 3) >> inv->line_bits) == line)
+                ldbuf.snooped = 1;
+
+            older_pending |= !complete;
+        }
+    }
+
+    return true;
+}
+
 /**
  * @brief Wakeup ROB entry that was waiting for Load to complelte
  *
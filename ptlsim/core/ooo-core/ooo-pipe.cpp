@@ -19,6 +19,7 @@
 #include <ooo.h>
 
 #include <memoryHierarchy.h>
+#include <rtm.h>
 
 #ifndef ENABLE_CHECKS
 #undef assert
@@ -266,6 +267,7 @@ void ThreadContext::flush_pipeline() {
     }
 
     reset_fetch_unit(ctx.eip);
+    fast_string.reset();
     rob_states.reset();
 
     ROB.reset();
@@ -509,6 +511,11 @@ bool ThreadContext::fetch() {
         return true;
     }
 
+    if unlikely (fast_string.clock()) {
+        thread_stats.fetch.stop.fast_string++;
+        return true;
+    }
+
     if unlikely (waiting_for_icache_fill) {
         thread_stats.fetch.stop.icache_miss++;
         return true;
@@ -554,6 +561,9 @@ bool ThreadContext::fetch() {
 
             fetchrip.update(ctx);
             if(fetch_or_translate_basic_block(fetchrip) == NULL) {
+                /* A stale block is still in use, retry next cycle */
+                if unlikely (bbcache[ctx.cpu_index].busy) break;
+
                 if(fetchrip.rip == ctx.eip) {
                     if(logable(10)) ptl_logfile << "Exception in Code page\n";
                     return false;
@@ -669,6 +679,8 @@ bool ThreadContext::fetch() {
         bool redirectrip = false;
 
         transop.rip = fetchrip;
+        transop.rip.mfnlo = current_basic_block->rip.mfnlo;
+        transop.rip.mfnhi = current_basic_block->rip.mfnhi;
         transop.uuid = fetch_uuid++;
 
         if (isbranch(transop.opcode)) {
@@ -766,15 +778,9 @@ BasicBlock* ThreadContext::fetch_or_translate_basic_block(const RIPVirtPhys& rvp
         current_basic_block = NULL;
     }
 
-    BasicBlock* bb = bbcache[ctx.cpu_index](rvp);
-
-    if likely (bb) {
-        current_basic_block = bb;
-    } else {
-        current_basic_block = bbcache[ctx.cpu_index].translate(ctx, rvp);
-        if (current_basic_block == NULL) return NULL;
-        assert(current_basic_block);
-    }
+    /* translate() checks cached blocks that predate a guest TLB flush */
+    current_basic_block = bbcache[ctx.cpu_index].translate(ctx, rvp);
+    if (current_basic_block == NULL) return NULL;
 
      /*
       * Acquire a reference to the new basic block being fetched.
@@ -926,7 +932,7 @@ void ThreadContext::rename() {
           * which has free registers.
           */
 
-        rob.executable_on_cluster_mask = uop_executable_on_cluster[transop.opcode];
+        rob.executable_on_cluster_mask = core.uop_executable_on_cluster[transop.opcode][transop.size];
 
          /*
           * This is used if there is exactly one physical register file per cluster:
@@ -1607,6 +1613,9 @@ int ThreadContext::commit() {
 
     int rc = COMMIT_RESULT_OK;
 
+    /* Another CPU or one of our stores aborted the transaction */
+    if unlikely (ctx.rtm_doomed) return COMMIT_RESULT_RTM_ABORT;
+
     foreach_forward(ROB, i) {
         ReorderBufferEntry& rob = ROB[i];
 
@@ -1761,12 +1770,14 @@ int ReorderBufferEntry::commit() {
      */
 
     bool found_eom = 0;
+    bool machine_clear = 0;
     ReorderBufferEntry* cant_commit_subrob = NULL;
 
     foreach_forward_from(thread.ROB, this, j) {
         ReorderBufferEntry& subrob = thread.ROB[j];
 
         found_eom |= subrob.uop.eom;
+        machine_clear |= (subrob.lsq && subrob.lsq->snooped);
 
         if unlikely (!subrob.ready_to_commit()) {
             all_ready_to_commit = false;
@@ -1859,6 +1870,42 @@ int ReorderBufferEntry::commit() {
         return COMMIT_RESULT_NONE;
     }
 
+    /*
+     * Loads join the transaction read set and abort conflicting
+     * transactions only when they commit, so wrong path loads don't. A load
+     * that aborted a transaction that wrote its line has read the discarded
+     * data, run the instruction again.
+     */
+    if unlikely (rtm_active_transactions && uop.som &&
+            !macro_op_has_exceptions) {
+        foreach_forward_from(thread.ROB, this, j) {
+            ReorderBufferEntry& subrob = thread.ROB[j];
+
+            if (subrob.lsq && isload(subrob.uop.opcode) &&
+                    !subrob.uop.internal) {
+                machine_clear |= !rtm_load(ctx, subrob.lsq->virtaddr,
+                        1 << subrob.uop.size);
+            }
+
+            if likely (subrob.uop.eom) break;
+        }
+    }
+
+    /*
+     * A load of this instruction read a line that the L1-D has lost since,
+     * so another core may have written it in between. Throw away this
+     * instruction and everything after it and fetch it again.
+     */
+    if unlikely (machine_clear && !macro_op_has_exceptions) {
+        thread.thread_stats.commit.result.machine_clear++;
+
+        thread.annul_fetchq();
+        W64 recoveryrip = annul_after_and_including();
+        thread.reset_fetch_unit(recoveryrip);
+
+        return COMMIT_RESULT_NONE;
+    }
+
     if(logable(5)) {
         ptl_logfile << "Committing ROB entry: ", *this,
                     " destreg_value:", hexstring(physreg->data, 64),
@@ -1908,10 +1955,11 @@ int ReorderBufferEntry::commit() {
      *  instruction has dirtied the page(s) on which the current instruction
      *  resides. The SMC check is done first since it's perfectly legal for a
      *  store to overwrite its own instruction bytes, but this update only
-     *  becomes visible after the store has committed.
+     *  becomes visible after the store has committed. uop.rip carries the
+     *  physical pages of its basic block.
      *
      */
-    if unlikely (thread.ctx.smc_isdirty(uop.rip.mfnlo)) {
+    if unlikely (smc_isdirty(uop.rip.mfnlo) | smc_isdirty(uop.rip.mfnhi)) {
 
          /*
           * Invalidate the pages only after the pipeline is flushed: we may still
@@ -2161,8 +2209,6 @@ int ReorderBufferEntry::commit() {
 
 
     if unlikely (uop.opcode == OP_st) {
-        thread.ctx.smc_setdirty(lsq->physaddr << 3);
-
         if(uop.internal) {
             thread.ctx.store_internal(lsq->virtaddr, lsq->data,
                     lsq->bytemask);
@@ -2185,6 +2231,8 @@ int ReorderBufferEntry::commit() {
             assert(core.memoryHierarchy->access_cache(request));
             assert(lsq->virtaddr > 0xfff);
             if(config.checker_enabled && !ctx.kernel_mode) {
+                /* storemask_virt() marks SMC pages for the other stores */
+                smc_setdirty(lsq->physaddr << 3);
                 add_checker_store(lsq, uop.size);
             } else {
                 thread.ctx.storemask_virt(lsq->virtaddr, lsq->data, lsq->bytemask, uop.size);
@@ -2271,6 +2319,15 @@ int ReorderBufferEntry::commit() {
         thread.thread_stats.commit.insns++;
         thread.total_insns_committed++;
 
+        if (ctx.kernel_mode) {
+            ctx.kernel_instructions_commited++;
+        } else {
+            ctx.user_instructions_commited++;
+        }
+
+        thread.callgraph.commit(ctx, isbranch(uop.opcode) ?
+                uop.predinfo.bptype : 0);
+
 #ifdef TRACE_RIP
             ptl_rip_trace << "commit_rip: ",
                           hexstring(uop.rip.rip, 64), " \t",
@@ -35,6 +35,7 @@ namespace OOO_CORE_MODEL {
                 StatObj<W64> full_width;
                 StatObj<W64> icache_stalled;
                 StatObj<W64> invalid_blocks;
+                StatObj<W64> fast_string;
 
                 stop(Statable *parent)
                     : Statable("stop", parent)
@@ -48,6 +49,7 @@ namespace OOO_CORE_MODEL {
                       , full_width("full_width", this)
                       , icache_stalled("icache_stalled", this)
                       , invalid_blocks("invalid_blocks", this)
+                      , fast_string("fast_string", this)
                 {}
             } stop;
 
@@ -234,6 +236,7 @@ namespace OOO_CORE_MODEL {
                 StatObj<W64> memlocked;
                 StatObj<W64> stop;
                 StatObj<W64> dcache_stall;
+                StatObj<W64> machine_clear;
 
                 result(Statable *parent)
                     : Statable("result", parent)
@@ -246,6 +249,7 @@ namespace OOO_CORE_MODEL {
                       , memlocked("memlocked", this)
                       , stop("stop", this)
                       , dcache_stall("dcache_stall", this)
+                      , machine_clear("machine_clear", this)
                 {}
             } result;
 
@@ -638,10 +642,13 @@ namespace OOO_CORE_MODEL {
                 {}
             } width;
 
+            StatArray<W64, FU_COUNT> fu;
+
             issue(Statable *parent)
                 : Statable("issue", parent)
                   , source(this)
                   , width(this)
+                  , fu("fu", this, fu_names)
             {}
         } issue;
 
@@ -23,6 +23,7 @@
 #include <ooo.h>
 
 #include <memoryHierarchy.h>
+#include <rtm.h>
 
 #define MYDEBUG if(logable(99)) ptl_logfile
 
@@ -40,7 +41,6 @@ using namespace OOO_CORE_MODEL;
 using namespace superstl;
 
 namespace OOO_CORE_MODEL {
-    byte uop_executable_on_cluster[OP_MAX_OPCODE];
     W32 forward_at_cycle_lut[MAX_CLUSTERS][MAX_FORWARDING_LATENCY+1];
     bool globals_initialized = false;
 
@@ -65,7 +65,7 @@ namespace OOO_CORE_MODEL {
         "ldu2",
         "stu2",
         "ldu3",
-        "stu4",
+        "stu3",
         "alu0",
         "fpu0",
         "alu1",
@@ -86,16 +86,6 @@ static void init_luts() {
     if(globals_initialized)
         return;
 
-    /* Initialize opcode maps */
-    foreach (i, OP_MAX_OPCODE) {
-        W32 allowedfu = fuinfo[i].fu;
-        W32 allowedcl = 0;
-        foreach (cl, MAX_CLUSTERS) {
-            if (clusters[cl].fu_mask & allowedfu) setbit(allowedcl, cl);
-        }
-        uop_executable_on_cluster[i] = allowedcl;
-    }
-
     /* Initialize forward-at-cycle LUTs */
     foreach (srcc, MAX_CLUSTERS) {
         foreach (destc, MAX_CLUSTERS) {
@@ -113,6 +103,7 @@ static void init_luts() {
 ThreadContext::ThreadContext(OooCore& core_, W8 threadid_, Context& ctx_)
     : core(core_), threadid(threadid_), ctx(ctx_)
       , thread_stats("thread", &core_)
+      , fast_string(core_, threadid_, &thread_stats)
 {
     stringbuf stats_name;
     stats_name << "thread" << threadid;
@@ -270,7 +261,24 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
 	sig_name << core_name << "-run-cycle";
 	run_cycle.set_name(sig_name.buf);
 	run_cycle.connect(signal_mem_ptr(*this, &OooCore::runcycle));
-	marss_register_per_cycle_event(&run_cycle);
+	marss_register_per_cycle_event(&run_cycle, get_coreid());
+
+    /*
+     * With 'memory_ordering_clears' the L1-D reports every line it loses and
+     * loads that already read such a line are replayed at commit.
+     */
+    bool ordering_clears = false;
+    machine_.get_option(name, "memory_ordering_clears", ordering_clears);
+
+    if (ordering_clears) {
+        sig_name.reset();
+        sig_name << core_name << "-line-invalidate";
+        line_invalidate_signal.set_name(sig_name.buf);
+        line_invalidate_signal.connect(signal_mem_ptr(*this,
+                    &OooCore::line_invalidated));
+        memoryHierarchy->set_line_invalidate_signal(get_coreid(),
+                &line_invalidate_signal);
+    }
 
     threads = (ThreadContext**)malloc(sizeof(ThreadContext*) * threadcount);
 
@@ -280,11 +288,56 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
         ThreadContext* thread = new ThreadContext(*this, i, ctx);
         threads[i] = thread;
         thread->init();
+        memoryHierarchy->set_thread_context(get_coreid(), i, &ctx);
     }
 
     init();
 
     init_luts();
+    init_uop_table(name);
+}
+
+/**
+ * @brief Load the built in uop table, apply the 'uop_table' file from the
+ * core config and build the opcode to cluster map from it
+ *
+ * @param name Name of the core in the machine config
+ */
+void OooCore::init_uop_table(const char* name)
+{
+    foreach (i, OP_MAX_OPCODE) {
+        uop_table.set(i, fuinfo[i].latency, true, fuinfo[i].fu);
+    }
+
+    W32 present_fu = 0;
+    foreach (cl, MAX_CLUSTERS) {
+        present_fu |= clusters[cl].fu_mask;
+    }
+
+    stringbuf table_file;
+    if (machine.get_option(name, "uop_table", table_file)) {
+        bool loaded = uop_table.load(table_file.buf, fu_names, FU_COUNT,
+                present_fu);
+        if (!loaded) {
+            stringbuf err;
+            err << "::ERROR::Can't load uop table '" << table_file
+                << "' of core '" << name << "'." << endl;
+            ptl_logfile << err << flush;
+            cerr << err << flush;
+            exit(1);
+        }
+    }
+
+    foreach (i, OP_MAX_OPCODE) {
+        foreach (size, UopTable::SIZE_COUNT) {
+            W32 allowedfu = uop_table.get(i, size).units;
+            W32 allowedcl = 0;
+            foreach (cl, MAX_CLUSTERS) {
+                if (clusters[cl].fu_mask & allowedfu) setbit(allowedcl, cl);
+            }
+            uop_executable_on_cluster[i][size] = allowedcl;
+        }
+    }
 }
 
 /**
@@ -295,6 +348,8 @@ void OooCore::reset() {
     round_robin_reg_file_offset = 0;
 
     setzero(robs_on_fu);
+    fu_nonpipe_busy = 0;
+    setzero(fu_busy_cycles);
 
     foreach_issueq(reset(get_coreid(), this));
 
@@ -613,7 +668,14 @@ bool OooCore::runcycle(void* none) {
 
     foreach (i, threadcount) threads[i]->loads_in_this_cycle = 0;
 
-    fu_avail = bitmask(FU_COUNT);
+    if unlikely (fu_nonpipe_busy) {
+        foreach (fu, FU_COUNT) {
+            if (fu_busy_cycles[fu] && !--fu_busy_cycles[fu])
+                clearbit(fu_nonpipe_busy, fu);
+        }
+    }
+
+    fu_avail = bitmask(FU_COUNT) & ~fu_nonpipe_busy;
 
     /*
      *  Backend and issue pipe stages run with round robin priority
@@ -861,6 +923,12 @@ bool OooCore::runcycle(void* none) {
                     thread->handle_interrupt();
                     break;
                 }
+            case COMMIT_RESULT_RTM_ABORT:
+                {
+                    if (logable(3)) ptl_logfile << " [vcpu ", thread->ctx.cpu_index, "] transaction aborted, restart at fallback", endl;
+                    thread->handle_rtm_abort();
+                    break;
+                }
             case COMMIT_RESULT_STOP:
                 {
                     if (logable(3)) ptl_logfile << " COMMIT_RESULT_STOP, flush_pipeline().",endl;
@@ -1339,6 +1407,12 @@ bool ThreadContext::handle_barrier() {
     int assistid = ctx.eip;
     assist_func_t assist = (assist_func_t)(Waddr)assistid_to_func[assistid];
 
+    /* Assists that can't run in a transaction abort it instead */
+    if unlikely (rtm_check_assist(ctx, assistid)) {
+        flush_pipeline();
+        return true;
+    }
+
     /* Special case for write_cr3 to flush before calling assist */
     if(assistid == ASSIST_WRITE_CR3) {
         flush_pipeline();
@@ -1377,6 +1451,10 @@ bool ThreadContext::handle_barrier() {
         reset_fetch_unit(ctx.eip);
     }
 
+    if(assistid == ASSIST_REP_STRING) {
+        fast_string.start(ctx);
+    }
+
     return true;
 }
 
@@ -1535,6 +1613,18 @@ bool ThreadContext::handle_interrupt() {
     return true;
 }
 
+/**
+ * @brief Restart an aborted transaction at its fallback rip. Its stores were
+ * already undone, everything younger in the pipeline is discarded.
+ */
+void ThreadContext::handle_rtm_abort() {
+    core_to_external_state();
+    rtm_rollback(ctx);
+
+    if (logable(3)) ptl_logfile << " handle_rtm_abort, flush_pipeline.",endl;
+    flush_pipeline();
+}
+
 void PhysicalRegister::fill_operand_info(PhysicalRegisterOperandInfo& opinfo) {
     opinfo.physreg = index();
     opinfo.state = state;
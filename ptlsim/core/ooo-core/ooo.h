@@ -15,6 +15,9 @@
 
 #include <ptlsim.h>
 #include <basecore.h>
+#include <uoptable.h>
+#include <faststring.h>
+#include <callgraph.h>
 #include <branchpred.h>
 #include <statelist.h>
 #include <statsBuilder.h>
@@ -86,8 +89,6 @@ namespace OOO_CORE_MODEL {
         FU_FPU3       = (1 << 15),
     };
 
-    extern const char* fu_names[FU_COUNT];
-
  /*
   * Opcodes and properties
   */
@@ -123,7 +124,8 @@ namespace OOO_CORE_MODEL {
 #define ALLFU  ANYINT|ANYFPU
 
     /**
-     * @brief Hold the functional unites related information
+     * @brief Built in functional unit information, each core copies it into
+     * its UopTable and may override it with the 'uop_table' option
      */
     struct FunctionalUnitInfo {
         byte opcode;   /* Must match definition in ptlhwdef.h and ptlhwdef.cpp! */
@@ -610,7 +612,7 @@ namespace OOO_CORE_MODEL {
         byte coreid;
         OooCore* core;
         W8s mbtag;
-        W8 store:1, lfence:1, sfence:1, entry_valid:1, mmio:1;
+        W8 store:1, lfence:1, sfence:1, entry_valid:1, mmio:1, snooped:1;
           /* W32 padding; */
         W32 time_stamp;
         W64 sfr_data;
@@ -630,6 +632,7 @@ namespace OOO_CORE_MODEL {
             sfr_data = -1;
             sfr_bytemask = 0;
             mmio = 0;
+            snooped = 0;
         }
 
         void init(int idx) {
@@ -842,7 +845,8 @@ namespace OOO_CORE_MODEL {
         COMMIT_RESULT_BARRIER = 3,// barrier; branch to microcode (brp uop)
         COMMIT_RESULT_SMC = 4,    // self modifying code detected
         COMMIT_RESULT_INTERRUPT = 5, // interrupt pending
-        COMMIT_RESULT_STOP = 6    // stop processor model (shutdown)
+        COMMIT_RESULT_STOP = 6,   // stop processor model (shutdown)
+        COMMIT_RESULT_RTM_ABORT = 7 // transaction aborted: restart at fallback
     };
 
     // Branch predictor outcomes:
@@ -858,7 +862,6 @@ namespace OOO_CORE_MODEL {
     };
 
     extern const Cluster clusters[MAX_CLUSTERS];
-    extern byte uop_executable_on_cluster[OP_MAX_OPCODE];
     extern W32 forward_at_cycle_lut[MAX_CLUSTERS][MAX_FORWARDING_LATENCY+1];
     extern const byte archdest_can_commit[TRANSREG_COUNT];
     extern const byte archdest_is_visible[TRANSREG_COUNT];
@@ -1069,6 +1072,7 @@ namespace OOO_CORE_MODEL {
         bool handle_barrier();
         bool handle_exception();
         bool handle_interrupt();
+        void handle_rtm_abort();
         void reset_fetch_unit(W64 realrip);
         void flush_pipeline();
         void invalidate_smc();
@@ -1091,6 +1095,12 @@ namespace OOO_CORE_MODEL {
 
         // Stats
         OooCoreThreadStats thread_stats;
+
+        // Timing of fast-string assists
+        FastStringUnit fast_string;
+
+        // Shadow call stack for -callgraph
+        CallGraph callgraph;
     };
 
     //  class MemoryHierarchy;
@@ -1243,6 +1253,15 @@ namespace OOO_CORE_MODEL {
         int round_robin_reg_file_offset;
         W32 fu_avail;
         ReorderBufferEntry* robs_on_fu[FU_COUNT];
+
+        /* Uop latencies and units, and the clusters that have those units */
+        UopTable uop_table;
+        byte uop_executable_on_cluster[OP_MAX_OPCODE][UopTable::SIZE_COUNT];
+        void init_uop_table(const char* name);
+
+        /* Non pipelined units stay busy until their uop completes */
+        W32 fu_nonpipe_busy;
+        W16 fu_busy_cycles[FU_COUNT];
         // CacheSubsystem::CacheHierarchy caches;
         // CPUControllerNamespace::CPUController cpu_controller;
         //    MemorySystem::CPUController test_controller;
@@ -1278,6 +1297,10 @@ namespace OOO_CORE_MODEL {
         bool dcache_wakeup(void *arg);
         bool icache_wakeup(void *arg);
 
+        /* Memory ordering machine clears ('memory_ordering_clears' option) */
+        Signal line_invalidate_signal;
+        bool line_invalidated(void *arg);
+
 		/* Debugging */
         void dump_state(ostream& os);
         void print_smt_state(ostream& os);
@@ -0,0 +1,192 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <ptlsim.h>
+#include <uoptable.h>
+
+using namespace Core;
+
+UopTable::UopTable()
+{
+    memset(entries, 0, sizeof(entries));
+}
+
+void UopTable::set(int opcode, int latency, bool pipelined, W32 units)
+{
+    assert(opcode < OP_MAX_OPCODE);
+
+    foreach (size, SIZE_COUNT) {
+        UopTableEntry& e = entries[opcode][size];
+        e.latency = latency;
+        e.pipelined = pipelined;
+        e.units = units;
+    }
+}
+
+/* Trim leading and trailing white space in place */
+static char* trim(char *str)
+{
+    while (*str == ' ' || *str == '\t') str++;
+
+    char *end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t' ||
+                end[-1] == '\r')) {
+        *--end = '\0';
+    }
+
+    return str;
+}
+
+static int lookup_opcode(const char *name)
+{
+    foreach (i, OP_MAX_OPCODE) {
+        if (!strcmp(opinfo[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+static bool parse_number(const char *str, int& value)
+{
+    char *end;
+    long v = strtol(str, &end, 0);
+
+    if (!*str || *end)
+        return false;
+
+    value = v;
+    return true;
+}
+
+bool UopTable::load(const char *filename, const char* const* unit_names,
+        int unit_count, W32 present_units)
+{
+    stringbuf err;
+    char line[1024];
+    int lineno = 0;
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        err << "::ERROR::Can't open uop table '" << filename << "'" << endl;
+        goto error;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+
+        char *p = strchr(line, '\n');
+        if (p) *p = '\0';
+        p = strchr(line, '#');
+        if (p) *p = '\0';
+
+        /* opcode, size, latency, pipelined, units */
+        char *fields[5];
+        int nfields = 0;
+        p = line;
+
+        while (nfields < 5) {
+            fields[nfields++] = p;
+            p = strchr(p, ',');
+            if (!p) break;
+            *p++ = '\0';
+        }
+
+        foreach (i, nfields) fields[i] = trim(fields[i]);
+
+        if (nfields == 1 && !*fields[0])
+            continue;
+
+        if (nfields != 5 || p) {
+            err << "::ERROR::" << filename << ":" << lineno <<
+                ": expected 'opcode, size, latency, pipelined, units'" << endl;
+            goto error;
+        }
+
+        int opcode = lookup_opcode(fields[0]);
+        if (opcode < 0) {
+            err << "::ERROR::" << filename << ":" << lineno <<
+                ": unknown uop '" << fields[0] << "'" << endl;
+            goto error;
+        }
+
+        int size_lo = 0, size_hi = SIZE_COUNT - 1;
+        if (strcmp(fields[1], "*")) {
+            int bytes;
+            if (!parse_number(fields[1], bytes) || !bytes || bytes > 8 ||
+                    (bytes & (bytes - 1))) {
+                err << "::ERROR::" << filename << ":" << lineno <<
+                    ": size must be 1, 2, 4, 8 or '*'" << endl;
+                goto error;
+            }
+            size_lo = size_hi = lsbindex(bytes);
+        }
+
+        int latency, pipelined;
+        if (!parse_number(fields[2], latency) || latency < 1 ||
+                latency > MAX_LATENCY) {
+            err << "::ERROR::" << filename << ":" << lineno <<
+                ": latency must be between 1 and " << MAX_LATENCY << endl;
+            goto error;
+        }
+
+        if (!parse_number(fields[3], pipelined) ||
+                (pipelined != 0 && pipelined != 1)) {
+            err << "::ERROR::" << filename << ":" << lineno <<
+                ": pipelined must be 0 or 1" << endl;
+            goto error;
+        }
+
+        W32 units = 0;
+        p = fields[4];
+        for (;;) {
+            while (*p == ' ' || *p == '\t') p++;
+            if (!*p) break;
+
+            char *name = p;
+            while (*p && *p != ' ' && *p != '\t') p++;
+            if (*p) *p++ = '\0';
+
+            int unit;
+            for (unit = 0; unit < unit_count; unit++) {
+                if (!strcmp(unit_names[unit], name)) break;
+            }
+
+            if (unit == unit_count) {
+                err << "::ERROR::" << filename << ":" << lineno <<
+                    ": unknown execution unit '" << name << "'" << endl;
+                goto error;
+            }
+
+            setbit(units, unit);
+        }
+
+        if (!(units & present_units)) {
+            err << "::ERROR::" << filename << ":" << lineno <<
+                ": none of the execution units of '" << fields[0] <<
+                "' exist in this core" << endl;
+            goto error;
+        }
+
+        for (int size = size_lo; size <= size_hi; size++) {
+            UopTableEntry& e = entries[opcode][size];
+            e.latency = latency;
+            e.pipelined = pipelined;
+            e.units = units;
+        }
+    }
+
+    fclose(fp);
+    return true;
+
+error:
+    if (fp) fclose(fp);
+    ptl_logfile << err;
+    cout << err;
+    return false;
+}
@@ -0,0 +1,74 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Per core uop latency and execution unit table.
+ *
+ * Each core model starts from its built in table and can override it with a
+ * file given by the 'uop_table' option of the core in the machine config:
+ *
+ *   cores:
+ *     - type: ooo
+ *       name_prefix: ooo_
+ *       option:
+ *         uop_table: config/uops/nehalem.csv
+ *
+ * The file has one uop per line, '#' starts a comment:
+ *
+ *   # opcode, size, latency, pipelined, units
+ *   mull,     *,    3,       1,         alu0
+ *   div,      8,    40,      0,         alu0
+ *   ld,       *,    3,       1,         ldu0 ldu1
+ *
+ * 'opcode' is the uop name as printed by the simulator (see opinfo in
+ * ptlhwdef.cpp), 'size' is the operand size in bytes (1, 2, 4, 8) or '*' for
+ * all sizes, 'latency' is in cycles and 'units' lists the execution units
+ * (functional units or ports, named as in the core's stats) it can issue to.
+ * Opcodes and sizes not listed keep the core's built in values.
+ */
+
+#ifndef UOP_TABLE_H
+#define UOP_TABLE_H
+
+#include <globals.h>
+#include <ptlhwdef.h>
+
+namespace Core {
+
+    struct UopTableEntry {
+        W16  latency;   /* Latency in cycles, assuming ideal bypass */
+        bool pipelined; /* Unit accepts a new uop every cycle */
+        W32  units;     /* Map of execution units this uop can issue to */
+    };
+
+    class UopTable {
+        public:
+            enum { MAX_LATENCY = 255, SIZE_COUNT = 4 };
+
+            UopTable();
+
+            /* Set all sizes of one opcode, used for the built in table */
+            void set(int opcode, int latency, bool pipelined, W32 units);
+
+            /*
+             * Override entries from 'filename'. 'unit_names' gives the name
+             * of each bit of the units mask and 'present_units' the units
+             * this core instance has. Reports the first error to the log and
+             * stdout and returns false.
+             */
+            bool load(const char *filename, const char* const* unit_names,
+                    int unit_count, W32 present_units);
+
+            const UopTableEntry& get(int opcode, int size) const {
+                return entries[opcode][size];
+            }
+
+        private:
+            UopTableEntry entries[OP_MAX_OPCODE][SIZE_COUNT];
+    };
+
+};
+
+#endif // UOP_TABLE_H
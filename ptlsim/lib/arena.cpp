@@ -0,0 +1,208 @@
+#include <arena.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+Arena machine_arena;
+
+W64 heap_alloc_count = 0;
+
+Arena::Arena(size_t chunk_size) {
+  this->chunk_size = chunk_size;
+  chunks = NULL;
+  cleanups = NULL;
+  cur = end = NULL;
+  bytes = 0;
+  chunk_count = 0;
+  huge_chunk_count = 0;
+  page_mode = ARENA_PAGES_NORMAL;
+}
+
+/*
+ * Map a 2MB aligned region, preferring explicit huge pages. If none are
+ * reserved on the host we map normal pages and ask for transparent huge
+ * pages instead. 'size' must be a multiple of ARENA_HUGE_PAGE_SIZE.
+ */
+static void* map_huge_pages(size_t size) {
+  void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+  if (p == MAP_FAILED) {
+    /* Over-allocate so the chunk can be trimmed to a 2MB boundary */
+    size_t map_size = size + ARENA_HUGE_PAGE_SIZE;
+    byte* raw = (byte*)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (byte*)MAP_FAILED)
+      return NULL;
+
+    byte* start = ceilptr(raw, ARENA_HUGE_PAGE_SIZE);
+    if (start > raw)
+      munmap(raw, start - raw);
+    if (start + size < raw + map_size)
+      munmap(start + size, (raw + map_size) - (start + size));
+
+#ifdef MADV_HUGEPAGE
+    madvise(start, size, MADV_HUGEPAGE);
+#endif
+    p = start;
+  }
+
+  return p;
+}
+
+/*
+ * Sizes are rounded to whole huge pages in every mode, so the mapping can
+ * be released without knowing which mode it was allocated in.
+ */
+void* alloc_host_pages(size_t bytes, int page_mode) {
+  bytes = ceil(bytes, (size_t)ARENA_HUGE_PAGE_SIZE);
+
+  if (page_mode == ARENA_PAGES_HUGE) {
+    void* p = map_huge_pages(bytes);
+    if (p) return p;
+  }
+
+  /* Anonymous pages are zero filled and only backed once touched */
+  void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+
+void free_host_pages(void* p, size_t bytes) {
+  munmap(p, ceil(bytes, (size_t)ARENA_HUGE_PAGE_SIZE));
+}
+
+/*
+ * We build without exceptions, so there is no std::bad_alloc to throw.
+ * write() because the streams could allocate again.
+ */
+void out_of_memory(const char* where) {
+  static const char msg[] = "::ERROR::Out of host memory in ";
+  ssize_t rc = write(2, msg, sizeof(msg) - 1);
+  rc = write(2, where, strlen(where));
+  rc = write(2, "\n", 1);
+  (void)rc;
+  abort();
+}
+
+Arena::Chunk* Arena::map_huge_chunk(size_t size) {
+  Chunk* chunk = (Chunk*)map_huge_pages(size);
+  if (!chunk)
+    return NULL;
+
+  chunk->map_size = size;
+  huge_chunk_count++;
+  return chunk;
+}
+
+void Arena::new_chunk(size_t min_bytes) {
+  size_t size = max(chunk_size, min_bytes + sizeof(Chunk));
+  Chunk* chunk = NULL;
+
+  if (page_mode == ARENA_PAGES_HUGE) {
+    size = ceil(size, (size_t)ARENA_HUGE_PAGE_SIZE);
+    chunk = map_huge_chunk(size);
+  }
+
+  if (!chunk) {
+    chunk = (Chunk*)malloc(size);
+    if unlikely (!chunk)
+      out_of_memory("Arena::new_chunk");
+    chunk->map_size = 0;
+  }
+
+  chunk->next = chunks;
+  chunk->end = (byte*)chunk + size;
+  chunks = chunk;
+  chunk_count++;
+
+  cur = (byte*)(chunk + 1);
+  end = chunk->end;
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+  byte* p = ceilptr(cur, align);
+
+  if unlikely (!cur || p + size > end) {
+    if (size + align > chunk_size / 4) {
+      /*
+       * Large objects (whole cores, big tag arrays) get a chunk of their
+       * own so the rest of the current chunk keeps being used.
+       */
+      byte* saved_cur = cur;
+      byte* saved_end = end;
+      new_chunk(size + align);
+      p = ceilptr(cur, align);
+      cur = saved_cur;
+      end = saved_end;
+      bytes += size;
+      return p;
+    }
+
+    new_chunk(size + align);
+    p = ceilptr(cur, align);
+  }
+
+  cur = p + size;
+  bytes += size;
+  return p;
+}
+
+char* Arena::strdup(const char* str) {
+  size_t len = strlen(str) + 1;
+  char* p = (char*)alloc(len, 1);
+  memcpy(p, str, len);
+  return p;
+}
+
+void Arena::reset() {
+  while (cleanups) {
+    Cleanup* c = cleanups;
+    cleanups = c->next;
+    c->destroy(c->obj);
+  }
+
+  while (chunks) {
+    Chunk* chunk = chunks;
+    chunks = chunk->next;
+    if (chunk->map_size)
+      munmap(chunk, chunk->map_size);
+    else
+      free(chunk);
+  }
+
+  cur = end = NULL;
+  bytes = 0;
+  chunk_count = 0;
+  huge_chunk_count = 0;
+}
+
+/*
+ * Count every C++ heap allocation so we can check that the simulation loop
+ * does not allocate (see the "heap_allocs" run stat).
+ */
+static void* heap_alloc(size_t size) {
+  heap_alloc_count++;
+  void* p = malloc(size ? size : 1);
+
+  if unlikely (!p)
+    out_of_memory("operator new");
+
+  return p;
+}
+
+void* operator new(size_t size) {
+  return heap_alloc(size);
+}
+
+void* operator new[](size_t size) {
+  return heap_alloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
@@ -0,0 +1,133 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <globals.h>
+#include <superstl.h>
+
+/*
+ * Bump pointer allocator for objects that live as long as the simulated
+ * machine: controller and core objects, signal names, connection
+ * definitions, etc. Objects are packed next to each other in large chunks
+ * in the order they are created, and everything is released at once by
+ * reset() when the machine is torn down.
+ *
+ * Objects with a non-trivial destructor must be registered with track() so
+ * that reset() can destroy them (in reverse order of creation) before the
+ * memory is released.
+ */
+
+#define ARENA_CACHE_LINE_SIZE 64
+#define ARENA_HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+enum {
+  ARENA_PAGES_NORMAL,
+  ARENA_PAGES_HUGE,       // MAP_HUGETLB, falling back to transparent huge pages
+};
+
+class Arena {
+  public:
+    Arena(size_t chunk_size = 256 * 1024);
+    ~Arena() { reset(); }
+
+    void* alloc(size_t bytes, size_t align = sizeof(W64));
+
+    /* Allocate starting on a fresh cache line */
+    void* alloc_cache_aligned(size_t bytes) {
+      return alloc(bytes, ARENA_CACHE_LINE_SIZE);
+    }
+
+    char* strdup(const char* str);
+
+    template <typename T>
+    T* track(T* obj) {
+      Cleanup* c = (Cleanup*)alloc(sizeof(Cleanup));
+      c->obj = obj;
+      c->destroy = &destroy_object<T>;
+      c->next = cleanups;
+      cleanups = c;
+      return obj;
+    }
+
+    void reset();
+
+    /* Only affects chunks allocated after the call */
+    void set_page_mode(int mode) {
+      page_mode = mode;
+      if (mode == ARENA_PAGES_HUGE)
+        chunk_size = max(chunk_size, (size_t)ARENA_HUGE_PAGE_SIZE);
+    }
+
+    int get_page_mode() const { return page_mode; }
+
+    W64 bytes_allocated() const { return bytes; }
+    W64 chunks_allocated() const { return chunk_count; }
+    W64 huge_chunks_allocated() const { return huge_chunk_count; }
+
+  private:
+    struct Chunk {
+      Chunk* next;
+      byte* end;
+      size_t map_size;  // non-zero if the chunk was mmap()ed
+    };
+
+    struct Cleanup {
+      Cleanup* next;
+      void* obj;
+      void (*destroy)(void*);
+    };
+
+    template <typename T>
+    static void destroy_object(void* obj) { ((T*)obj)->~T(); }
+
+    Chunk* chunks;
+    Cleanup* cleanups;
+    byte* cur;
+    byte* end;
+    size_t chunk_size;
+    W64 bytes;
+    W64 chunk_count;
+    W64 huge_chunk_count;
+    int page_mode;
+
+    void new_chunk(size_t min_bytes);
+    Chunk* map_huge_chunk(size_t size);
+};
+
+inline void* operator new(size_t bytes, Arena& arena) {
+  return arena.alloc(bytes);
+}
+
+inline void* operator new[](size_t bytes, Arena& arena) {
+  return arena.alloc(bytes);
+}
+
+/*
+ * Arena holding all the objects of the current machine, released in
+ * BaseMachine::shutdown().
+ */
+extern Arena machine_arena;
+
+/*
+ * Classes whose instances should be placed in machine_arena use this in
+ * their class body. Instances start on their own cache line, and memory is
+ * given back when the arena is reset, so 'delete' only runs the destructor.
+ */
+#define MACHINE_ARENA_ALLOCATED \
+  static void* operator new(size_t bytes) { \
+    return machine_arena.alloc_cache_aligned(bytes); \
+  } \
+  static void operator delete(void* p) { }
+
+/*
+ * Zero filled, page aligned memory for large simulator tables (stats
+ * blocks), backed by huge pages in ARENA_PAGES_HUGE mode.
+ */
+void* alloc_host_pages(size_t bytes, int page_mode);
+void free_host_pages(void* p, size_t bytes);
+
+/* Report a failed host allocation on stderr and abort */
+void out_of_memory(const char* where) __attribute__((noreturn));
+
+/* Number of C++ heap allocations (operator new) since startup */
+extern W64 heap_alloc_count;
+
+#endif // ARENA_H
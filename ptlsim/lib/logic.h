@@ -21,6 +21,75 @@ inline vec8w x86_sse_ldvwu(const vec8w* m) {
 //inline vec8w x86_sse_ldvwu(const vec8w* m) { vec8w rd; asm("movdqu %[rd], %[m]" : [rd] "=x" (rd) : [m] "xm" (*m)); return rd; }
 inline void x86_sse_stvwu(vec8w* m, const vec8w ra) { asm("movdqu %[ra],%[m]" : [m] "=m" (*m) : [ra] "x" (ra) : "memory"); }
 
+//
+// Wide compares for the associative tag arrays below. When the simulator is
+// built for a host with AVX2 (optimized builds use -march=native) or
+// AVX-512BW, match() and matchany() compare ASSOC_WIDE_CHUNKS 16-byte chunks
+// per instruction and fall back to the SSE loop for the remaining chunks.
+// Each helper returns one bit per byte or word lane, lowest address first:
+// cmpeq sets it where the lane equals the target and testn where the lane
+// AND the target is zero.
+//
+#if defined(__AVX512BW__)
+#include <immintrin.h>
+#define ASSOC_WIDE_CHUNKS 4
+
+inline W64 x86_wide_cmpeqb(const void* p, vec16b target) {
+  return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p),
+      _mm512_broadcast_i32x4((__m128i)target));
+}
+
+inline W64 x86_wide_cmpeqw(const void* p, vec8w target) {
+  return _mm512_cmpeq_epi16_mask(_mm512_loadu_si512(p),
+      _mm512_broadcast_i32x4((__m128i)target));
+}
+
+inline W64 x86_wide_testnb(const void* p, vec16b target) {
+  return _mm512_testn_epi8_mask(_mm512_loadu_si512(p),
+      _mm512_broadcast_i32x4((__m128i)target));
+}
+
+inline W64 x86_wide_testnw(const void* p, vec8w target) {
+  return _mm512_testn_epi16_mask(_mm512_loadu_si512(p),
+      _mm512_broadcast_i32x4((__m128i)target));
+}
+
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define ASSOC_WIDE_CHUNKS 2
+
+// Pack the 16-bit lane results of a compare into one bit per lane
+inline W64 x86_avx2_movmskw(__m256i v) {
+  W32 m = _mm256_movemask_epi8(_mm256_packs_epi16(v, v));
+  return (m & 0xff) | ((m >> 8) & 0xff00);
+}
+
+inline W64 x86_wide_cmpeqb(const void* p, vec16b target) {
+  __m256i v = _mm256_loadu_si256((const __m256i*)p);
+  return (W32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+        _mm256_broadcastsi128_si256((__m128i)target)));
+}
+
+inline W64 x86_wide_cmpeqw(const void* p, vec8w target) {
+  __m256i v = _mm256_loadu_si256((const __m256i*)p);
+  return x86_avx2_movmskw(_mm256_cmpeq_epi16(v,
+        _mm256_broadcastsi128_si256((__m128i)target)));
+}
+
+inline W64 x86_wide_testnb(const void* p, vec16b target) {
+  __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)p),
+      _mm256_broadcastsi128_si256((__m128i)target));
+  return (W32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+        _mm256_setzero_si256()));
+}
+
+inline W64 x86_wide_testnw(const void* p, vec8w target) {
+  __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)p),
+      _mm256_broadcastsi128_si256((__m128i)target));
+  return x86_avx2_movmskw(_mm256_cmpeq_epi16(v, _mm256_setzero_si256()));
+}
+#endif
+
 extern ofstream ptl_logfile;
 extern ofstream yaml_stats_file;
 
@@ -283,6 +352,60 @@ ostream& operator <<(ostream& os, const Queue<T, size>& queue) {
   return os;
 }
 
+//
+// Lock-free ring with one producer and one consumer thread. SIZE must be a
+// power of two. The producer and consumer indices live on their own cache
+// lines so the two sides only share the slots they pass to each other.
+//
+template <class T, int SIZE>
+struct SPSCRing {
+  T slots[SIZE];
+  W64 tail __attribute__((aligned(64))); // written by the producer
+  W64 head __attribute__((aligned(64))); // written by the consumer
+
+  static const int size = SIZE;
+
+  SPSCRing() {
+    assert((SIZE & (SIZE - 1)) == 0);
+    reset();
+  }
+
+  // Only safe while neither side is running
+  void reset() {
+    head = tail = 0;
+  }
+
+  bool push(const T& data) {
+    W64 t = tail;
+    if unlikely ((t - __atomic_load_n(&head, __ATOMIC_ACQUIRE)) == SIZE)
+      return false;
+
+    slots[t & (SIZE - 1)] = data;
+    __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  bool pop(T& data) {
+    W64 h = head;
+    if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+      return false;
+
+    data = slots[h & (SIZE - 1)];
+    __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  bool empty() const {
+    return (__atomic_load_n(&head, __ATOMIC_ACQUIRE) ==
+        __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+  }
+
+  int count() const {
+    return (int)(__atomic_load_n(&tail, __ATOMIC_ACQUIRE) -
+        __atomic_load_n(&head, __ATOMIC_ACQUIRE));
+  }
+};
+
 template <typename T, int size>
 struct HistoryBuffer: public array<T, size> {
   int current;
@@ -543,9 +666,22 @@ struct FullyAssociativeTagsNbitOneHot {
   }
 
   int match(const vec16b* targetslices) const {
+    int first = 0;
+
+#ifdef ASSOC_WIDE_CHUNKS
+    // Tags are unique, so the lowest matching lane is the only match
+    for (; first + ASSOC_WIDE_CHUNKS <= chunkcount; first += ASSOC_WIDE_CHUNKS) {
+      W64 eq = x86_wide_cmpeqb(&tags[0][first], targetslices[0]);
+      for (int j = 1; j < slices; j++) {
+        eq &= x86_wide_cmpeqb(&tags[j][first], targetslices[j]);
+      }
+      if (eq) return (first * 16) + lsbindex64(eq);
+    }
+#endif
+
     vec16b sum = x86_sse_zerob();
 
-    foreach (i, chunkcount) {
+    for (int i = first; i < chunkcount; i++) {
       vec16b eq = *((vec16b*)&index_bytes_plus1_vec16b[i]);
       foreach (j, slices) {
         eq = x86_sse_pandb(x86_sse_pcmpeqb(tags[j][i], targetslices[j]), eq);
@@ -1602,8 +1738,15 @@ struct FullyAssociativeTags8bit {
 
   bitvec<size> match(const vec_t target) const {
     bitvec<size> m = 0;
+    int i = 0;
 
-    foreach (i, chunkcount) {
+#ifdef ASSOC_WIDE_CHUNKS
+    for (; i + ASSOC_WIDE_CHUNKS <= chunkcount; i += ASSOC_WIDE_CHUNKS) {
+      m = m.accum(i*16, ASSOC_WIDE_CHUNKS*16, x86_wide_cmpeqb(&tags[i], target));
+    }
+#endif
+
+    for (; i < chunkcount; i++) {
       m = m.accum(i*16, 16, x86_sse_pmovmskb(x86_sse_pcmpeqb(target, tags[i])));
     }
 
@@ -1616,10 +1759,17 @@ struct FullyAssociativeTags8bit {
 
   bitvec<size> matchany(const vec_t target) const {
     bitvec<size> m = 0;
+    int i = 0;
+
+#ifdef ASSOC_WIDE_CHUNKS
+    for (; i + ASSOC_WIDE_CHUNKS <= chunkcount; i += ASSOC_WIDE_CHUNKS) {
+      m = m.accum(i*16, ASSOC_WIDE_CHUNKS*16, x86_wide_testnb(&tags[i], target));
+    }
+#endif
 
     vec_t zero = prep(0);
 
-    foreach (i, chunkcount) {
+    for (; i < chunkcount; i++) {
       m = m.accum(i*16, 16, x86_sse_pmovmskb(x86_sse_pcmpeqb(x86_sse_pandb(tags[i], target), zero)));
     }
 
@@ -1765,7 +1915,15 @@ struct FullyAssociativeTags16bit {
   bitvec<size> match(const vec_t target) const {
     bitvec<size> m = 0;
 
-    foreach (i, chunkcount) {
+    int i = 0;
+
+#ifdef ASSOC_WIDE_CHUNKS
+    for (; i + ASSOC_WIDE_CHUNKS <= chunkcount; i += ASSOC_WIDE_CHUNKS) {
+      m = m.accum(i*8, ASSOC_WIDE_CHUNKS*8, x86_wide_cmpeqw(&tags[i], target));
+    }
+#endif
+
+    for (; i < chunkcount; i++) {
       m = m.accum(i*8, 8, x86_sse_pmovmskw(x86_sse_pcmpeqw(target, tags[i])));
     }
 
@@ -1779,9 +1937,17 @@ struct FullyAssociativeTags16bit {
   bitvec<size> matchany(const vec_t target) const {
     bitvec<size> m = 0;
 
+    int i = 0;
+
+#ifdef ASSOC_WIDE_CHUNKS
+    for (; i + ASSOC_WIDE_CHUNKS <= chunkcount; i += ASSOC_WIDE_CHUNKS) {
+      m = m.accum(i*8, ASSOC_WIDE_CHUNKS*8, x86_wide_testnw(&tags[i], target));
+    }
+#endif
+
     vec_t zero = prep(0);
 
-    foreach (i, chunkcount) {
+    for (; i < chunkcount; i++) {
       m = m.accum(i*8, 8, x86_sse_pmovmskw(x86_sse_pcmpeqw(x86_sse_pandw(tags[i], target), zero)));
     }
 
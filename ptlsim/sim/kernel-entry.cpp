@@ -0,0 +1,257 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Kernel entry accounting: break kernel time down by what entered the
+ * kernel. QEMU's helpers report every SYSCALL/SYSENTER (with the syscall
+ * number in rax), every exception and external interrupt (with its vector)
+ * and every SYSRET/SYSEXIT/IRET. Each CPU keeps a stack of open entries, so
+ * a page fault or an interrupt taken inside a syscall is charged to itself
+ * and not to the syscall. Between two events the cycles, committed
+ * instructions and L1 read misses of the CPU go to the innermost open entry.
+ *
+ * Returning to user mode closes all open entries of the CPU, and an entry
+ * from user mode starts with an empty stack, so an unmatched entry or exit
+ * (e.g. one that happened in emulation mode) only affects the current trip
+ * into the kernel.
+ *
+ * The counters are in the 'kernel_entry' stats; the log file gets a table
+ * of all entries that were seen at the end of simulation.
+ */
+
+#include <globals.h>
+#include <ptlhwdef.h>
+#include <ptl-qemu.h>
+#include <ptlsim.h>
+
+/* Linux uses int 0x80 for syscalls of 32 bit processes */
+#define LINUX_SYSCALL_VECTOR 0x80
+
+enum {
+    KERNEL_ENTRY_SYSCALL,
+    KERNEL_ENTRY_EXCEPTION,
+    KERNEL_ENTRY_INTERRUPT,
+    KERNEL_ENTRY_TYPES,
+};
+
+/* Syscall numbers past the end share the last slot */
+static const int KERNEL_ENTRY_SYSCALLS = 512;
+static const int KERNEL_ENTRY_EXCEPTIONS = 32;
+static const int KERNEL_ENTRY_VECTORS = 256;
+static const int KERNEL_ENTRY_MAX_NESTING = 16;
+
+static const char* kernel_entry_type_names[KERNEL_ENTRY_TYPES] = {
+    "syscall", "exception", "interrupt",
+};
+
+template<int size>
+struct KernelEntryTable : public Statable
+{
+    StatArray<W64, size> count;
+    StatArray<W64, size> cycles;
+    StatArray<W64, size> insns;
+    StatArray<W64, size> l1_misses;
+
+    KernelEntryTable(const char *name, Statable *parent,
+            const char** labels = NULL)
+        : Statable(name, parent)
+          , count("count", this, labels)
+          , cycles("cycles", this, labels)
+          , insns("insns", this, labels)
+          , l1_misses("l1_misses", this, labels)
+    { }
+};
+
+struct KernelEntryStats : public Statable
+{
+    KernelEntryTable<KERNEL_ENTRY_SYSCALLS> syscall;
+    KernelEntryTable<KERNEL_ENTRY_EXCEPTIONS> exception;
+    KernelEntryTable<KERNEL_ENTRY_VECTORS> interrupt;
+    StatObj<W64> nesting_overflow;
+
+    KernelEntryStats()
+        : Statable("kernel_entry")
+          , syscall("syscall", this)
+          , exception("exception", this, x86_exception_names)
+          , interrupt("interrupt", this, x86_exception_names)
+          , nesting_overflow("nesting_overflow", this)
+    { }
+} kernel_entry_stats;
+
+struct KernelEntry {
+    W8 type;
+    W16 number;
+};
+
+struct KernelEntryStack {
+    KernelEntry entries[KERNEL_ENTRY_MAX_NESTING];
+    int depth;
+
+    /* CPU counters when the innermost entry was last charged */
+    W64 cycles;
+    W64 insns;
+    W64 l1_misses;
+};
+
+static KernelEntryStack kernel_entry_stacks[MAX_CONTEXTS];
+
+template<int size>
+static inline void charge_table(KernelEntryTable<size>& table, int number,
+        W64 cycles, W64 insns, W64 l1_misses)
+{
+    table.cycles(kernel_stats)[number] += cycles;
+    table.insns(kernel_stats)[number] += insns;
+    table.l1_misses(kernel_stats)[number] += l1_misses;
+}
+
+/* Charge everything since the last event to the innermost open entry */
+static void charge_entry(Context& ctx, KernelEntryStack& stack)
+{
+    W64 cycles = sim_cycle - stack.cycles;
+    W64 insns = ctx.kernel_instructions_commited - stack.insns;
+    W64 l1_misses = ctx.l1_read_misses - stack.l1_misses;
+
+    stack.cycles = sim_cycle;
+    stack.insns = ctx.kernel_instructions_commited;
+    stack.l1_misses = ctx.l1_read_misses;
+
+    if (stack.depth == 0)
+        return;
+
+    KernelEntry& entry = stack.entries[stack.depth - 1];
+
+    switch (entry.type) {
+        case KERNEL_ENTRY_SYSCALL:
+            charge_table(kernel_entry_stats.syscall, entry.number,
+                    cycles, insns, l1_misses);
+            break;
+        case KERNEL_ENTRY_EXCEPTION:
+            charge_table(kernel_entry_stats.exception, entry.number,
+                    cycles, insns, l1_misses);
+            break;
+        case KERNEL_ENTRY_INTERRUPT:
+            charge_table(kernel_entry_stats.interrupt, entry.number,
+                    cycles, insns, l1_misses);
+            break;
+    }
+}
+
+static void kernel_entry(CPUX86State* env, int type, int number)
+{
+    if (!in_simulation)
+        return;
+
+    Context& ctx = contextof(env->cpu_index);
+    KernelEntryStack& stack = kernel_entry_stacks[env->cpu_index];
+
+    charge_entry(ctx, stack);
+
+    if ((env->hflags & HF_CPL_MASK) == 3)
+        stack.depth = 0;
+
+    switch (type) {
+        case KERNEL_ENTRY_SYSCALL:
+            kernel_entry_stats.syscall.count(kernel_stats)[number]++;
+            break;
+        case KERNEL_ENTRY_EXCEPTION:
+            kernel_entry_stats.exception.count(kernel_stats)[number]++;
+            break;
+        case KERNEL_ENTRY_INTERRUPT:
+            kernel_entry_stats.interrupt.count(kernel_stats)[number]++;
+            break;
+    }
+
+    /* Too deep, keep charging the innermost entry we could record */
+    if unlikely (stack.depth == KERNEL_ENTRY_MAX_NESTING) {
+        kernel_entry_stats.nesting_overflow(kernel_stats)++;
+        return;
+    }
+
+    KernelEntry& entry = stack.entries[stack.depth++];
+    entry.type = type;
+    entry.number = number;
+}
+
+void ptl_kernel_syscall(CPUX86State* env)
+{
+    W64 number = (W32)env->regs[R_EAX];
+    kernel_entry(env, KERNEL_ENTRY_SYSCALL,
+            (int)min(number, (W64)KERNEL_ENTRY_SYSCALLS - 1));
+}
+
+void ptl_kernel_interrupt(CPUX86State* env, int intno, int is_int, int is_hw)
+{
+    if (is_int && intno == LINUX_SYSCALL_VECTOR) {
+        ptl_kernel_syscall(env);
+    } else if (!is_hw && intno < KERNEL_ENTRY_EXCEPTIONS) {
+        kernel_entry(env, KERNEL_ENTRY_EXCEPTION, intno);
+    } else {
+        kernel_entry(env, KERNEL_ENTRY_INTERRUPT, intno & 0xff);
+    }
+}
+
+void ptl_kernel_exit(CPUX86State* env)
+{
+    if (!in_simulation)
+        return;
+
+    Context& ctx = contextof(env->cpu_index);
+    KernelEntryStack& stack = kernel_entry_stacks[env->cpu_index];
+
+    charge_entry(ctx, stack);
+
+    if ((env->hflags & HF_CPL_MASK) == 3) {
+        stack.depth = 0;
+    } else if (stack.depth > 0) {
+        stack.depth--;
+    }
+}
+
+template<int size>
+static void print_table(ostream& os, int type,
+        const KernelEntryTable<size>& table, Stats* stats)
+{
+    foreach (i, size) {
+        W64 count = table.count(stats)[i];
+        W64 cycles = table.cycles(stats)[i];
+
+        if (count == 0 && cycles == 0)
+            continue;
+
+        W64 insns = table.insns(stats)[i];
+        W64 l1_misses = table.l1_misses(stats)[i];
+
+        os << "  ", padstring(kernel_entry_type_names[type], -10), " ";
+        if (type == KERNEL_ENTRY_SYSCALL) {
+            os << intstring(i, -16);
+        } else {
+            os << padstring(x86_exception_names[i], -16);
+        }
+        os << " ", intstring(count, 12), " ", intstring(cycles, 14),
+           " ", intstring(insns, 14), " ", intstring(l1_misses, 12),
+           " ", intstring(count ? (cycles / count) : 0, 10), endl;
+    }
+}
+
+/**
+ * @brief Print the per syscall, exception and interrupt vector table
+ *
+ * @param os Stream to print the table to
+ */
+void print_kernel_entry_table(ostream& os)
+{
+    os << "Kernel entries:", endl;
+    os << "  ", padstring("type", -10), " ", padstring("number", -16), " ",
+       padstring("count", 12), " ", padstring("cycles", 14), " ",
+       padstring("insns", 14), " ", padstring("l1_misses", 12), " ",
+       padstring("cyc/entry", 10), endl;
+
+    print_table(os, KERNEL_ENTRY_SYSCALL, kernel_entry_stats.syscall,
+            kernel_stats);
+    print_table(os, KERNEL_ENTRY_EXCEPTION, kernel_entry_stats.exception,
+            kernel_stats);
+    print_table(os, KERNEL_ENTRY_INTERRUPT, kernel_entry_stats.interrupt,
+            kernel_stats);
+}
@@ -15,6 +15,9 @@
 #include <basecore.h>
 #include <statsBuilder.h>
 #include <memoryHierarchy.h>
+#include <shadowCache.h>
+#include <arena.h>
+#include <decode.h>
 
 #include <cstdarg>
 
@@ -79,6 +82,13 @@ void BaseMachine::shutdown()
 
 	controllers.clear();
 
+	foreach (i, shadow_caches.count()) {
+		ShadowCache* shadow = shadow_caches[i];
+		delete shadow;
+	}
+
+	shadow_caches.clear();
+
 	foreach (i, interconnects.count()) {
 		Interconnect* intercon = interconnects[i];
 		delete intercon;
@@ -90,6 +100,11 @@ void BaseMachine::shutdown()
 		delete memoryHierarchyPtr;
 		memoryHierarchyPtr = NULL;
 	}
+
+	connections.clear();
+
+	/* Release every object of this machine in one go */
+	machine_arena.reset();
 }
 
 /**
@@ -138,6 +153,12 @@ bool BaseMachine::init(PTLsimConfig& config)
 
     init_qemu_io_events();
 
+    /* Each snapshot, reset and copy of a Stats block touches this much */
+    W64 stats_used = StatsBuilder::get().get_used_size();
+    ptl_logfile << "Stats block: " << stats_used << " of " << STATS_SIZE <<
+        " bytes in use, " << stats_used / max((int)cores.count(), 1) <<
+        " bytes per core" << endl;
+
     return 1;
 }
 
@@ -184,6 +205,9 @@ void BaseMachine::dump_configuration(ostream& os) const
 	foreach (i, controllers.count())
 		controllers[i]->dump_configuration(*config_yaml);
 
+	foreach (i, shadow_caches.count())
+		shadow_caches[i]->dump_configuration(*config_yaml);
+
 	/* Now dump all interconnections */
 	foreach (i, interconnects.count())
 		interconnects[i]->dump_configuration(*config_yaml);
@@ -217,6 +241,14 @@ int BaseMachine::run(PTLsimConfig& config)
         logenable = 1;
     }
 
+    // QEMU may have rewritten code pages while it was emulating, check
+    // every decoded block once as after a TLB flush
+    if(first_run) {
+        foreach (i, NUM_SIM_CORES) {
+            bbcache[i].flush_tlb(i);
+        }
+    }
+
     // reset all cores for fresh start:
     foreach (cur_core, cores.count()){
         if(first_run) {
@@ -262,7 +294,11 @@ int BaseMachine::run(PTLsimConfig& config)
 			if (logable(4))
 				ptl_logfile << "Per-Cycle-Signal : " <<
 					coremodel.per_cycle_signals[i]->get_name() << endl;
+			int coreid = coremodel.per_cycle_coreids[i];
+			if (coreid >= 0)
+				memoryHierarchyPtr->begin_core_cycle(coreid);
 			exiting |= coremodel.per_cycle_signals[i]->emit(NULL);
+			memoryHierarchyPtr->end_core_cycle();
 		}
 
         sim_cycle++;
@@ -348,7 +384,8 @@ W8 BaseMachine::get_next_coreid()
 ConnectionDef* BaseMachine::get_new_connection_def(const char* interconnect,
         const char* name, int id)
 {
-    ConnectionDef* conn = new ConnectionDef();
+    ConnectionDef* conn = machine_arena.track(
+            new (machine_arena) ConnectionDef());
     conn->interconnect = interconnect;
     conn->name << name << id;
     connections.push(conn);
@@ -358,7 +395,8 @@ ConnectionDef* BaseMachine::get_new_connection_def(const char* interconnect,
 void BaseMachine::add_new_connection(ConnectionDef* conn,
         const char* cont, int type)
 {
-    SingleConnection* sg = new SingleConnection();
+    SingleConnection* sg = machine_arena.track(
+            new (machine_arena) SingleConnection());
     sg->controller = cont;
     sg->type = type;
 
@@ -618,6 +656,35 @@ void ControllerBuilder::add_new_cont(BaseMachine& machine, W8 coreid,
     machine.controller_hash.add(cont_name_t, cont);
 }
 
+/**
+ * @brief Create shadow cache 'name'<id> of cache type 'type' and attach it
+ * to the cache controller 'shadow_of'<id>
+ */
+void ControllerBuilder::add_shadow_cache(BaseMachine& machine, W8 id,
+        const char* name, const char* shadow_of, W8 type)
+{
+    stringbuf shadow_name, cont_name;
+    shadow_name << name << id;
+    cont_name << shadow_of << id;
+
+    Controller** cont = machine.controller_hash.get(cont_name);
+
+    if(!cont) {
+        stringbuf err;
+        err << "::ERROR::Shadow cache '" << shadow_name << "' follows '"
+            << cont_name << "' which is not a cache of this machine."
+            << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(cont);
+    }
+
+    ShadowCache* shadow = new ShadowCache(shadow_name.buf, type,
+            machine.memoryHierarchyPtr);
+    machine.shadow_caches.push(shadow);
+    (*cont)->add_shadow_cache(shadow);
+}
+
 /* Cache Interconnect Builders */
 
 InterconnectBuilder::InterconnectBuilder(const char* name)
@@ -684,13 +751,15 @@ void marss_add_event(Signal* signal, int delay, void* arg)
  * @brief Register Signal to call at each cycle
  *
  * @param signal Signal object to register
+ * @param coreid Core whose cycle the signal runs, -1 for other modules
  *
  * Use this registration function to add an event that will be executed at each
  * simulation cycle.
  */
-void marss_register_per_cycle_event(Signal *signal)
+void marss_register_per_cycle_event(Signal *signal, int coreid)
 {
 	coremodel.per_cycle_signals.push(signal);
+	coremodel.per_cycle_coreids.push(coreid);
 }
 
 } // extern "C"
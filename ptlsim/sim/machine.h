@@ -26,6 +26,7 @@ namespace Memory {
     struct Controller;
     struct Interconnect;
     struct MemoryHierarchy;
+    struct ShadowCache;
 };
 
 typedef Hashtable<const char*, bool, 1> BoolOptions;
@@ -46,9 +47,11 @@ struct ConnectionDef {
 struct BaseMachine: public PTLsimMachine {
     dynarray<Core::BaseCore*> cores;
     dynarray<Memory::Controller*> controllers;
+    dynarray<Memory::ShadowCache*> shadow_caches;
     dynarray<Memory::Interconnect*> interconnects;
     dynarray<ConnectionDef*> connections;
 	dynarray<Signal*> per_cycle_signals;
+	dynarray<int> per_cycle_coreids;	/* -1 if the signal is not a core's */
 
     Hashtable<const char*, Memory::Controller*, 1> controller_hash;
     Hashtable<const char*, BoolOptions*, 1> bool_options;
@@ -132,6 +135,8 @@ struct ControllerBuilder {
     static Hashtable<const char*, ControllerBuilder*, 1> *controllerBuilders;
     static void add_new_cont(BaseMachine& machine, W8 coreid,
             const char* name, const char* cont_name, W8 type);
+    static void add_shadow_cache(BaseMachine& machine, W8 id,
+            const char* name, const char* shadow_of, W8 type);
 	virtual void config_changed() {}
 };
 
@@ -147,7 +152,7 @@ struct InterconnectBuilder {
 
 extern "C" {
 void marss_add_event(Signal* signal, int delay, void* arg);
-void marss_register_per_cycle_event(Signal *signal);
+void marss_register_per_cycle_event(Signal *signal, int coreid = -1);
 }
 
 #endif // MACHINE_H
@@ -42,6 +42,7 @@ extern "C" {
 
 #include <ptl-qemu.h>
 #include <ptlsim.h>
+#include <rtm.h>
 
 #include <cacheConstants.h>
 
@@ -398,6 +399,36 @@ int ptl_cpuid(uint32_t index, uint32_t count, uint32_t *eax, uint32_t *ebx,
      * for the cache info and others
      */
 
+    /* Leaf 7 reports RTM, raise the maximum basic leaf to include it */
+    if (config.rtm && cpu_single_env) {
+        CPUX86State* env = cpu_single_env;
+        uint32_t max_level = max(env->cpuid_level, (uint32_t)7);
+
+        if (index == 0) {
+            *eax = max_level;
+            *ebx = env->cpuid_vendor1;
+            *edx = env->cpuid_vendor2;
+            *ecx = env->cpuid_vendor3;
+            return 1;
+        }
+
+        if (index == 7 && count == 0) {
+            /* Keep the features the machine reports, if any, and add RTM */
+            PTLsimMachine* machine = PTLsimMachine::getmachine(config.core_name);
+            if (!machine || !machine->handle_cpuid ||
+                    machine->handle_cpuid(index, count, eax, ebx, ecx, edx) <= 0) {
+                *eax = *ebx = *ecx = *edx = 0;
+            }
+            *ebx |= RTM_CPUID_7_0_EBX;
+            return 1;
+        }
+
+        if (index == 7 || (index > env->cpuid_level && index <= max_level)) {
+            *eax = *ebx = *ecx = *edx = 0;
+            return 1;
+        }
+    }
+
     PTLsimMachine* machine = PTLsimMachine::getmachine(config.core_name);
     if (machine && machine->handle_cpuid)
         return machine->handle_cpuid(index, count, eax, ebx, ecx, edx);
@@ -613,6 +644,31 @@ int Context::copy_from_vm(void* target, Waddr source, int bytes, PageFaultErrorC
     int n = 0 ;
     pfec = 0;
 
+    /*
+     * If every page of the source is RAM-backed in QEMU's TLB copy the
+     * bytes directly, only faulting or MMIO sources need QEMU's help.
+     */
+    int mmu_index = (forexec) ? cpu_mmu_index((CPUState*)this) :
+        ((kernel_mode) ? 0 : MMU_USER_IDX);
+    int bytes_in_first_page = min(TARGET_PAGE_SIZE - lowbits(source,
+                TARGET_PAGE_BITS), (Waddr)bytes);
+    byte* host_lo = get_host_ram_ptr(source, bytes_in_first_page,
+            mmu_index, false, forexec);
+    byte* host_hi = (bytes_in_first_page == bytes) ? host_lo :
+        get_host_ram_ptr(source + bytes_in_first_page,
+                bytes - bytes_in_first_page, mmu_index, false, forexec);
+
+    if likely (host_lo && host_hi) {
+        memcpy(target, host_lo, bytes_in_first_page);
+        memcpy((byte*)target + bytes_in_first_page, host_hi,
+                bytes - bytes_in_first_page);
+
+        if(logable(10))
+            ptl_logfile << "Copied ", bytes, " bytes from ", source,
+                        " using host RAM pointer\n";
+        return bytes;
+    }
+
     setup_qemu_switch_all_ctx(*this);
 
     if(logable(10))
@@ -945,12 +1001,186 @@ void Context::propagate_x86_exception(byte exception, W32 errorcode , Waddr virt
     setup_ptlsim_switch_all_ctx(*this);
 }
 
+/*
+ * MMIO accounting and fast reads
+ *
+ * QEMU hands out one io_mem index per registered device region, so we tag
+ * each index with the device sitting at its guest physical address and use
+ * that tag for per-device stats. Register reads of the local APIC and the
+ * IOAPIC have no side effects, so they are dispatched straight to the device
+ * callback without converting the full CPU state back to QEMU.
+ */
+enum {
+    MMIO_DEV_OTHER,
+    MMIO_DEV_APIC,
+    MMIO_DEV_IOAPIC,
+    MMIO_DEV_HPET,
+    MMIO_DEV_VGA,
+    MMIO_DEV_COUNT,
+};
+
+static const char* mmio_device_names[MMIO_DEV_COUNT] = {
+    "other", "apic", "ioapic", "hpet", "vga",
+};
+
+static W8 mmio_device_of[IO_MEM_NB_ENTRIES];
+
+struct MMIOStats : public Statable
+{
+    StatArray<W64, MMIO_DEV_COUNT> reads;
+    StatArray<W64, MMIO_DEV_COUNT> fast_reads;
+    StatArray<W64, MMIO_DEV_COUNT> writes;
+    StatArray<W64, MMIO_DEV_COUNT> host_cycles;
+
+    MMIOStats()
+        : Statable("mmio")
+          , reads("reads", this, mmio_device_names)
+          , fast_reads("fast_reads", this, mmio_device_names)
+          , writes("writes", this, mmio_device_names)
+          , host_cycles("host_cycles", this, mmio_device_names)
+    { }
+} mmiostats;
+
+static int mmio_device_at(W64 physaddr) {
+    if (physaddr >= 0xfee00000ULL && physaddr < 0xfee01000ULL)
+        return MMIO_DEV_APIC;
+    if (physaddr >= 0xfec00000ULL && physaddr < 0xfec01000ULL)
+        return MMIO_DEV_IOAPIC;
+    if (physaddr >= 0xfed00000ULL && physaddr < 0xfed01000ULL)
+        return MMIO_DEV_HPET;
+    if (physaddr >= 0xa0000ULL && physaddr < 0xc0000ULL)
+        return MMIO_DEV_VGA;
+    return MMIO_DEV_OTHER;
+}
+
+extern "C" void ptl_register_io_mem_base(uint64_t phys_offset, uint64_t start_addr)
+{
+    /* RAM, ROM and the internal QEMU handlers are not devices */
+    if ((phys_offset & ~TARGET_PAGE_MASK) <= IO_MEM_NOTDIRTY)
+        return;
+
+    int index = (phys_offset >> IO_MEM_SHIFT) & (IO_MEM_NB_ENTRIES - 1);
+    mmio_device_of[index] = mmio_device_at(start_addr);
+}
+
+/*
+ * Returns the io_mem index serving 'virtaddr' if it is mapped to a device
+ * in the current TLB, -1 otherwise. 'ioaddr' is set to the iotlb value
+ * used by QEMU's io_read/io_write.
+ */
+static int mmio_io_index(Context& ctx, Waddr virtaddr, bool store,
+        target_phys_addr_t& ioaddr) {
+    int mmu_idx = cpu_mmu_index((CPUState*)&ctx);
+    int index = (virtaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+    CPUTLBEntry& entry = ctx.tlb_table[mmu_idx][index];
+    target_ulong tlb_addr = (store) ? entry.addr_write : entry.addr_read;
+
+    if ((virtaddr & TARGET_PAGE_MASK) !=
+            (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK)))
+        return -1;
+
+    if (!(tlb_addr & TLB_MMIO))
+        return -1;
+
+    ioaddr = ctx.iotlb[mmu_idx][index];
+    return (ioaddr >> IO_MEM_SHIFT) & (IO_MEM_NB_ENTRIES - 1);
+}
+
+static inline Stats* mmio_stats_block(Context& ctx) {
+    return (ctx.kernel_mode) ? kernel_stats : user_stats;
+}
+
+/*
+ * Read a side-effect free device register without switching to QEMU.
+ * Returns false if the access has to go through the normal QEMU path.
+ */
+static bool mmio_fast_read(Context& ctx, Waddr virtaddr, int sizeshift,
+        W64& data) {
+    if unlikely (config.disable_fast_mmio)
+        return false;
+
+    /* Unaligned accesses are split by QEMU, leave those to it */
+    if unlikely (virtaddr & ((1 << sizeshift) - 1))
+        return false;
+
+    target_phys_addr_t ioaddr;
+    int index = mmio_io_index(ctx, virtaddr, false, ioaddr);
+    if (index < 0)
+        return false;
+
+    int dev = mmio_device_of[index];
+    if (dev != MMIO_DEV_APIC && dev != MMIO_DEV_IOAPIC)
+        return false;
+
+    W64 start = rdtsc();
+
+    /* APIC callbacks find their APIC through cpu_single_env */
+    set_cpu_env((CPUX86State*)&ctx);
+    ctx.mem_io_vaddr = virtaddr;
+
+    target_phys_addr_t physaddr = (ioaddr & TARGET_PAGE_MASK) + virtaddr;
+    void* opaque = io_mem_opaque[index];
+
+    if (sizeshift < 3) {
+        data = io_mem_read[index][sizeshift](opaque, physaddr);
+    } else {
+        data = io_mem_read[index][2](opaque, physaddr);
+        data |= (W64)io_mem_read[index][2](opaque, physaddr + 4) << 32;
+    }
+
+    Stats* stats = mmio_stats_block(ctx);
+    mmiostats.reads(stats)[dev]++;
+    mmiostats.fast_reads(stats)[dev]++;
+    mmiostats.host_cycles(stats)[dev] += rdtsc() - start;
+
+    if(logable(10))
+        ptl_logfile << "MMIO FAST READ addr: ", hexstring(virtaddr, 64),
+                    " data: ", hexstring(data, 64), " size: ",
+                    sizeshift, " dev: ", mmio_device_names[dev], endl;
+    return true;
+}
+
+/* Device of an MMIO page, checked before QEMU refills the TLB entry */
+static int mmio_device_of_addr(Context& ctx, Waddr virtaddr, bool store) {
+    target_phys_addr_t ioaddr;
+    int index = mmio_io_index(ctx, virtaddr, store, ioaddr);
+    return (index < 0) ? MMIO_DEV_OTHER : mmio_device_of[index];
+}
+
 W64 Context::loadvirt(Waddr virtaddr, int sizeshift) {
     Waddr addr = virtaddr;
     assert(virtaddr > 0xffff);
-    setup_qemu_switch_all_ctx(*this);
     W64 data = 0;
 
+    if unlikely (rtm_depth && !rtm_doomed)
+        rtm_execute_load(*this, virtaddr, 1 << sizeshift);
+
+    /* RAM-backed pages are read directly, without switching to QEMU */
+    byte* host = get_host_ram_ptr(virtaddr, 1 << sizeshift,
+            (kernel_mode) ? 0 : MMU_USER_IDX, false);
+    if likely (host) {
+        switch(sizeshift) {
+            case 0: data = (W64)ldub_raw(host); break;
+            case 1: data = (W64)lduw_raw(host); break;
+            case 2: data = (W64)(W32)ldl_raw(host); break;
+            default: data = ldq_raw(host);
+        }
+
+        if(logable(10))
+            ptl_logfile << "Context::loadvirt addr[", hexstring(addr, 64),
+                        "] data[", hexstring(data, 64), "] host[",
+                        (void*)host, "]\n";
+        return data;
+    }
+
+    if (mmio_fast_read(*this, virtaddr, sizeshift, data))
+        return data;
+
+    int mmio_dev = mmio_device_of_addr(*this, virtaddr, false);
+    W64 mmio_start = rdtsc();
+
+    setup_qemu_switch_all_ctx(*this);
+
     bool mmio = is_mmio_addr(virtaddr, 0);
 
     if likely (!kernel_mode && !mmio) {
@@ -1006,6 +1236,12 @@ W64 Context::loadvirt(Waddr virtaddr, int sizeshift) {
 
     setup_ptlsim_switch_all_ctx(*this);
 
+    if (mmio) {
+        Stats* stats = mmio_stats_block(*this);
+        mmiostats.reads(stats)[mmio_dev]++;
+        mmiostats.host_cycles(stats)[mmio_dev] += rdtsc() - mmio_start;
+    }
+
     return data;
 }
 
@@ -1046,24 +1282,56 @@ W64 Context::loadphys(Waddr addr, bool internal, int sizeshift) {
         return data;
     }
 
+    /* Plain host memory read, no QEMU state is needed for it */
     W64 data = 0;
     Waddr orig_addr = addr;
     addr = floor(addr, 8);
-    setup_qemu_switch_all_ctx(*this);
     data = ldq_raw((uint8_t*)addr);
 
     if(logable(10))
         ptl_logfile << "Context::loadphys addr[", hexstring(addr, 64),
                     "] data[", hexstring(data, 64), "] origaddr[",
                     hexstring(orig_addr, 64), "]\n";
-    setup_ptlsim_switch_all_ctx(*this);
     return data;
 }
 
 W64 Context::storemask_virt(Waddr virtaddr, W64 data, byte bytemask, int sizeshift) {
-    setup_qemu_switch_all_ctx(*this);
     Waddr paddr = floor(virtaddr, 8);
 
+    /* Stores of an aborted transaction are dropped until it rolls back */
+    if unlikely (rtm_active_transactions | rtm_doomed) {
+        if (!rtm_store(*this, virtaddr, 1 << sizeshift))
+            return data;
+    }
+
+    /*
+     * Pages holding translated code are not-dirty in QEMU's TLB, so
+     * get_host_ram_ptr() sends those stores through QEMU for SMC handling.
+     */
+    byte* host = get_host_ram_ptr(virtaddr, 1 << sizeshift,
+            (kernel_mode) ? 0 : MMU_USER_IDX, true);
+    if likely (host) {
+        switch(sizeshift) {
+            case 0: stb_raw(host, (W8)data); break;
+            case 1: stw_raw(host, (W16)data); break;
+            case 2: stl_raw(host, (W32)data); break;
+            default: stq_raw(host, data);
+        }
+
+        smc_setdirty_host(host);
+
+        if(logable(10))
+            ptl_logfile << "Context::storemask addr[", hexstring(paddr, 64),
+                        "] data[", hexstring(data, 64), "] host[",
+                        (void*)host, "]\n";
+        return data;
+    }
+
+    int mmio_dev = mmio_device_of_addr(*this, virtaddr, true);
+    W64 mmio_start = rdtsc();
+
+    setup_qemu_switch_all_ctx(*this);
+
     if(logable(10))
         ptl_logfile << "Trying to write to addr: ", hexstring(paddr, 64),
                     " with bytemask ", bytemask, " data: ", hexstring(
@@ -1090,6 +1358,10 @@ W64 Context::storemask_virt(Waddr virtaddr, W64 data, byte bytemask, int sizeshi
             ptl_logfile << "MMIO WRITE addr: ", hexstring(virtaddr, 64),
                         " data: ", hexstring(data, 64), " size: ",
                         sizeshift, endl;
+
+        Stats* stats = mmio_stats_block(*this);
+        mmiostats.writes(stats)[mmio_dev]++;
+        mmiostats.host_cycles(stats)[mmio_dev] += rdtsc() - mmio_start;
         return data;
     }
 
@@ -1201,7 +1473,6 @@ W64 Context::store_internal(Waddr addr, W64 data, byte bytemask) {
 
 W64 Context::storemask(Waddr paddr, W64 data, byte bytemask) {
     W64 old_data = 0;
-    setup_qemu_switch_all_ctx(*this);
     if(logable(10))
         ptl_logfile << "Trying to write to addr: ", hexstring(paddr, 64),
                     " with bytemask ", bytemask, " data: ", hexstring(
@@ -1284,9 +1555,104 @@ bool Context::try_handle_fault(Waddr virtaddr, int store) {
     return true;
 }
 
+HostPhysPageMap hvirt_gphys_map;
+
+void HostPhysPageMap::resize(W64 slots) {
+    Entry* old_table = table;
+    W64 old_slots = (table) ? mask + 1 : 0;
+
+    table = (Entry*)calloc(slots, sizeof(Entry));
+    if unlikely (!table)
+        out_of_memory("HostPhysPageMap::resize");
+    mask = slots - 1;
+    count = 0;
+
+    foreach (i, old_slots) {
+        if (old_table[i].hostpage)
+            add(old_table[i].hostpage, old_table[i].guestpage);
+    }
+
+    free(old_table);
+}
+
+void HostPhysPageMap::add(Waddr host_vaddr, Waddr guest_paddr) {
+    W64 hostpage = host_vaddr & TARGET_PAGE_MASK;
+
+    if unlikely (!hostpage) return;
+
+    if unlikely (!table) {
+        /* Start with room for all of guest RAM at half load */
+        W64 pages = max((W64)(qemu_ram_size >> TARGET_PAGE_BITS), 4096ULL);
+        resize(1ULL << (x86_bsr64(pages) + 1));
+    } else if unlikely ((count + 1) * 2 > mask + 1) {
+        resize((mask + 1) * 2);
+    }
+
+    W64 slot = slotof(hostpage, mask);
+    while (table[slot].hostpage && table[slot].hostpage != hostpage)
+        slot = (slot + 1) & mask;
+
+    if (!table[slot].hostpage) count++;
+    table[slot].hostpage = hostpage;
+    table[slot].guestpage = guest_paddr & TARGET_PAGE_MASK;
+}
+
+void HostPhysPageMap::remove(Waddr host_vaddr) {
+    W64 hostpage = host_vaddr & TARGET_PAGE_MASK;
+
+    if unlikely (!table || !hostpage) return;
+
+    W64 slot = slotof(hostpage, mask);
+    while (table[slot].hostpage != hostpage) {
+        if (!table[slot].hostpage) return;
+        slot = (slot + 1) & mask;
+    }
+
+    /*
+     * Move the following entries of the probe run back into the hole when
+     * their home slot allows it, so lookups never stop at an empty slot
+     * before reaching them.
+     */
+    W64 hole = slot;
+    for (W64 next = (hole + 1) & mask; table[next].hostpage;
+            next = (next + 1) & mask) {
+        W64 home = slotof(table[next].hostpage, mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table[hole] = table[next];
+            hole = next;
+        }
+    }
+
+    table[hole].hostpage = 0;
+    table[hole].guestpage = 0;
+    count--;
+}
+
+void HostPhysPageMap::reset() {
+    free(table);
+    table = NULL;
+    mask = 0;
+    count = 0;
+}
+
 extern "C" void ptl_add_phys_memory_mapping(int8_t cpu_index, uint64_t host_vaddr, uint64_t guest_paddr)
 {
-  contextof(cpu_index).hvirt_gphys_map[(Waddr)host_vaddr] = (Waddr)guest_paddr;
+  hvirt_gphys_map.add((Waddr)host_vaddr, (Waddr)guest_paddr);
+}
+
+/* Device DMA and QEMU helpers bypass the simulated cores' committed stores */
+extern "C" void ptl_phys_memory_written(void* host_vaddr, uint64_t bytes)
+{
+    if (!in_simulation || !bytes) return;
+
+    Waddr host = floor((Waddr)host_vaddr, TARGET_PAGE_SIZE);
+    Waddr end = (Waddr)host_vaddr + bytes;
+    Waddr paddr;
+
+    for (; host < end; host += TARGET_PAGE_SIZE) {
+        if (hvirt_gphys_map.lookup(host, paddr))
+            smc_setdirty(paddr);
+    }
 }
 
 void ptl_quit()
@@ -1650,6 +2016,11 @@ void ptl_qemu_initialized(void)
 {
     qemu_initialized = 1;
 
+    /* In server mode the rest runs in each job's child, with its config */
+    if (config.server_socket.set()) {
+        ptl_server_wait_for_job();
+    }
+
     // If config.run_tests is enabled, then run testcases
     if(config.run_tests) {
         run_tests();
@@ -172,9 +172,10 @@ int ptl_cpuid(uint32_t index, uint32_t count, uint32_t *eax, uint32_t *ebx,
 
 /*
  * ptl_flush_bbcache
- * context_id	: ID of the context of which the BasicBlockCache will be
- *				  flushed
- * working		: Flush all the decoded cache on tlb flush
+ * context_id	: ID of the context whose TLB was flushed, -1 to flush
+ *				  the decoded code of all contexts
+ * working		: A TLB flush keeps decoded blocks, each one is checked
+ *				  against the new translation when it is fetched again
  */
 void ptl_flush_bbcache(int8_t context_id);
 
@@ -189,6 +190,25 @@ extern uint8_t ptl_stable_state;
 
 void ptl_add_phys_memory_mapping(int8_t cpu_index, uint64_t host_vaddr, uint64_t guest_paddr);
 
+/*
+ * ptl_phys_memory_written
+ * host_vaddr	: Host address of guest RAM written by a device or QEMU
+ * bytes		: Number of bytes written
+ * returns void
+ * working		: Mark decoded code on the written pages as modified, the
+ *				  simulated cores re-decode it before it commits again
+ */
+void ptl_phys_memory_written(void* host_vaddr, uint64_t bytes);
+
+/*
+ * ptl_register_io_mem_base
+ * phys_offset	: QEMU phys_offset of the registered memory region
+ * start_addr	: Guest physical address the region is mapped at
+ * returns void
+ * working		: Tag the device's io_mem index for MMIO stats and fast reads
+ */
+void ptl_register_io_mem_base(uint64_t phys_offset, uint64_t start_addr);
+
 /*
  * qemu_take_screenshot
  * filename     : Name of the file to store screenshot of VGA screen
@@ -228,6 +248,47 @@ extern uint8_t sim_update_clock_offset;
  */
 void ptl_simpoint_reached(int cpuid);
 
+/**
+ * @brief CPU enters the kernel with SYSCALL or SYSENTER
+ *
+ * @param env CPU Context, its rax holds the syscall number
+ */
+void ptl_kernel_syscall(CPUX86State* env);
+
+/**
+ * @brief CPU takes an exception, software or external interrupt
+ *
+ * @param env CPU Context, before the event is delivered
+ * @param intno Vector of the event
+ * @param is_int Set for 'int N' instructions
+ * @param is_hw Set for external interrupts
+ */
+void ptl_kernel_interrupt(CPUX86State* env, int intno, int is_int, int is_hw);
+
+/**
+ * @brief CPU returned with SYSRET, SYSEXIT or IRET
+ *
+ * @param env CPU Context, after the return
+ */
+void ptl_kernel_exit(CPUX86State* env);
+
+/**
+ * @brief Abort the CPU's transaction before it takes an exception or interrupt
+ *
+ * @param env CPU Context, restored to the transaction's fallback on abort
+ * @param is_hw Set for external interrupts
+ *
+ * @return 1 if the exception is suppressed by the abort
+ */
+int ptl_rtm_interrupt(CPUX86State* env, int is_hw);
+
+/**
+ * @brief Check if XBEGIN, XEND, XABORT and XTEST are enabled (-rtm)
+ *
+ * @return 1 if they are, QEMU raises #UD for them otherwise
+ */
+uint8_t ptl_rtm_enabled(void);
+
 /**
  * @brief Initialize simpoints once we see simpoint configuration options
  */
@@ -262,6 +323,14 @@ void set_cpu_fast_fwd(void);
  */
 void ptl_qemu_initialized(void);
 
+/**
+ * @brief Serve simulation jobs from a Unix socket (-server option)
+ *
+ * Never returns in the server process. Each job runs in a forked child,
+ * where this returns once the job's checkpoint and options are loaded.
+ */
+void ptl_server_wait_for_job(void);
+
 #ifdef __cplusplus
 }
 #endif
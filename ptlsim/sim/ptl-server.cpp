@@ -0,0 +1,224 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Simulation server mode: keep one QEMU process with all devices and disk
+ * images initialized, and run each job in a forked child of it.
+ *
+ * Start the server by giving '-server <socket path>' in the simconfig file.
+ * Clients connect to the Unix socket and send one job per line:
+ *
+ *    run <checkpoint> <simconfig options>
+ *    quit
+ *
+ * For example:
+ *    run gcc_simpoint_3 -machine single_core -yamlstats gcc_3.yml -run
+ *        -stopinsns 100m
+ *
+ * The server forks, the child restores the checkpoint, applies the options
+ * and simulates until the run ends, as if it had been started with -loadvm
+ * and -simconfig. The server replies 'started <pid>' and, once the child
+ * exits, 'done <pid> <exit status>' (or 'error <message>'). Jobs run one at a
+ * time because every child restores and writes the same disk images.
+ *
+ * The server flushes its block devices before each fork and the child opens
+ * them again, so every job starts from the image metadata on disk rather
+ * than from what the server cached before earlier jobs changed the images.
+ */
+
+#include <globals.h>
+#include <ptlsim.h>
+#include <ptl-qemu.h>
+
+extern "C" {
+#include <sysemu.h>
+#include <block.h>
+}
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+int load_vmstate(const char *name);
+
+static void server_reply(int fd, const char *msg)
+{
+    if (write(fd, msg, strlen(msg)) < 0)
+        ptl_logfile << "Server: unable to reply to client", endl;
+}
+
+static int server_listen(const char *path)
+{
+    struct sockaddr_un addr;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("MARSSx86::Server socket");
+        exit(1);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            listen(fd, 4) < 0) {
+        perror("MARSSx86::Server bind");
+        exit(1);
+    }
+
+    return fd;
+}
+
+/*
+ * Read one '\n' terminated line from the client, returns false at the end
+ * of the connection.
+ */
+static bool server_read_line(int fd, stringbuf& line)
+{
+    char c;
+
+    line.reset();
+
+    for (;;) {
+        int n = read(fd, &c, 1);
+        if (n <= 0)
+            return (line.size() > 0);
+        if (c == '\n')
+            return true;
+        line << c;
+    }
+}
+
+/*
+ * Fork a child for the job and wait for it. Returns the child's pid in the
+ * child and 0 in the server.
+ */
+static int server_run_job(int client, int listen_fd, const char *checkpoint,
+        const char *options)
+{
+    stringbuf reply;
+
+    /* Make sure nothing buffered is written twice after fork */
+    qemu_aio_flush();
+    bdrv_flush_all();
+    ptl_logfile.flush();
+    cout.flush();
+    cerr.flush();
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        reply << "error fork failed: " << strerror(errno) << "\n";
+        server_reply(client, reply.buf);
+        return 0;
+    }
+
+    if (pid == 0) {
+        close(client);
+        close(listen_fd);
+
+        if (bdrv_reopen_all() < 0) {
+            fprintf(stderr, "MARSSx86::Server unable to reopen disk images\n");
+            _exit(2);
+        }
+
+        if (load_vmstate(checkpoint) < 0) {
+            fprintf(stderr, "MARSSx86::Server unable to load checkpoint %s\n",
+                    checkpoint);
+            _exit(2);
+        }
+
+        ptl_machine_configure(options);
+
+        /* The child has to go away once its run is finished */
+        config.kill_after_run = 1;
+
+        return getpid();
+    }
+
+    reply << "started " << pid << "\n";
+    server_reply(client, reply.buf);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+    reply.reset();
+    reply << "done " << pid << " " <<
+        (WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status)) <<
+        "\n";
+    server_reply(client, reply.buf);
+
+    ptl_logfile << "Server: job ", checkpoint, " (pid ", pid, ") finished",
+                endl, flush;
+    return 0;
+}
+
+/* Split off the next space separated word of a job line */
+static char* next_word(char*& p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    char *word = p;
+
+    while (*p && *p != ' ' && *p != '\t' && *p != '\r') p++;
+    if (*p) *p++ = '\0';
+
+    return word;
+}
+
+/*
+ * Serve jobs on config.server_socket. Only returns in the forked child of a
+ * job, with its checkpoint loaded and its options applied.
+ */
+void ptl_server_wait_for_job(void)
+{
+    int listen_fd = server_listen(config.server_socket.buf);
+
+    if (!config.quiet)
+        cout << "MARSSx86::Server waiting for jobs on ",
+             config.server_socket, endl;
+
+    for (;;) {
+        int client = accept(listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            perror("MARSSx86::Server accept");
+            exit(1);
+        }
+
+        stringbuf line;
+        while (server_read_line(client, line)) {
+            char *p = line.buf;
+            char *cmd = next_word(p);
+
+            if (!*cmd)
+                continue;
+
+            if (!strcmp(cmd, "quit")) {
+                server_reply(client, "bye\n");
+                close(client);
+                close(listen_fd);
+                unlink(config.server_socket.buf);
+                exit(0);
+            }
+
+            /* Everything after the checkpoint name is the simconfig string */
+            char *checkpoint = next_word(p);
+
+            if (strcmp(cmd, "run") || !*checkpoint) {
+                server_reply(client, "error expected "
+                        "'run <checkpoint> <options>' or 'quit'\n");
+                continue;
+            }
+
+            if (server_run_job(client, listen_fd, checkpoint, p))
+                return;
+        }
+
+        close(client);
+    }
+}
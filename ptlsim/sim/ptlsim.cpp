@@ -19,16 +19,19 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
+#include <sched.h>
 
 #include <bson/bson.h>
 #include <bson/mongo.h>
 #include <machine.h>
 #include <statelist.h>
+#include <arena.h>
 #include <decode.h>
 
 #include <fstream>
 #include <syscalls.h>
 #include <ptl-qemu.h>
+#include <rtm.h>
 
 #include <test.h>
 /*
@@ -126,11 +129,13 @@ struct SimStats : public Statable
   {
     StatObj<W64> cycles_per_sec;
     StatObj<W64> commits_per_sec;
+    StatObj<W64> heap_allocs;
 
     performance(Statable *parent)
       : Statable("performance", parent)
         , cycles_per_sec("cycles_per_sec", this)
         , commits_per_sec("commits_per_sec", this)
+        , heap_allocs("heap_allocs", this)
     { }
   } performance;
 
@@ -176,6 +181,7 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   stats_filename.reset();
   yaml_stats_filename="";
   stats_format = "yaml";
+  raw_stats_filename = "";
   snapshot_cycles = infinity;
   snapshot_now.reset();
   time_stats_logfile = "";
@@ -188,6 +194,7 @@ void ConfigurationParser<PTLsimConfig>::reset() {
 
   // memory model
   use_memory_model = 0;
+  mem_event_rings = 0;
   kill_after_run = 0;
   stop_at_insns = infinity;
   stop_at_cycle = infinity;
@@ -203,6 +210,15 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   event_trace_replay_filename.reset();
 
   core_freq_hz = 0;
+  fast_strings = 0;
+  fast_string_startup = 35;
+  callgraph_filename.reset();
+  callgraph_depth = 64;
+  callgraph_sample = 1000;
+  rtm = 0;
+  rtm_write_sets = 64;
+  rtm_write_ways = 8;
+  rtm_read_lines = 4096;
   // default timer frequency is 100 hz in time-xen.c:
 
   perfect_cache = 0;
@@ -219,6 +235,7 @@ void ConfigurationParser<PTLsimConfig>::reset() {
 
   checker_enabled = 0;
   checker_start_rip = INVALIDRIP;
+  disable_fast_mmio = 0;
 
   // MongoDB configuration
   enable_mongo = 0;
@@ -236,6 +253,13 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   // Sync Options
   sync_interval = 0;
 
+  // Server mode
+  server_socket = "";
+
+  // Host placement
+  huge_pages = 0;
+  numa_node = infinity;
+
   // Simpoint options
   simpoint_file = "";
   simpoint_interval = 10e6;
@@ -272,7 +296,8 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Statistics Database");
   add(stats_filename,               "stats",                "Statistics data store hierarchy root");
   add(yaml_stats_filename,          "yamlstats",            "Statistics data stores in YAML format");
-  add(stats_format,					        "stats-format",         "Statistics output format, default is YAML");
+  add(stats_format,					        "stats-format",         "Statistics output format: yaml (default), json or text");
+  add(raw_stats_filename,           "rawstats",             "Also save the raw Stats blocks into this binary file");
   add(snapshot_cycles,              "snapshot-cycles",      "Take statistical snapshot and reset every <snapshot> cycles");
   add(snapshot_now,                 "snapshot-now",         "Take statistical snapshot immediately, using specified name");
   add(time_stats_logfile,           "time-stats-logfile",   "File to write time-series statistics (new)");
@@ -303,6 +328,7 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Validation");
   add(checker_enabled, 		          "enable-checker", 		  "Enable emulation based checker");
   add(checker_start_rip,            "checker-startrip",     "Start checker at specified RIP");
+  add(disable_fast_mmio,            "disable-fast-mmio",    "Send all device register reads through QEMU");
 
   section("Out of Order Core (ooocore)");
   add(perfect_cache,                "perfect-cache",        "Perfect cache performance: all loads and stores hit in L1");
@@ -316,6 +342,15 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Core Configuration");
   add(machine_config, "machine", "Name of machine configuration to simulate");
+  add(fast_strings,                 "fast-strings",         "Execute forward rep movs/stos as line sized memory requests");
+  add(fast_string_startup,          "fast-string-startup",  "Startup overhead of a fast-string instruction in cycles");
+  add(callgraph_filename,           "callgraph",            "Write committed cycles per guest call path to <callgraph> as folded stacks");
+  add(callgraph_depth,              "callgraph-depth",      "Deepest call path kept by -callgraph");
+  add(callgraph_sample,             "callgraph-sample",     "Attribute -callgraph cycles every <N> cycles");
+  add(rtm,                          "rtm",                  "Support XBEGIN/XEND/XABORT/XTEST and report RTM in CPUID");
+  add(rtm_write_sets,               "rtm-write-sets",       "L1-D sets tracking the transactional write set");
+  add(rtm_write_ways,               "rtm-write-ways",       "Written lines per set before a transaction aborts on capacity");
+  add(rtm_read_lines,               "rtm-read-lines",       "Read lines tracked per transaction before it aborts on capacity");
 
   ///
   /// following are for the new memory hierarchy implementation:
@@ -323,6 +358,7 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Memory Hierarchy Configuration");
   //  add(memory_log,               "memory-log",               "log memory debugging info");
+  add(mem_event_rings,              "mem-event-rings",      "Queue memory events issued by cores in per-core rings");
 
   // MongoDB
   section("bus configuration");
@@ -343,6 +379,13 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Synchronization Options");
   add(sync_interval, "sync", "Number of simulation cycles between synchronization");
 
+  section("Server Mode");
+  add(server_socket, "server", "Run jobs sent to this Unix socket in forked children (see ptl-server.cpp)");
+
+  section("Host Placement");
+  add(huge_pages, "huge-pages", "Back simulator arenas and stats with 2MB huge pages (explicit if reserved, else transparent)");
+  add(numa_node, "numa-node", "Bind the simulation thread and its memory to host NUMA node <n>");
+
   section("Simpoint Options");
   add(simpoint_file, "simpoint", "Create simpoint based checkpoints from given 'simpoint' file");
   add(simpoint_interval, "simpoint-interval", "Number of instructions in each interval");
@@ -460,18 +503,36 @@ void dump_yaml_stats()
     return;
   }
 
-  YAML::Emitter k_out, u_out, g_out;
+  /* Stream each document straight to the file instead of building it in a
+   * YAML::Emitter first, the output is the same */
+  int format = (config.stats_format == "json") ?
+    StatsWriter::FORMAT_JSON : StatsWriter::FORMAT_YAML;
+  StatsWriter out(yaml_stats_file, format);
 
-  (StatsBuilder::get()).dump(kernel_stats, k_out);
-  yaml_stats_file << k_out.c_str() << "\n";
+  (StatsBuilder::get()).dump(kernel_stats, out);
+  (StatsBuilder::get()).dump(user_stats, out);
+  (StatsBuilder::get()).dump(global_stats, out);
 
-  (StatsBuilder::get()).dump(user_stats, u_out);
-  yaml_stats_file << u_out.c_str() << "\n";
+  out.flush();
+  yaml_stats_file.flush();
+}
 
-  (StatsBuilder::get()).dump(global_stats, g_out);
-  yaml_stats_file << g_out.c_str() << "\n";
+/**
+ * @brief Save the raw Stats blocks for fast re-analysis
+ */
+void dump_raw_stats()
+{
+  if (!config.raw_stats_filename)
+    return;
 
-  yaml_stats_file.flush();
+  Stats* blocks[] = {kernel_stats, user_stats, global_stats};
+  const char* names[] = {"kernel", "user", "global"};
+
+  ofstream raw_file(config.raw_stats_filename.buf, std::ios::binary);
+  (StatsBuilder::get()).dump_raw(raw_file, blocks, names, 3);
+
+  if (!raw_file)
+    ptl_logfile << "Unable to write raw stats to ", config.raw_stats_filename, endl;
 }
 
 /**
@@ -505,12 +566,14 @@ static void flush_stats()
   if (config.stats_format == "text") {
     dump_text_stats();
   } else {
-    if (config.stats_format != "yaml")
+    if (config.stats_format != "yaml" && config.stats_format != "json")
       ptl_logfile << "Unknown Stats format: " << config.stats_format <<
         " dumping in default YAML format." << endl;
     dump_yaml_stats();
   }
 
+  dump_raw_stats();
+
   if(config.enable_mongo)
     write_mongo_stats();
 
@@ -520,6 +583,10 @@ static void flush_stats()
 
   ptl_logfile << "Stats Summary:\n";
   (StatsBuilder::get()).dump_summary(ptl_logfile);
+
+  print_kernel_entry_table(ptl_logfile);
+
+  write_callgraph_profile();
 }
 
 static void kill_simulation()
@@ -554,8 +621,70 @@ static void kill_simulation()
   ptl_quit();
 }
 
+/*
+ * Bind the simulation thread to the CPUs of a host NUMA node and make the
+ * node its preferred memory node, so the machine arena, stats blocks and
+ * guest RAM pages first touched by the simulation are all node local.
+ * set_mempolicy is called directly, so libnuma is not needed.
+ */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+static bool bind_to_numa_node(W64 node)
+{
+  char path[128];
+  char cpulist[4096];
+
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+      (int)node);
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  bool ok = (fgets(cpulist, sizeof(cpulist), f) != NULL);
+  fclose(f);
+  if (!ok) return false;
+
+  /* cpulist is a comma separated list of ranges: "0-7,16-23" */
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  char* p = cpulist;
+  while (*p && *p != '\n') {
+    int first = strtol(p, &p, 10);
+    int last = first;
+    if (*p == '-')
+      last = strtol(p + 1, &p, 10);
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, &cpus);
+    if (*p == ',') p++;
+    else break;
+  }
+
+  if (!CPU_COUNT(&cpus) || sched_setaffinity(0, sizeof(cpus), &cpus))
+    return false;
+
+  /* A failed memory policy only costs locality, the CPUs stay bound */
+  unsigned long nodemask[16];
+  memset(nodemask, 0, sizeof(nodemask));
+  int rc = -1;
+  errno = EINVAL;
+  if (node < sizeof(nodemask) * 8) {
+    nodemask[node / (sizeof(long) * 8)] = 1UL << (node % (sizeof(long) * 8));
+    rc = syscall(__NR_set_mempolicy, MPOL_PREFERRED, nodemask,
+        sizeof(nodemask) * 8);
+  }
+
+  if (rc) {
+    cerr << "Warning: unable to prefer memory from host NUMA node " <<
+      node << ": " << strerror(errno) << endl;
+  }
+
+  return true;
+}
+
 bool handle_config_change(PTLsimConfig& config) {
   static bool first_time = true;
+  static W64 current_numa_node = infinity;
 
   if (config.log_filename.set() && (config.log_filename != current_log_filename)) {
     // Can also use "-ptl_logfile /dev/fd/1" to send to stdout (or /dev/fd/2 for stderr):
@@ -671,6 +800,21 @@ bool handle_config_change(PTLsimConfig& config) {
     config.core_freq_hz = get_native_core_freq_hz();
   }
 
+  machine_arena.set_page_mode((config.huge_pages) ? ARENA_PAGES_HUGE :
+      ARENA_PAGES_NORMAL);
+
+  if (config.numa_node != infinity && config.numa_node != current_numa_node) {
+    if (bind_to_numa_node(config.numa_node)) {
+      current_numa_node = config.numa_node;
+      ptl_logfile << "Bound simulation to host NUMA node " <<
+        config.numa_node << endl;
+    } else {
+      cerr << "Warning: unable to bind to host NUMA node " <<
+        config.numa_node << ", running unbound" << endl;
+      config.numa_node = infinity;
+    }
+  }
+
   return true;
 }
 
@@ -1158,6 +1302,9 @@ stringbuf get_date()
   return date;
 }
 
+/* C++ heap allocations made while the machine was running */
+static W64 sim_loop_heap_allocs = 0;
+
 static void set_run_stats()
 {
   static W64 seconds = 0;
@@ -1171,7 +1318,8 @@ static void set_run_stats()
   simstats.set_default_stats(stat); \
   simstats.run.seconds = seconds; \
   simstats.performance.cycles_per_sec = cycles_per_sec; \
-  simstats.performance.commits_per_sec = commits_per_sec;
+  simstats.performance.commits_per_sec = commits_per_sec; \
+  simstats.performance.heap_allocs = sim_loop_heap_allocs;
 
   RUN_STAT(user_stats);
   RUN_STAT(kernel_stats);
@@ -1362,7 +1510,9 @@ extern "C" uint8_t ptl_simulate() {
     ptl_logfile << endl;
   }
 
+  W64 heap_allocs_at_start = heap_alloc_count;
   machine->run(config);
+  sim_loop_heap_allocs += heap_alloc_count - heap_allocs_at_start;
 
   if (config.stop_at_insns <= total_insns_committed || config.kill == true
       || config.stop == true || config.stop_at_cycle < sim_cycle) {
@@ -1371,6 +1521,10 @@ extern "C" uint8_t ptl_simulate() {
 
   ptl_stable_state = 1;
 
+  /* Emulation can't continue a transaction, abort them in PTLsim format */
+  if (machine->stopped)
+    rtm_stop_simulation();
+
   if(machine->ret_qemu_env)
     setup_qemu_switch_all_ctx(*machine->ret_qemu_env);
 
@@ -1396,6 +1550,9 @@ extern "C" uint8_t ptl_simulate() {
   sb << endl << "Stopped after " << sim_cycle << " cycles, " << total_insns_committed << " instructions and " <<
     seconds << " seconds of sim time (cycle/sec: " << W64(double(sim_cycle) / double(seconds)) << " Hz, insns/sec: " << 
     W64(double(total_insns_committed) / double(seconds)) << ", insns/cyc: " <<  double(total_insns_committed) / double(sim_cycle) << ")" << endl;
+  sb << "Heap allocations in simulation loop: " << sim_loop_heap_allocs <<
+    ", machine arena: " << machine_arena.bytes_allocated() << " bytes in " <<
+    machine_arena.chunks_allocated() << " chunks" << endl;
 
   ptl_logfile << sb << flush;
   cerr << sb << flush;
@@ -134,6 +134,8 @@ struct TransOpBuffer {
 void split_unaligned(const TransOp& transop, TransOpBuffer& buf);
 
 void capture_stats_snapshot(const char* name = NULL);
+void print_kernel_entry_table(ostream& os);
+void write_callgraph_profile();
 bool handle_config_change(PTLsimConfig& config);
 void collect_sysinfo(PTLsimStats& stats, int argc, char** argv);
 void print_sysinfo(ostream& os);
@@ -225,9 +227,11 @@ struct PTLsimConfig {
   stringbuf time_stats_logfile;
   W64 time_stats_period;
   stringbuf stats_format;
+  stringbuf raw_stats_filename;
 
   // memory model:
   bool use_memory_model;
+  bool mem_event_rings;
 
   // Stopping Point
   W64 stop_at_insns;
@@ -248,6 +252,15 @@ struct PTLsimConfig {
 
   // Core features
   W64 core_freq_hz;
+  bool fast_strings;
+  W64 fast_string_startup;
+  stringbuf callgraph_filename;
+  W64 callgraph_depth;
+  W64 callgraph_sample;
+  bool rtm;
+  W64 rtm_write_sets;
+  W64 rtm_write_ways;
+  W64 rtm_read_lines;
 
   // Out of order core features
   bool perfect_cache;
@@ -267,6 +280,7 @@ struct PTLsimConfig {
 
   bool checker_enabled;
   W64 checker_start_rip;
+  bool disable_fast_mmio;
 
   // MongoDB support configuration
   bool enable_mongo;
@@ -284,6 +298,13 @@ struct PTLsimConfig {
   // Sync Options
   W64  sync_interval;
 
+  // Server mode
+  stringbuf server_socket;
+
+  // Host placement
+  bool huge_pages;
+  W64 numa_node;
+
   // Simpoint options
   stringbuf simpoint_file;
   W64 simpoint_interval;
@@ -0,0 +1,568 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Restricted transactional memory (-rtm).
+ *
+ * XBEGIN, XEND and XABORT are assists, so a transaction starts and ends at
+ * commit with an empty pipeline. The outermost XBEGIN saves the general
+ * purpose and SSE registers and the flags. Simulated data lives in guest
+ * memory and is read at load execution and written at store commit through
+ * Context::loadvirt() and Context::storemask_virt(), which is where the
+ * transactions are tracked:
+ *
+ * - A transactional load or store adds its lines to the read or write set,
+ *   keyed by host address. Loads add them when they execute, so a store of
+ *   another CPU before the load commits still aborts the transaction. The write set is limited to -rtm-write-ways lines
+ *   in each of -rtm-write-sets L1-D sets, the read set to -rtm-read-lines
+ *   lines; going past either is a capacity abort.
+ * - A transactional store saves the old memory contents in an undo log
+ *   before it writes.
+ * - Any load of a line in another transaction's write set, or store to a
+ *   line in its read or write set, aborts that transaction before the access
+ *   is done (requester wins), as the coherence invalidation or downgrade of
+ *   its L1 line would.
+ *
+ * An abort writes the undo log back at once, so no other CPU sees the
+ * transactional stores, and dooms the transaction: its later stores are
+ * dropped until the core restores the checkpoint and restarts at the
+ * fallback rip. Assists that can't run transactionally, exceptions and
+ * interrupts abort too; QEMU's do_interrupt() restores the checkpoint for
+ * those, and suppresses exceptions raised inside the transaction.
+ *
+ * Begins, commits, aborts by reason and cycles spent in committed and
+ * aborted transactions are in the 'rtm' stats.
+ */
+
+#include <globals.h>
+#include <ptlhwdef.h>
+#include <ptl-qemu.h>
+#include <ptlsim.h>
+#include <decode.h>
+#include <rtm.h>
+
+#define RTM_LINE_BITS 6
+#define RTM_MAX_NESTING 7
+
+enum {
+    RTM_ABORT_EXPLICIT,
+    RTM_ABORT_CONFLICT,
+    RTM_ABORT_READ_CAPACITY,
+    RTM_ABORT_WRITE_CAPACITY,
+    RTM_ABORT_NESTING,
+    RTM_ABORT_INSTRUCTION,
+    RTM_ABORT_EXCEPTION,
+    RTM_ABORT_INTERRUPT,
+    RTM_ABORT_MEMORY_TYPE,
+    RTM_ABORT_SIM_STOP,
+    RTM_ABORT_REASONS,
+};
+
+static const char* rtm_abort_names[RTM_ABORT_REASONS] = {
+    "explicit", "conflict", "read_capacity", "write_capacity", "nesting",
+    "instruction", "exception", "interrupt", "memory_type", "sim_stop",
+};
+
+struct RTMStats : public Statable
+{
+    StatObj<W64> begins;
+    StatObj<W64> nested_begins;
+    StatObj<W64> commits;
+    StatArray<W64, RTM_ABORT_REASONS> aborts;
+    StatObj<W64> committed_cycles;
+    StatObj<W64> aborted_cycles;
+    StatObj<W64> committed_read_lines;
+    StatObj<W64> committed_write_lines;
+
+    RTMStats()
+        : Statable("rtm")
+          , begins("begins", this)
+          , nested_begins("nested_begins", this)
+          , commits("commits", this)
+          , aborts("aborts", this, rtm_abort_names)
+          , committed_cycles("committed_cycles", this)
+          , aborted_cycles("aborted_cycles", this)
+          , committed_read_lines("committed_read_lines", this)
+          , committed_write_lines("committed_write_lines", this)
+    { }
+} rtm_stats;
+
+/* Set of line addresses, open addressing with linear probing */
+struct RTMLineSet {
+    dynarray<W64> slots;    /* line + 1, 0 is a free slot */
+    dynarray<int> used;     /* occupied slots, to clear them quickly */
+
+    void init(int limit) {
+        int size = 16;
+        while (size < 2 * limit) size <<= 1;
+        slots.resize(size, 0);
+    }
+
+    int count() const { return used.size(); }
+
+    int slotof(W64 line) const {
+        return (int)((line * 0x9e3779b97f4a7c15ULL) >> 40) &
+            (slots.size() - 1);
+    }
+
+    bool contains(W64 line) const {
+        for (int slot = slotof(line);; slot = (slot + 1) & (slots.size() - 1)) {
+            if (slots[slot] == line + 1) return true;
+            if (!slots[slot]) return false;
+        }
+    }
+
+    void add(W64 line) {
+        int slot = slotof(line);
+        while (slots[slot]) slot = (slot + 1) & (slots.size() - 1);
+        slots[slot] = line + 1;
+        used.push(slot);
+    }
+
+    void clear() {
+        foreach (i, used.size()) {
+            slots[used[i]] = 0;
+        }
+        used.clear();
+    }
+};
+
+struct RTMUndoEntry {
+    byte* host;
+    W64 data;
+    int bytes;
+};
+
+struct RTMTransaction {
+    RTMLineSet read_set;
+    RTMLineSet write_set;
+    dynarray<W16> write_ways;   /* write set lines in each L1-D set */
+    dynarray<RTMUndoEntry> undo_log;
+
+    /* Registers at the outermost XBEGIN */
+    W64 regs[CPU_NB_REGS];
+    XMMReg xmm_regs[CPU_NB_REGS];
+    W64 reg_flags;
+    W32 internal_eflags;
+    W64 fallback_rip;
+
+    W32 status;                 /* EAX after the abort */
+    W64 start_cycle;
+};
+
+int rtm_active_transactions = 0;
+
+static RTMTransaction rtm_transactions[MAX_CONTEXTS];
+
+static inline Stats* rtm_stats_block(Context& ctx) {
+    return (ctx.kernel_mode) ? kernel_stats : user_stats;
+}
+
+static void rtm_clear(RTMTransaction& tx)
+{
+    foreach (i, tx.write_set.count()) {
+        W64 line = tx.write_set.slots[tx.write_set.used[i]] - 1;
+        tx.write_ways[line % config.rtm_write_sets] = 0;
+    }
+
+    tx.read_set.clear();
+    tx.write_set.clear();
+    tx.undo_log.clear();
+}
+
+static void rtm_abort(Context& ctx, int reason, W32 status)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+
+    /* Put back what the transaction overwrote, newest store first */
+    for (int i = tx.undo_log.size() - 1; i >= 0; i--) {
+        const RTMUndoEntry& undo = tx.undo_log[i];
+        memcpy(undo.host, &undo.data, undo.bytes);
+        smc_setdirty_host(undo.host);
+    }
+
+    if (ctx.rtm_depth > 1)
+        status |= RTM_STATUS_NESTED;
+
+    tx.status = status;
+
+    Stats* stats = rtm_stats_block(ctx);
+    rtm_stats.aborts(stats)[reason]++;
+    rtm_stats.aborted_cycles(stats) += sim_cycle - tx.start_cycle;
+
+    if (logable(5)) {
+        ptl_logfile << "[vcpu ", ctx.cpu_index, "] RTM abort (",
+                    rtm_abort_names[reason], ") status ",
+                    hexstring(status, 32), " after ",
+                    sim_cycle - tx.start_cycle, " cycles", endl;
+    }
+
+    rtm_clear(tx);
+    ctx.rtm_doomed = 1;
+    rtm_active_transactions--;
+}
+
+static void rtm_restore_registers(Context& ctx, RTMTransaction& tx)
+{
+    memcpy(ctx.regs, tx.regs, sizeof(tx.regs));
+    memcpy(ctx.xmm_regs, tx.xmm_regs, sizeof(tx.xmm_regs));
+    ctx.regs[R_EAX] = tx.status;
+    ctx.rtm_depth = 0;
+    ctx.rtm_doomed = 0;
+}
+
+void rtm_rollback(Context& ctx)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+
+    assert(ctx.rtm_doomed);
+
+    rtm_restore_registers(ctx, tx);
+    ctx.reg_flags = tx.reg_flags;
+    ctx.internal_eflags = tx.internal_eflags;
+    ctx.eip = tx.fallback_rip;
+}
+
+void rtm_begin(Context& ctx, W64 fallback_rip)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+    Stats* stats = rtm_stats_block(ctx);
+
+    if (ctx.rtm_depth) {
+        rtm_stats.nested_begins(stats)++;
+
+        if unlikely (ctx.rtm_depth == RTM_MAX_NESTING) {
+            rtm_abort(ctx, RTM_ABORT_NESTING, 0);
+            rtm_rollback(ctx);
+            return;
+        }
+
+        ctx.rtm_depth++;
+        return;
+    }
+
+    if unlikely (!tx.read_set.slots.size()) {
+        tx.read_set.init(config.rtm_read_lines);
+        tx.write_set.init(config.rtm_write_sets * config.rtm_write_ways);
+        tx.write_ways.resize(config.rtm_write_sets, 0);
+    }
+
+    memcpy(tx.regs, ctx.regs, sizeof(tx.regs));
+    memcpy(tx.xmm_regs, ctx.xmm_regs, sizeof(tx.xmm_regs));
+    tx.reg_flags = ctx.reg_flags;
+    tx.internal_eflags = ctx.internal_eflags;
+    tx.fallback_rip = fallback_rip;
+    tx.start_cycle = sim_cycle;
+
+    ctx.rtm_depth = 1;
+    rtm_active_transactions++;
+    rtm_stats.begins(stats)++;
+}
+
+bool rtm_commit(Context& ctx)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+
+    if (!ctx.rtm_depth)
+        return false;
+
+    if (--ctx.rtm_depth)
+        return true;
+
+    Stats* stats = rtm_stats_block(ctx);
+    rtm_stats.commits(stats)++;
+    rtm_stats.committed_cycles(stats) += sim_cycle - tx.start_cycle;
+    rtm_stats.committed_read_lines(stats) += tx.read_set.count();
+    rtm_stats.committed_write_lines(stats) += tx.write_set.count();
+
+    rtm_clear(tx);
+    rtm_active_transactions--;
+    return true;
+}
+
+/* XABORT outside of a transaction is a nop */
+void rtm_explicit_abort(Context& ctx, W8 code)
+{
+    if (!ctx.rtm_depth)
+        return;
+
+    if (!ctx.rtm_doomed) {
+        rtm_abort(ctx, RTM_ABORT_EXPLICIT,
+                RTM_STATUS_EXPLICIT | ((W32)code << 24));
+    }
+
+    rtm_rollback(ctx);
+}
+
+/* Assists that only change registers or access memory through Context */
+static bool rtm_assist_in_transaction(int assistid)
+{
+    switch (assistid) {
+        case ASSIST_DIV8 ... ASSIST_IDIV64:
+        case ASSIST_X87_FPREM ... ASSIST_X87_FPREM1:
+        case ASSIST_X87_FINIT ... ASSIST_X87_FXCH:
+        case ASSIST_X87_FLDCW:
+        case ASSIST_MMX_EMMS:
+        case ASSIST_LDMXCSR:
+        case ASSIST_ENTER:
+        case ASSIST_REP_STRING:
+        case ASSIST_RDTSC:
+        case ASSIST_CLD:
+        case ASSIST_STD:
+        case ASSIST_PUSHF:
+        case ASSIST_POPF:
+        case ASSIST_BCD_AAS:
+        case ASSIST_BARRIER:
+        case ASSIST_PAUSE:
+        case ASSIST_XBEGIN:
+        case ASSIST_XEND:
+        case ASSIST_XABORT:
+            return true;
+    }
+
+    return false;
+}
+
+bool rtm_check_assist(Context& ctx, int assistid)
+{
+    if likely (!ctx.rtm_depth)
+        return false;
+
+    if (!ctx.rtm_doomed) {
+        if (rtm_assist_in_transaction(assistid))
+            return false;
+
+        rtm_abort(ctx, RTM_ABORT_INSTRUCTION, 0);
+    }
+
+    rtm_rollback(ctx);
+    return true;
+}
+
+/* Abort all transactions before the CPUs go back to emulation */
+void rtm_stop_simulation()
+{
+    foreach (i, contextcount) {
+        Context& ctx = contextof(i);
+
+        if likely (!ctx.rtm_depth)
+            continue;
+
+        if (!ctx.rtm_doomed)
+            rtm_abort(ctx, RTM_ABORT_SIM_STOP, 0);
+
+        rtm_rollback(ctx);
+    }
+}
+
+uint8_t ptl_rtm_enabled(void)
+{
+    return config.rtm;
+}
+
+/*
+ * Called from QEMU's do_interrupt(), so the registers are restored in QEMU
+ * format.
+ */
+int ptl_rtm_interrupt(CPUX86State* env, int is_hw)
+{
+    Context& ctx = contextof(env->cpu_index);
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+
+    if likely (!ctx.rtm_depth)
+        return 0;
+
+    if (!ctx.rtm_doomed) {
+        rtm_abort(ctx, (is_hw) ? RTM_ABORT_INTERRUPT : RTM_ABORT_EXCEPTION,
+                0);
+    }
+
+    /* Same conversion as Context::setup_qemu_switch() */
+    rtm_restore_registers(ctx, tx);
+    ctx.cc_src = tx.reg_flags & FLAG_NOT_WAIT_INV;
+    ctx.cc_op = CC_OP_EFLAGS;
+    ctx.df = (tx.internal_eflags & FLAG_DF) ? -1 : 1;
+    ctx.eip = tx.fallback_rip - ctx.segs[R_CS].base;
+
+    return !is_hw;
+}
+
+/* Host address of guest RAM, NULL for MMIO and pages QEMU must see writes to */
+static byte* rtm_host_ptr(Context& ctx, Waddr virtaddr, int bytes, bool store)
+{
+    int mmu_idx = (ctx.kernel_mode) ? 0 : MMU_USER_IDX;
+    byte* host = ctx.get_host_ram_ptr(virtaddr, bytes, mmu_idx, store);
+
+    if (!host && ctx.try_handle_fault(virtaddr, store))
+        host = ctx.get_host_ram_ptr(virtaddr, bytes, mmu_idx, store);
+
+    return host;
+}
+
+/*
+ * Abort the transactions of other CPUs that conflict with the access, true
+ * if one of them had written the line
+ */
+static bool rtm_check_conflicts(Context& ctx, W64 line, bool store)
+{
+    bool written = false;
+
+    foreach (i, contextcount) {
+        Context& other = contextof(i);
+
+        if likely (&other == &ctx || !other.rtm_depth || other.rtm_doomed)
+            continue;
+
+        RTMTransaction& tx = rtm_transactions[other.cpu_index];
+
+        if (tx.write_set.contains(line) ||
+                (store && tx.read_set.contains(line))) {
+            written |= tx.write_set.contains(line);
+            rtm_abort(other, RTM_ABORT_CONFLICT,
+                    RTM_STATUS_CONFLICT | RTM_STATUS_RETRY);
+        }
+    }
+
+    return written;
+}
+
+/* Add a line to the read or write set, false on a capacity abort */
+static bool rtm_track(Context& ctx, RTMTransaction& tx, W64 line, bool store)
+{
+    if (store) {
+        if (tx.write_set.contains(line))
+            return true;
+
+        W16& ways = tx.write_ways[line % config.rtm_write_sets];
+        if unlikely (ways == config.rtm_write_ways) {
+            rtm_abort(ctx, RTM_ABORT_WRITE_CAPACITY, RTM_STATUS_CAPACITY);
+            return false;
+        }
+
+        ways++;
+        tx.write_set.add(line);
+        return true;
+    }
+
+    if (tx.read_set.contains(line))
+        return true;
+
+    if unlikely (tx.read_set.count() == config.rtm_read_lines) {
+        rtm_abort(ctx, RTM_ABORT_READ_CAPACITY, RTM_STATUS_CAPACITY);
+        return false;
+    }
+
+    tx.read_set.add(line);
+    return true;
+}
+
+/*
+ * Access within one page, false if it aborted the CPU's own transaction.
+ * 'written' is set if the access aborted a transaction that wrote the data.
+ */
+static bool rtm_access(Context& ctx, Waddr virtaddr, int bytes, bool store,
+        bool& written)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+    bool transactional = (ctx.rtm_depth != 0);
+
+    /* Other CPUs only need the line address, code pages are fine for them */
+    byte* host = rtm_host_ptr(ctx, virtaddr, bytes, store && transactional);
+
+    if unlikely (!host) {
+        if (transactional)
+            rtm_abort(ctx, RTM_ABORT_MEMORY_TYPE, 0);
+        return !transactional;
+    }
+
+    W64 first = (Waddr)host >> RTM_LINE_BITS;
+    W64 last = ((Waddr)host + bytes - 1) >> RTM_LINE_BITS;
+
+    for (W64 line = first; line <= last; line++) {
+        written |= rtm_check_conflicts(ctx, line, store);
+
+        if (transactional && !rtm_track(ctx, tx, line, store))
+            return false;
+    }
+
+    if (transactional && store) {
+        RTMUndoEntry& undo = tx.undo_log.push();
+        undo.host = host;
+        undo.bytes = bytes;
+        memcpy(&undo.data, host, bytes);
+    }
+
+    return true;
+}
+
+static bool rtm_access_split(Context& ctx, Waddr virtaddr, int bytes,
+        bool store, bool& written)
+{
+    while (bytes > 0) {
+        int chunk = min(bytes,
+                (int)(TARGET_PAGE_SIZE - lowbits(virtaddr, TARGET_PAGE_BITS)));
+
+        if (!rtm_access(ctx, virtaddr, chunk, store, written))
+            return false;
+
+        virtaddr += chunk;
+        bytes -= chunk;
+    }
+
+    return true;
+}
+
+/*
+ * Called from Context::loadvirt(), the load's own conflict check stays at
+ * commit. Lines of wrong path loads stay in the set, like the L1 read bits
+ * would. A full set is left to the capacity abort at commit.
+ */
+void rtm_execute_load(Context& ctx, Waddr virtaddr, int bytes)
+{
+    RTMTransaction& tx = rtm_transactions[ctx.cpu_index];
+    int mmu_idx = (ctx.kernel_mode) ? 0 : MMU_USER_IDX;
+
+    while (bytes > 0) {
+        int chunk = min(bytes,
+                (int)(TARGET_PAGE_SIZE - lowbits(virtaddr, TARGET_PAGE_BITS)));
+        byte* host = ctx.get_host_ram_ptr(virtaddr, chunk, mmu_idx, false);
+
+        if (host) {
+            W64 last = ((Waddr)host + chunk - 1) >> RTM_LINE_BITS;
+
+            for (W64 line = (Waddr)host >> RTM_LINE_BITS; line <= last;
+                    line++) {
+                if (!tx.read_set.contains(line) &&
+                        tx.read_set.count() < config.rtm_read_lines)
+                    tx.read_set.add(line);
+            }
+        }
+
+        virtaddr += chunk;
+        bytes -= chunk;
+    }
+}
+
+bool rtm_load(Context& ctx, Waddr virtaddr, int bytes)
+{
+    bool written = false;
+
+    if (ctx.rtm_doomed)
+        return true;
+
+    rtm_access_split(ctx, virtaddr, bytes, false, written);
+
+    return !written;
+}
+
+bool rtm_store(Context& ctx, Waddr virtaddr, int bytes)
+{
+    bool written = false;
+
+    if (ctx.rtm_doomed)
+        return false;
+
+    return rtm_access_split(ctx, virtaddr, bytes, true, written);
+}
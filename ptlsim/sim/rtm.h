@@ -0,0 +1,51 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Restricted transactional memory (-rtm): XBEGIN, XEND, XABORT and XTEST.
+ */
+
+#ifndef RTM_H
+#define RTM_H
+
+#include <ptlhwdef.h>
+
+/* CPUID.(EAX=7,ECX=0):EBX feature bit */
+#define RTM_CPUID_7_0_EBX (1 << 11)
+
+/* Abort status in EAX */
+#define RTM_STATUS_EXPLICIT (1 << 0)
+#define RTM_STATUS_RETRY    (1 << 1)
+#define RTM_STATUS_CONFLICT (1 << 2)
+#define RTM_STATUS_CAPACITY (1 << 3)
+#define RTM_STATUS_NESTED   (1 << 5)
+
+/* Contexts with a transaction that has not aborted yet */
+extern int rtm_active_transactions;
+
+void rtm_begin(Context& ctx, W64 fallback_rip);
+bool rtm_commit(Context& ctx);
+void rtm_explicit_abort(Context& ctx, W8 code);
+
+/* Abort the transaction if 'assistid' can't run in it, true if aborted */
+bool rtm_check_assist(Context& ctx, int assistid);
+
+/* Restore the registers of an aborted transaction and go to its fallback */
+void rtm_rollback(Context& ctx);
+
+void rtm_stop_simulation();
+
+/*
+ * Memory accesses. rtm_execute_load() adds the lines of a load that reads
+ * memory to the transaction's read set. Cores call rtm_load() when a load
+ * commits, false means it aborted a transaction that wrote the data, so the
+ * load has to run again. rtm_store() is called from the functional store,
+ * false drops the store.
+ */
+void rtm_execute_load(Context& ctx, Waddr virtaddr, int bytes);
+bool rtm_load(Context& ctx, Waddr virtaddr, int bytes);
+bool rtm_store(Context& ctx, Waddr virtaddr, int bytes);
+
+#endif // RTM_H
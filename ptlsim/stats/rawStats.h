@@ -0,0 +1,47 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Layout of the raw Stats file written by StatsBuilder::dump_raw() and read
+ * by tools/mstats-raw.cpp. This header is shared with the tool, so it only
+ * depends on standard C headers.
+ */
+
+#ifndef RAW_STATS_H
+#define RAW_STATS_H
+
+#include <stdint.h>
+
+/*
+ * File layout:
+ *
+ *   RawStatsHeader
+ *   schema         - text, one line per counter:
+ *                    "<name> <type> <offset> <count>\n"
+ *                    name is the dotted path used by the text stats format
+ *                    (e.g. "ooo_0_0.thread0.commit.insns"), type is one of
+ *                    "w64", "double", "string" or "bytes", offset is the byte
+ *                    offset in each block and count the number of elements.
+ *   padding
+ *   block 0        - 'block_size' bytes, page aligned
+ *   ...
+ */
+#define RAW_STATS_MAGIC      "MARSSRAW"
+#define RAW_STATS_VERSION    1
+#define RAW_STATS_MAX_BLOCKS 8
+#define RAW_STATS_ALIGN      4096
+
+struct RawStatsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_count;
+    uint64_t block_size;
+    uint64_t schema_offset;
+    uint64_t schema_size;
+    uint64_t block_offset[RAW_STATS_MAX_BLOCKS];
+    char block_name[RAW_STATS_MAX_BLOCKS][16];
+};
+
+#endif // RAW_STATS_H
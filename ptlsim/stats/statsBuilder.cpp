@@ -209,6 +209,62 @@ YAML::Emitter& Statable::dump(YAML::Emitter &out, Stats *stats)
     return out;
 }
 
+StatsWriter& Statable::dump(StatsWriter &out, Stats *stats)
+{
+    if(dump_disabled) return out;
+
+    out.begin_map(name.size() ? name.buf : NULL);
+
+    // First print all the leafs
+    foreach(i, leafs.count()) {
+        leafs[i]->dump(out, stats);
+    }
+
+    // Now print all the child nodes
+    foreach(i, childNodes.count()) {
+        childNodes[i]->dump(out, stats);
+    }
+
+    out.end_map();
+
+    return out;
+}
+
+void add_schema_entry(stringbuf& schema, const stringbuf& name, int kind,
+        W64 offset, int count)
+{
+    static const char* kind_names[] = {"string", "w64", "double", "bytes"};
+
+    // Names are whitespace separated in the schema
+    for (const char* p = name.buf; *p; p++) {
+        schema << ((*p == ' ' || *p == '\t') ? '_' : *p);
+    }
+
+    schema << " " << kind_names[kind] << " " << offset << " " << count << "\n";
+}
+
+void Statable::dump_schema(stringbuf& schema) const
+{
+    foreach(i, leafs.count()) {
+        leafs[i]->dump_schema(schema);
+    }
+
+    foreach(i, childNodes.count()) {
+        childNodes[i]->dump_schema(schema);
+    }
+}
+
+void Statable::compute_equations(Stats *stats) const
+{
+    foreach(i, leafs.count()) {
+        leafs[i]->compute(stats);
+    }
+
+    foreach(i, childNodes.count()) {
+        childNodes[i]->compute_equations(stats);
+    }
+}
+
 bson_buffer* Statable::dump(bson_buffer *bb, Stats *stats)
 {
     if(dump_disabled) return bb;
@@ -341,6 +397,89 @@ StatObjBase* Statable::get_stat_obj(dynarray<stringbuf*> &names, int idx)
 
 StatsBuilder *StatsBuilder::_builder = NULL;
 
+W64 StatsBuilder::get_offset(int size, int kind)
+{
+    W64 ret_val = stat_offset;
+    stat_offset += size;
+    assert(stat_offset < STATS_SIZE);
+
+    /* Keep the high water mark, blocks may hold values of deleted nodes */
+    used_size = max(used_size, ceil(stat_offset, 64));
+
+    switch (kind) {
+        case STAT_KIND_W64:
+            add_run(w64_runs, ret_val, stat_offset);
+            break;
+        case STAT_KIND_DOUBLE:
+            add_run(double_runs, ret_val, stat_offset);
+            break;
+        case STAT_KIND_OTHER:
+            has_other_kinds = true;
+            break;
+    }
+
+    return ret_val;
+}
+
+void StatsBuilder::add_run(dynarray<StatRun>& runs, W64 start, W64 end)
+{
+    if (runs.count() && runs[runs.count() - 1].end == start) {
+        runs[runs.count() - 1].end = end;
+        return;
+    }
+
+    StatRun run;
+    run.start = start;
+    run.end = end;
+    runs.push(run);
+}
+
+/*
+ * Add (op = 1) or subtract (op = -1) every counter of a run. The loops are
+ * plain array loops over the Stats memory so the compiler vectorizes them.
+ */
+template<typename T, int op>
+void StatsBuilder::apply_runs(const dynarray<StatRun>& runs,
+        Stats& dest_stats, Stats& src_stats) const
+{
+    foreach (r, runs.count()) {
+        const StatRun& run = runs[r];
+        T* dest = (T*)(dest_stats.base() + run.start);
+        const T* src = (const T*)(src_stats.base() + run.start);
+        int count = (run.end - run.start) / sizeof(T);
+
+        if (op > 0) {
+            for (int i = 0; i < count; i++)
+                dest[i] += src[i];
+        } else {
+            for (int i = 0; i < count; i++)
+                dest[i] -= src[i];
+        }
+    }
+}
+
+void StatsBuilder::add_stats(Stats& dest_stats, Stats& src_stats) const
+{
+    if (has_other_kinds) {
+        rootNode->add_stats(dest_stats, src_stats);
+        return;
+    }
+
+    apply_runs<W64, 1>(w64_runs, dest_stats, src_stats);
+    apply_runs<double, 1>(double_runs, dest_stats, src_stats);
+}
+
+void StatsBuilder::sub_stats(Stats& dest_stats, Stats& src_stats) const
+{
+    if (has_other_kinds) {
+        rootNode->sub_stats(dest_stats, src_stats);
+        return;
+    }
+
+    apply_runs<W64, -1>(w64_runs, dest_stats, src_stats);
+    apply_runs<double, -1>(double_runs, dest_stats, src_stats);
+}
+
 Stats* StatsBuilder::get_new_stats()
 {
     Stats *stats = new Stats();
@@ -350,7 +489,7 @@ Stats* StatsBuilder::get_new_stats()
 
 void StatsBuilder::destroy_stats(Stats *stats)
 {
-    delete stats->mem;
+    free_host_pages(stats->mem, STATS_SIZE);
     delete stats;
 }
 
@@ -443,11 +582,65 @@ YAML::Emitter& StatsBuilder::dump(Stats *stats, YAML::Emitter &out) const
     return out;
 }
 
+StatsWriter& StatsBuilder::dump(Stats *stats, StatsWriter &out) const
+{
+    rootNode->set_default_stats(stats, true, true);
+
+    out.begin_document();
+    rootNode->dump(out, stats);
+    out.end_document();
+
+    return out;
+}
+
 bson_buffer* StatsBuilder::dump(Stats *stats, bson_buffer *bb) const
 {
     return rootNode->dump(bb, stats);
 }
 
+ostream& StatsBuilder::dump_raw(ostream &os, Stats **stats,
+        const char **names, int count) const
+{
+    RawStatsHeader header;
+    static const char zero_page[RAW_STATS_ALIGN] = {0};
+
+    assert(count <= RAW_STATS_MAX_BLOCKS);
+
+    stringbuf schema;
+    rootNode->dump_schema(schema);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAW_STATS_MAGIC, sizeof(header.magic));
+    header.version = RAW_STATS_VERSION;
+    header.block_count = count;
+    header.block_size = used_size;
+    header.schema_offset = sizeof(header);
+    header.schema_size = schema.size();
+
+    W64 data_start = ceil(sizeof(header) + schema.size(), RAW_STATS_ALIGN);
+    W64 offset = data_start;
+    foreach(i, count) {
+        header.block_offset[i] = offset;
+        strncpy(header.block_name[i], names[i],
+                sizeof(header.block_name[i]) - 1);
+        offset += ceil(used_size, RAW_STATS_ALIGN);
+    }
+
+    os.write((char*)&header, sizeof(header));
+    os.write(schema.buf, schema.size());
+    os.write(zero_page, data_start - sizeof(header) - schema.size());
+
+    /* Equations are only computed when they are dumped, the raw file
+     * may be the only dump of this run */
+    foreach(i, count) {
+        rootNode->compute_equations(stats[i]);
+        os.write((char*)stats[i]->base(), used_size);
+        os.write(zero_page, ceil(used_size, RAW_STATS_ALIGN) - used_size);
+    }
+
+    return os;
+}
+
 /**
  * @brief Get Statistic Object from name
  *
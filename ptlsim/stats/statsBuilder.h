@@ -13,6 +13,9 @@
 
 #include <globals.h>
 #include <superstl.h>
+#include <arena.h>
+#include <statsWriter.h>
+#include <rawStats.h>
 
 #include <yaml/yaml.h>
 #include <bson/bson.h>
@@ -26,6 +29,36 @@
 class StatObjBase;
 class Stats;
 
+/**
+ * @brief Kind of value stored at a Stats offset
+ *
+ * Counters of the same kind that are allocated back to back form one run in
+ * the Stats block, so whole blocks can be added or subtracted with a flat
+ * loop instead of walking the Statable tree.
+ */
+enum {
+    STAT_KIND_NONE,     // never added (strings)
+    STAT_KIND_W64,
+    STAT_KIND_DOUBLE,
+    STAT_KIND_OTHER,    // needs the per-object add/sub
+};
+
+template<typename T> struct StatKind { enum { value = STAT_KIND_OTHER }; };
+template<> struct StatKind<W64> { enum { value = STAT_KIND_W64 }; };
+template<> struct StatKind<double> { enum { value = STAT_KIND_DOUBLE }; };
+
+/**
+ * @brief Add one line to the raw stats schema (see rawStats.h)
+ *
+ * @param schema Schema text to append to
+ * @param name Full name of the counter
+ * @param kind STAT_KIND_* of the values
+ * @param offset Offset in the Stats block
+ * @param count Number of values, or bytes for STAT_KIND_OTHER
+ */
+void add_schema_entry(stringbuf& schema, const stringbuf& name, int kind,
+        W64 offset, int count);
+
 inline static YAML::Emitter& operator << (YAML::Emitter& out, const W64 value)
 {
     stringbuf buf;
@@ -224,6 +257,16 @@ class Statable {
          */
         YAML::Emitter& dump(YAML::Emitter &out, Stats *stats);
 
+        /**
+         * @brief Stream Statable and its childs into a StatsWriter
+         *
+         * @param out
+         * @param stats Stats object from which get stats data
+         *
+         * @return
+         */
+        StatsWriter& dump(StatsWriter &out, Stats *stats);
+
         /**
          * @brief Dump BSON representation to Stats
          *
@@ -234,6 +277,20 @@ class Statable {
          */
         bson_buffer* dump(bson_buffer *bb, Stats *stats);
 
+        /**
+         * @brief Append name, type and offset of all counters to schema
+         *
+         * @param schema Schema text of the raw stats file
+         */
+        void dump_schema(stringbuf& schema) const;
+
+        /**
+         * @brief Store the result of all StatEquations into Stats
+         *
+         * @param stats Stats database to compute
+         */
+        void compute_equations(Stats *stats) const;
+
         void add_stats(Stats& dest_stats, Stats& src_stats);
         void sub_stats(Stats& dest_stats, Stats& src_stats);
 
@@ -262,11 +319,29 @@ class StatsBuilder {
         static StatsBuilder *_builder;
         Statable *rootNode;
         W64 stat_offset;
+        W64 used_size;
+
+        struct StatRun {
+            W64 start;
+            W64 end;
+        };
+
+        dynarray<StatRun> w64_runs;
+        dynarray<StatRun> double_runs;
+        bool has_other_kinds;
+
+        void add_run(dynarray<StatRun>& runs, W64 start, W64 end);
+
+        template<typename T, int op>
+        void apply_runs(const dynarray<StatRun>& runs, Stats& dest_stats,
+                Stats& src_stats) const;
 
         StatsBuilder()
         {
             rootNode = new Statable("", true);
             stat_offset = 0;
+            used_size = 0;
+            has_other_kinds = false;
         }
 
         ~StatsBuilder()
@@ -304,15 +379,20 @@ class StatsBuilder {
          * @brief Get the offset for given StatObjBase class
          *
          * @param size Size of the memory to be allocted
+         * @param kind STAT_KIND_* of the values stored there
          *
          * @return Offset value
          */
-        W64 get_offset(int size)
+        W64 get_offset(int size, int kind = STAT_KIND_OTHER);
+
+        /**
+         * @brief Bytes of each Stats block in use by registered objects
+         *
+         * Stats blocks are only zeroed and copied up to this size.
+         */
+        W64 get_used_size() const
         {
-            W64 ret_val = stat_offset;
-            stat_offset += size;
-            assert(stat_offset < STATS_SIZE);
-            return ret_val;
+            return used_size;
         }
 
         /**
@@ -350,6 +430,16 @@ class StatsBuilder {
          */
         YAML::Emitter& dump(Stats *stats, YAML::Emitter &out) const;
 
+        /**
+         * @brief Stream Stats tree as one YAML/JSON document
+         *
+         * @param stats Use given Stats* for values
+         * @param out StatsWriter that formats and buffers the output
+         *
+         * @return
+         */
+        StatsWriter& dump(Stats *stats, StatsWriter &out) const;
+
         /**
          * @brief Dump Stats tree in BSON format
          *
@@ -360,17 +450,23 @@ class StatsBuilder {
          */
         bson_buffer* dump(Stats *stats, bson_buffer *bb) const;
 
-        void init_timer_stats();
+        /**
+         * @brief Write the used part of Stats blocks into a raw file
+         *
+         * @param os Binary output stream
+         * @param stats Stats blocks to save
+         * @param names Name of each block (kernel, user, ...)
+         * @param count Number of blocks
+         *
+         * @return
+         */
+        ostream& dump_raw(ostream &os, Stats **stats, const char **names,
+                int count) const;
 
-        void add_stats(Stats& dest_stats, Stats& src_stats) const
-        {
-            rootNode->add_stats(dest_stats, src_stats);
-        }
+        void init_timer_stats();
 
-        void sub_stats(Stats& dest_stats, Stats& src_stats) const
-        {
-            rootNode->sub_stats(dest_stats, src_stats);
-        }
+        void add_stats(Stats& dest_stats, Stats& src_stats) const;
+        void sub_stats(Stats& dest_stats, Stats& src_stats) const;
 
         void add_periodic_stats(Stats& dest_stats, Stats& src_stats) const
         {
@@ -395,6 +491,9 @@ class StatsBuilder {
 
             rootNode = new Statable("", true);
             stat_offset = 0;
+            w64_runs.clear();
+            double_runs.clear();
+            has_other_kinds = false;
         }
 
 		StatObjBase* get_stat_obj(stringbuf &name);
@@ -413,10 +512,12 @@ class Stats {
     private:
         W8 *mem;
 
+        /* Fresh pages are zero and only committed once a counter is used */
         Stats()
         {
-            mem = new W8[STATS_SIZE];
-            reset();
+            mem = (W8*)alloc_host_pages(STATS_SIZE,
+                    machine_arena.get_page_mode());
+            assert(mem);
         }
 
     public:
@@ -429,7 +530,7 @@ class Stats {
 
         void reset()
         {
-            memset(mem, 0, sizeof(W8) * STATS_SIZE);
+            memset(mem, 0, (StatsBuilder::get()).get_used_size());
         }
 
         Stats& operator+=(Stats& rhs_stats)
@@ -440,7 +541,7 @@ class Stats {
 
         Stats& operator=(Stats& rhs_stats)
         {
-            memcpy(mem, rhs_stats.mem, sizeof(W8) * STATS_SIZE);
+            memcpy(mem, rhs_stats.mem, (StatsBuilder::get()).get_used_size());
             return *this;
         }
 };
@@ -476,8 +577,14 @@ class StatObjBase {
 				const char* pfx="") const = 0;
         virtual YAML::Emitter& dump(YAML::Emitter& out,
                 Stats *stats) const = 0;
+        virtual StatsWriter& dump(StatsWriter& out,
+                Stats *stats) const = 0;
         virtual bson_buffer* dump(bson_buffer* out,
                 Stats *stats) const = 0;
+        virtual void dump_schema(stringbuf& schema) const = 0;
+
+        /* Only StatEquation has a value to compute before it is read */
+        virtual void compute(Stats *stats) const { }
 
         virtual ostream& dump_periodic(ostream &os, Stats *stats) const = 0;
 
@@ -588,7 +695,7 @@ class StatObj : public StatObjBase {
         {
             StatsBuilder &builder = StatsBuilder::get();
 
-            offset = builder.get_offset(sizeof(T));
+            offset = builder.get_offset(sizeof(T), StatKind<T>::value);
 
             set_default_var_ptr();
         }
@@ -873,6 +980,31 @@ class StatObj : public StatObjBase {
             return out;
         }
 
+        /**
+         * @brief Stream this object into StatsWriter
+         *
+         * @param out StatsWriter object
+         * @param stats Stats object from which get stats data
+         *
+         * @return
+         */
+        StatsWriter& dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return out;
+
+            out.write(name.buf, (*this)(stats));
+
+            return out;
+        }
+
+        void dump_schema(stringbuf& schema) const
+        {
+            stringbuf *full_string = get_full_stat_string();
+            add_schema_entry(schema, *full_string, StatKind<T>::value, offset,
+                    StatKind<T>::value == STAT_KIND_OTHER ? sizeof(T) : 1);
+            delete full_string;
+        }
+
         /**
          * @brief Dump StatObj to BSON format
          *
@@ -979,7 +1111,7 @@ class StatArray : public StatObjBase {
         {
             StatsBuilder &builder = StatsBuilder::get();
 
-            offset = builder.get_offset(sizeof(T) * size);
+            offset = builder.get_offset(sizeof(T) * size, StatKind<T>::value);
 
             set_default_var_ptr();
         }
@@ -1104,6 +1236,58 @@ class StatArray : public StatObjBase {
             return out;
         }
 
+        /**
+         * @brief Stream StatArray into StatsWriter
+         *
+         * @param out StatsWriter to write into
+         * @param stats Stats* from which to get array values
+         *
+         * @return
+         */
+        StatsWriter& dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return out;
+
+            BaseArr& arr = (*this)(stats);
+
+            if(labels) {
+                out.begin_map(name.buf);
+                foreach(i, size) {
+                    out.write(labels[i], arr[i]);
+                }
+                out.end_map();
+            } else {
+                out.begin_seq(name.buf);
+                foreach(i, size) {
+                    out.write(arr[i]);
+                }
+                out.end_seq();
+            }
+
+            return out;
+        }
+
+        void dump_schema(stringbuf& schema) const
+        {
+            stringbuf *full_string = get_full_stat_string();
+            int kind = StatKind<T>::value;
+            int elem_count = (kind == STAT_KIND_OTHER) ? sizeof(T) : 1;
+
+            if (labels) {
+                foreach(i, size) {
+                    stringbuf label_name;
+                    label_name << *full_string << "." << labels[i];
+                    add_schema_entry(schema, label_name, kind,
+                            offset + i * sizeof(T), elem_count);
+                }
+            } else {
+                add_schema_entry(schema, *full_string, kind, offset,
+                        elem_count * size);
+            }
+
+            delete full_string;
+        }
+
         /**
          * @brief Dump StatArray to BSON format
          *
@@ -1312,7 +1496,8 @@ class StatString : public StatObjBase {
 
             StatsBuilder& builder = StatsBuilder::get();
 
-            offset = builder.get_offset(sizeof(char) * MAX_STAT_STR_SIZE);
+            offset = builder.get_offset(sizeof(char) * MAX_STAT_STR_SIZE,
+                    STAT_KIND_NONE);
 
             set_default_var_ptr();
         }
@@ -1483,6 +1668,43 @@ class StatString : public StatObjBase {
             return out;
         }
 
+        /**
+         * @brief Stream string of given database into StatsWriter
+         *
+         * @param out StatsWriter to write into
+         * @param stats Stats database to read string from
+         */
+        StatsWriter& dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return out;
+
+            char* var = (*this)(stats);
+
+            if(split[0] != '\0') {
+                dynarray<stringbuf*> tags;
+                stringbuf st_tags; st_tags << var;
+                st_tags.split(tags, split);
+
+                out.begin_seq(name.buf);
+                foreach(i, tags.size()) {
+                    out.write(tags[i]->buf);
+                }
+                out.end_seq();
+            } else {
+                out.write(name.buf, var);
+            }
+
+            return out;
+        }
+
+        void dump_schema(stringbuf& schema) const
+        {
+            stringbuf *full_string = get_full_stat_string();
+            add_schema_entry(schema, *full_string, STAT_KIND_NONE, offset,
+                    MAX_STAT_STR_SIZE);
+            delete full_string;
+        }
+
         /**
          * @brief Dump StatString to BSON format
          *
@@ -1603,6 +1825,8 @@ class StatEquation : public StatObj<K> {
         elems_t elems;
         F formula;
 
+    public:
+
         /**
          * @brief Perform computation and store result
          *
@@ -1614,8 +1838,6 @@ class StatEquation : public StatObj<K> {
             val = formula.compute(stats, elems);
         }
 
-    public:
-
         /**
          * @brief Default Constructor
          *
@@ -1674,6 +1896,20 @@ class StatEquation : public StatObj<K> {
             return base_t::dump(out, stats);
         }
 
+        /**
+         * @brief Stream value of this Stats Object
+         *
+         * @param out StatsWriter to write into
+         * @param stats Stats Database that holds the value
+         *
+         * @return Updated StatsWriter
+         */
+        StatsWriter& dump(StatsWriter& out, Stats *stats) const
+        {
+            compute(stats);
+            return base_t::dump(out, stats);
+        }
+
         /**
          * @brief Dump BSON value of this Stats Object
          *
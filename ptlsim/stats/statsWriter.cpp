@@ -0,0 +1,249 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <statsWriter.h>
+
+#include <yaml/emitterutils.h>
+
+StatsWriter::StatsWriter(ostream& os, int format)
+    : os(os)
+      , format(format)
+      , buf_used(0)
+      , depth(0)
+{
+    count[0] = 0;
+}
+
+StatsWriter::~StatsWriter()
+{
+    flush();
+}
+
+void StatsWriter::flush()
+{
+    if (buf_used) {
+        os.write(buf, buf_used);
+        buf_used = 0;
+    }
+}
+
+void StatsWriter::put(const char *str, int len)
+{
+    while (len > 0) {
+        if (buf_used == BUF_SIZE) flush();
+
+        int n = min(len, BUF_SIZE - buf_used);
+        memcpy(buf + buf_used, str, n);
+        buf_used += n;
+        str += n;
+        len -= n;
+    }
+}
+
+void StatsWriter::put_number(W64 value)
+{
+    char digits[24];
+    int i = sizeof(digits);
+
+    do {
+        digits[--i] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    put(digits + i, sizeof(digits) - i);
+}
+
+void StatsWriter::put_number(double value)
+{
+    if (format == FORMAT_JSON && (value != value || value - value != 0)) {
+        /* JSON has no representation for nan and inf */
+        put("null", 4);
+        return;
+    }
+
+    /* Same as the default ostream formatting used by YAML::Emitter */
+    char str[32];
+    int len = snprintf(str, sizeof(str), "%g", value);
+    put(str, len);
+}
+
+/*
+ * Names and values are nearly always simple identifiers or numbers, which
+ * YAML writes as plain scalars. Anything else goes through the YAML
+ * emitter's own quoting rules so the output does not differ.
+ */
+static bool is_simple_plain_scalar(const char *str)
+{
+    if (!isalnum(*str) && *str != '_')
+        return false;
+
+    for (const char *p = str + 1; *p; p++) {
+        if (!isalnum(*p) && *p != '_' && *p != '.' && *p != '-')
+            return false;
+    }
+
+    return true;
+}
+
+void StatsWriter::put_string(const char *str, bool in_flow)
+{
+    if (format == FORMAT_JSON) {
+        put('"');
+        for (const char *p = str; *p; p++) {
+            unsigned char c = *p;
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            } else if (c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                put(esc, 6);
+            } else {
+                put(c);
+            }
+        }
+        put('"');
+        return;
+    }
+
+    if (is_simple_plain_scalar(str)) {
+        put(str);
+        return;
+    }
+
+    YAML::ostream quoted;
+    YAML::Utils::WriteString(quoted, str, in_flow, false);
+    put(quoted.str(), quoted.pos());
+}
+
+void StatsWriter::put_key(const char *key)
+{
+    put_string(key, false);
+    put(':');
+}
+
+/* Start a new key in the current map */
+void StatsWriter::next_entry()
+{
+    if (format == FORMAT_JSON) {
+        if (count[depth]) put(", ");
+    } else {
+        put('\n');
+        for (int i = 1; i < depth; i++) put("  ", 2);
+    }
+
+    count[depth]++;
+}
+
+/* Start a new item in the current sequence */
+void StatsWriter::next_item()
+{
+    if (count[depth]) put(", ", 2);
+    count[depth]++;
+}
+
+void StatsWriter::begin_document()
+{
+    if (format == FORMAT_YAML)
+        put("---", 3);
+
+    depth = 0;
+    count[0] = 0;
+}
+
+void StatsWriter::end_document()
+{
+    assert(depth == 0);
+    put('\n');
+}
+
+void StatsWriter::begin_map(const char *key)
+{
+    if (key) {
+        next_entry();
+        put_key(key);
+    }
+
+    if (format == FORMAT_JSON)
+        put(key ? " {" : "{");
+
+    assert(depth + 1 < MAX_DEPTH);
+    count[++depth] = 0;
+}
+
+void StatsWriter::end_map()
+{
+    if (format == FORMAT_JSON) {
+        put('}');
+    } else if (!count[depth]) {
+        /* Empty maps are written in flow style on their own line */
+        put('\n');
+        for (int i = 1; i < depth; i++) put("  ", 2);
+        put("{}", 2);
+    }
+
+    depth--;
+}
+
+void StatsWriter::begin_seq(const char *key)
+{
+    next_entry();
+    put_key(key);
+    put(" [", 2);
+
+    assert(depth + 1 < MAX_DEPTH);
+    count[++depth] = 0;
+}
+
+void StatsWriter::end_seq()
+{
+    put(']');
+    depth--;
+}
+
+void StatsWriter::write(const char *key, W64 value)
+{
+    next_entry();
+    put_key(key);
+    put(' ');
+    put_number(value);
+}
+
+void StatsWriter::write(const char *key, double value)
+{
+    next_entry();
+    put_key(key);
+    put(' ');
+    put_number(value);
+}
+
+void StatsWriter::write(const char *key, const char *value)
+{
+    next_entry();
+    put_key(key);
+    put(' ');
+    put_string(value, false);
+}
+
+void StatsWriter::write(W64 value)
+{
+    next_item();
+    put_number(value);
+}
+
+void StatsWriter::write(double value)
+{
+    next_item();
+    put_number(value);
+}
+
+void StatsWriter::write(const char *value)
+{
+    next_item();
+    put_string(value, true);
+}
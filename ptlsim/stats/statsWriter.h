@@ -0,0 +1,94 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/**
+ * @brief Streaming writer for the Stats tree
+ *
+ * YAML::Emitter keeps the whole document and its emitter state in memory
+ * before anything reaches the file. StatsWriter instead formats each key as
+ * the Statable tree is walked and writes it through a fixed size buffer, so
+ * the cost of a dump only depends on the number of counters. The YAML
+ * output is byte for byte identical to the YAML::Emitter output of the same
+ * tree. In JSON mode each document is written as one line.
+ */
+class StatsWriter {
+    public:
+        enum {
+            FORMAT_YAML,
+            FORMAT_JSON,
+        };
+
+        StatsWriter(ostream& os, int format=FORMAT_YAML);
+        ~StatsWriter();
+
+        void begin_document();
+        void end_document();
+
+        /**
+         * @brief Start a nested map
+         *
+         * @param key Key of the map in its parent, NULL for the document
+         * root
+         */
+        void begin_map(const char *key);
+        void end_map();
+
+        /**
+         * @brief Start a sequence, written in flow style ([a, b]) in YAML
+         */
+        void begin_seq(const char *key);
+        void end_seq();
+
+        void write(const char *key, W64 value);
+        void write(const char *key, double value);
+        void write(const char *key, const char *value);
+
+        /* Sequence items */
+        void write(W64 value);
+        void write(double value);
+        void write(const char *value);
+
+        void flush();
+
+    private:
+        enum { BUF_SIZE = 64 * 1024 };
+        enum { MAX_DEPTH = 64 };
+
+        ostream& os;
+        int format;
+        char buf[BUF_SIZE];
+        int buf_used;
+
+        /* Number of entries written so far in each open map/sequence */
+        int count[MAX_DEPTH];
+        int depth;
+
+        void put(char c)
+        {
+            if unlikely (buf_used == BUF_SIZE) flush();
+            buf[buf_used++] = c;
+        }
+
+        void put(const char *str, int len);
+        void put(const char *str) { put(str, strlen(str)); }
+
+        void put_number(W64 value);
+        void put_number(double value);
+        void put_string(const char *str, bool in_flow);
+        void put_key(const char *key);
+        void next_entry();
+        void next_item();
+};
+
+#endif // STATS_WRITER_H
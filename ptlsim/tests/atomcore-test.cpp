@@ -849,6 +849,172 @@ namespace {
         ASSERT_EQ(thread.bb_transop_index, 0);
     }
 
+    // Point the code TLB entry of 'virt' at host page 'page'
+    void MapCodePage(Context& ctx, Waddr virt, byte* page)
+    {
+        int mmu_index = cpu_mmu_index((CPUState*)&ctx);
+        int index = (virt >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+        ctx.tlb_table[mmu_index][index].addr_code =
+            (page) ? virt : (target_ulong)-1;
+        ctx.tlb_table[mmu_index][index].addend = (Waddr)page - virt;
+    }
+
+    // Decode 'rvp' and print its uops, after the caller's flush
+    BasicBlock* DecodeUops(Context& ctx, const RIPVirtPhys& rvp,
+            stringbuf& uops)
+    {
+        BasicBlock* bb = bbcache[0].translate(ctx, rvp);
+
+        if (bb) {
+            foreach (i, bb->count) {
+                uops << bb->transops[i], endl;
+            }
+        }
+
+        return bb;
+    }
+
+    TEST_F(AtomCoreTest, BBCacheRetainAcrossTlbFlush)
+    {
+        AtomCore& core = *(AtomCore*)base_machine->cores[0];
+        Context& ctx = core.threads[0]->ctx;
+
+        // 'test rax,rax; mov $0x0,%eax; add $0x1,%rcx; jmp .'
+        static const byte code_a[] = {0x48, 0x85, 0xc0, 0xb8, 0x00, 0x00,
+            0x00, 0x00, 0x48, 0x83, 0xc1, 0x01, 0xeb, 0xfe};
+        // 'xor %eax,%eax; jmp .'
+        static const byte code_b[] = {0x31, 0xc0, 0xeb, 0xfe};
+
+        byte* host = (byte*)malloc(3 << TARGET_PAGE_BITS);
+        byte* page_a = (byte*)ceil((Waddr)host, TARGET_PAGE_SIZE);
+        byte* page_b = page_a + TARGET_PAGE_SIZE;
+        memset(page_a, 0x90, 2 << TARGET_PAGE_BITS);
+        memcpy(page_a, code_a, sizeof(code_a));
+        memcpy(page_b, code_b, sizeof(code_b));
+        hvirt_gphys_map.add((Waddr)page_a, 0x10000);
+        hvirt_gphys_map.add((Waddr)page_b, 0x20000);
+
+        bool use64 = ctx.use64;
+        ctx.use64 = 1;
+
+        Waddr virt = 0x600000;
+        MapCodePage(ctx, virt, page_a);
+        RIPVirtPhys rvp(virt);
+        rvp.update(ctx);
+
+        // Flush-everything baseline
+        stringbuf baseline_a;
+        bbcache[0].flush(0);
+        BasicBlock* bb = DecodeUops(ctx, rvp, baseline_a);
+        ASSERT_TRUE(bb);
+        ASSERT_EQ(bb->bytes, sizeof(code_a));
+        ASSERT_EQ(bb->rip.mfnlo, 0x10);
+
+        // A TLB flush with the same mapping keeps the decoded block
+        stringbuf retained_a;
+        bbcache[0].flush_tlb(0);
+        ASSERT_EQ(DecodeUops(ctx, rvp, retained_a), bb);
+        ASSERT_STREQ(baseline_a, retained_a);
+        ASSERT_EQ(bb->tlb_epoch, bbcache[0].tlb_epoch);
+
+        // After a remap the block is decoded from the new page
+        stringbuf baseline_b, remapped_b;
+        MapCodePage(ctx, virt, page_b);
+        bbcache[0].flush(0);
+        ASSERT_TRUE(DecodeUops(ctx, rvp, baseline_b));
+
+        MapCodePage(ctx, virt, page_a);
+        bbcache[0].flush(0);
+        ASSERT_TRUE(DecodeUops(ctx, rvp, retained_a));
+
+        MapCodePage(ctx, virt, page_b);
+        bbcache[0].flush_tlb(0);
+        bb = DecodeUops(ctx, rvp, remapped_b);
+        ASSERT_TRUE(bb);
+        ASSERT_EQ(bb->bytes, sizeof(code_b));
+        ASSERT_EQ(bb->rip.mfnlo, 0x20);
+        ASSERT_STREQ(baseline_b, remapped_b);
+        ASSERT_STRNE(baseline_a, remapped_b);
+
+        bbcache[0].flush(0);
+        MapCodePage(ctx, virt, NULL);
+        ctx.use64 = use64;
+        hvirt_gphys_map.remove((Waddr)page_a);
+        hvirt_gphys_map.remove((Waddr)page_b);
+        free(host);
+    }
+
+    TEST_F(AtomCoreTest, SMCCodePageBitmap)
+    {
+        AtomCore& core = *(AtomCore*)base_machine->cores[0];
+        Context& ctx = core.threads[0]->ctx;
+
+        // 'add $0x1,%rcx; jmp .'
+        static const byte code[] = {0x48, 0x83, 0xc1, 0x01, 0xeb, 0xfe};
+
+        byte* host = (byte*)malloc(2 << TARGET_PAGE_BITS);
+        byte* page = (byte*)ceil((Waddr)host, TARGET_PAGE_SIZE);
+        memset(page, 0x90, TARGET_PAGE_SIZE);
+        memcpy(page, code, sizeof(code));
+        hvirt_gphys_map.add((Waddr)page, 0x30000);
+
+        bool use64 = ctx.use64;
+        ctx.use64 = 1;
+
+        Waddr virt = 0x700000;
+        MapCodePage(ctx, virt, page);
+        RIPVirtPhys rvp(virt);
+        rvp.update(ctx);
+
+        bbcache[0].flush(0);
+        ASSERT_FALSE(smc_code_pages.iscode(0x30));
+
+        stringbuf uops;
+        ASSERT_TRUE(DecodeUops(ctx, rvp, uops));
+        ASSERT_TRUE(smc_code_pages.iscode(0x30));
+        ASSERT_FALSE(smc_isdirty(0x30));
+
+        // Stores to pages without decoded code are ignored
+        smc_setdirty(0x40008);
+        ASSERT_FALSE(smc_isdirty(0x40));
+
+        smc_setdirty(0x30ff8);
+        ASSERT_TRUE(smc_isdirty(0x30));
+
+        // Invalidating the page's blocks clears it
+        ASSERT_TRUE(bbcache[0].invalidate_page(0x30, INVALIDATE_REASON_SMC));
+        ASSERT_FALSE(smc_isdirty(0x30));
+        ASSERT_FALSE(smc_code_pages.iscode(0x30));
+        ASSERT_FALSE(bbcache[0].get(rvp));
+
+        ASSERT_TRUE(DecodeUops(ctx, rvp, uops));
+        ASSERT_TRUE(smc_code_pages.iscode(0x30));
+        ASSERT_FALSE(smc_isdirty(0x30));
+
+        // Functional stores mark the page, translate() decodes it again
+        int mmu_idx = (ctx.kernel_mode) ? 0 : MMU_USER_IDX;
+        CPUTLBEntry& entry = ctx.tlb_table[mmu_idx][
+            (virt >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1)];
+        entry.addr_write = virt;
+        entry.addend = (Waddr)page - virt;
+        ctx.storemask_virt(virt + 0x100, 0x90, 0xff, 0);
+        ASSERT_TRUE(smc_isdirty(0x30));
+
+        ASSERT_TRUE(DecodeUops(ctx, rvp, uops));
+        ASSERT_FALSE(bbcache[0].busy);
+        ASSERT_TRUE(smc_code_pages.iscode(0x30));
+        ASSERT_FALSE(smc_isdirty(0x30));
+        entry.addr_write = (target_ulong)-1;
+
+        bbcache[0].flush(0);
+        ASSERT_FALSE(smc_code_pages.iscode(0x30));
+
+        MapCodePage(ctx, virt, NULL);
+        ctx.use64 = use64;
+        hvirt_gphys_map.remove((Waddr)page);
+        free(host);
+    }
+
     TEST_F(AtomCoreTest, ThreadStoreBuf)
     {
         AtomCore& core = *(AtomCore*)base_machine->cores[0];
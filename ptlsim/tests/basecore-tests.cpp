@@ -6,6 +6,7 @@
 #include <basecore.h>
 
 #include <machine.h>
+#include <uoptable.h>
 
 namespace {
 
@@ -58,4 +59,66 @@ namespace {
         }
     }
 
+    static const char* test_units[] = {"alu0", "alu1", "fpu0", "port0"};
+
+    static const char* write_uop_table(const char* text)
+    {
+        static char filename[] = "/tmp/uoptable-test-XXXXXX";
+        strcpy(filename + strlen(filename) - 6, "XXXXXX");
+        int fd = mkstemp(filename);
+        EXPECT_GE(fd, 0);
+        EXPECT_EQ(write(fd, text, strlen(text)), (ssize_t)strlen(text));
+        close(fd);
+        return filename;
+    }
+
+    TEST(UopTable, LoadOverridesBuiltIn)
+    {
+        UopTable table;
+        foreach (i, OP_MAX_OPCODE) table.set(i, 1, true, 0x3);
+
+        const char* file = write_uop_table(
+                "# opcode, size, latency, pipelined, units\n"
+                "mull, *, 3, 1, alu1\n"
+                "\n"
+                "div, 8, 40, 0, fpu0 port0  # 64 bit divide only\n");
+
+        ASSERT_TRUE(table.load(file, test_units, 4, 0xf));
+        unlink(file);
+
+        foreach (size, UopTable::SIZE_COUNT) {
+            ASSERT_EQ(table.get(OP_mull, size).latency, 3);
+            ASSERT_EQ(table.get(OP_mull, size).units, 0x2);
+        }
+
+        ASSERT_EQ(table.get(OP_div, 3).latency, 40);
+        ASSERT_FALSE(table.get(OP_div, 3).pipelined);
+        ASSERT_EQ(table.get(OP_div, 3).units, 0xc);
+
+        /* Sizes and opcodes not listed keep their values */
+        ASSERT_EQ(table.get(OP_div, 2).latency, 1);
+        ASSERT_TRUE(table.get(OP_div, 2).pipelined);
+        ASSERT_EQ(table.get(OP_add, 0).units, 0x3);
+    }
+
+    TEST(UopTable, LoadRejectsInvalidEntries)
+    {
+        const char* bad[] = {
+            "notanop, *, 1, 1, alu0\n",
+            "add, 3, 1, 1, alu0\n",
+            "add, *, 0, 1, alu0\n",
+            "add, *, 1, 2, alu0\n",
+            "add, *, 1, 1, alu7\n",
+            "add, *, 1, 1\n",
+            "add, *, 1, 1, fpu0\n", /* fpu0 is not present */
+        };
+
+        foreach (i, sizeof(bad) / sizeof(bad[0])) {
+            UopTable table;
+            const char* file = write_uop_table(bad[i]);
+            ASSERT_FALSE(table.load(file, test_units, 4, 0xb)) << bad[i];
+            unlink(file);
+        }
+    }
+
 }; // namespace
@@ -42,6 +42,76 @@ namespace {
         }
     }
 
+    /*
+     * Compare match() and matchany() of 8 and 16 bit tag arrays with a
+     * scalar search, so the SSE and the AVX2/AVX-512 paths (depending on
+     * the build flags) are checked against the same reference.
+     */
+    template <typename T>
+    static void check_assoc_matches(T& tags, int size, int range)
+    {
+        typedef typename T::base_t base_t;
+
+        foreach (i, size) {
+            if (random() % 4) tags.insertslot(i, random() % range);
+        }
+
+        foreach (n, 256) {
+            base_t target = random() % range;
+            bitvec<T::SIZE> eq = tags.match(target);
+            bitvec<T::SIZE> any = tags.matchany(target);
+
+            foreach (i, size) {
+                bool valid = tags.isvalid(i);
+                ASSERT_EQ(eq[i], valid && tags[i] == target) << i;
+                ASSERT_EQ(any[i], valid && (tags[i] & target) != 0) << i;
+            }
+        }
+    }
+
+    template <int size>
+    struct AssocTags8: public FullyAssociativeTags8bit<size, size> {
+        static const int SIZE = size;
+    };
+
+    template <int size>
+    struct AssocTags16: public FullyAssociativeTags16bit<size, size> {
+        static const int SIZE = size;
+    };
+
+    TEST(Logic, AssocTagsWideMatch)
+    {
+        srandom(1);
+
+        { AssocTags8<16> t; check_assoc_matches(t, 16, 8); }
+        { AssocTags8<48> t; check_assoc_matches(t, 48, 16); }
+        { AssocTags8<64> t; check_assoc_matches(t, 64, 256); }
+        { AssocTags8<128> t; check_assoc_matches(t, 128, 32); }
+        { AssocTags16<24> t; check_assoc_matches(t, 24, 16); }
+        { AssocTags16<64> t; check_assoc_matches(t, 64, 1024); }
+        { AssocTags16<128> t; check_assoc_matches(t, 128, 65536); }
+    }
+
+    /* TLB style one-hot tags, checked against the scalar tag mirror */
+    TEST(Logic, AssocTagsOneHotWideMatch)
+    {
+        const int size = 48;
+        FullyAssociativeTagsNbitOneHot<size, 40> tags;
+
+        srandom(2);
+        foreach (i, size) {
+            tags.update(i, ((W64)random() << 8) ^ i);
+        }
+        tags.invalidateslot(5);
+
+        foreach (i, size) {
+            if (i == 5) continue;
+            ASSERT_EQ(tags.match(tags.tagsmirror[i]), i);
+        }
+
+        ASSERT_EQ(tags.match(0x123456789ULL << 8 | 0xff), -1);
+    }
+
     /* Test simulation freq related functions */
     TEST(Sim, SimFreq)
     {
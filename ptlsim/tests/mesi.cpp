@@ -8,6 +8,10 @@
 #include <memoryHierarchy.h>
 #include <coherentCache.h>
 #include <mesiLogic.h>
+#include <p2p.h>
+#include <switch.h>
+#include <ring.h>
+#include <shadowCache.h>
 #include <machine.h>
 
 using namespace Memory;
@@ -405,4 +409,477 @@ namespace {
         ASSERT_EQ(st, exc);
         r();
     }
+
+    /* Records the cycle and line state of each message it accepts */
+    class TestLinkCont : public Controller
+    {
+        public:
+            TestLinkCont(MemoryHierarchy *mem, const char *name)
+                : Controller(0, name, mem)
+                , rejects(0)
+            { }
+
+            dynarray<W64> arrived;
+            dynarray<bool> data;
+            dynarray<int> states;
+            int rejects;
+
+            bool handle_interconnect_cb(void *arg)
+            {
+                if (rejects) {
+                    rejects--;
+                    return false;
+                }
+
+                arrived.push(sim_cycle);
+                Message *msg = (Message*)arg;
+                data.push(msg->hasData);
+                states.push((msg->argIsState) ? *(W8*)msg->arg : -1);
+                return true;
+            }
+
+            int access_fast_path(Interconnect *interconnect,
+                    MemoryRequest *request)
+            {
+                return 3;
+            }
+
+            void register_interconnect(Interconnect *interconnect,
+                    int conn_type) { }
+            void print_map(ostream& os) { }
+            void print(ostream& os) const { }
+            bool is_full(bool fromInterconnect = false) const { return false; }
+            void annul_request(MemoryRequest *request) { }
+            void dump_configuration(YAML::Emitter &out) const { }
+    };
+
+    /*
+     * Gives each interconnect test its own MemoryHierarchy on the "base"
+     * machine. Everything made through the helpers is deleted again and the
+     * options are removed, so the option names must be unique to the test.
+     */
+    class InterconnectTest : public ::testing::Test
+    {
+        public:
+            BaseMachine *machine;
+            MemoryHierarchy *mem;
+            MemoryHierarchy *old_mem;
+
+            dynarray<Interconnect*> interconnects;
+            dynarray<Controller*> conts;
+            dynarray<const char*> int_names;
+            dynarray<const char*> str_names;
+            dynarray<const char*> str_opts;
+
+            void SetUp()
+            {
+                machine = (BaseMachine*)(PTLsimMachine::getmachine("base"));
+                old_mem = machine->memoryHierarchyPtr;
+                mem = new MemoryHierarchy(*machine);
+                machine->memoryHierarchyPtr = mem;
+            }
+
+            void TearDown()
+            {
+                foreach (i, interconnects.count())
+                    delete interconnects[i];
+
+                foreach (i, conts.count())
+                    delete conts[i];
+
+                machine->memoryHierarchyPtr = old_mem;
+                delete mem;
+
+                foreach (i, int_names.count()) {
+                    IntOptions *opts;
+                    if (machine->int_options.remove(int_names[i], opts))
+                        delete opts;
+                }
+
+                foreach (i, str_names.count()) {
+                    StrOptions **opts = machine->str_options.get(str_names[i]);
+                    stringbuf *val;
+                    if (opts && (*opts)->remove(str_opts[i], val))
+                        delete val;
+                }
+
+                foreach (i, str_names.count()) {
+                    StrOptions *opts;
+                    if (machine->str_options.remove(str_names[i], opts))
+                        delete opts;
+                }
+
+                sim_cycle = 0;
+            }
+
+            void add_option(const char *name, const char *opt, int value)
+            {
+                machine->add_option(name, opt, value);
+                int_names.push(name);
+            }
+
+            void add_option(const char *name, const char *opt,
+                    const char *value)
+            {
+                machine->add_option(name, opt, value);
+                str_names.push(name);
+                str_opts.push(opt);
+            }
+
+            TestLinkCont* add_cont(const char *name)
+            {
+                TestLinkCont *cont = new TestLinkCont(mem, name);
+                conts.push(cont);
+                return cont;
+            }
+
+            template <typename T>
+            T* add_interconnect(T *interconnect)
+            {
+                interconnects.push(interconnect);
+                return interconnect;
+            }
+    };
+
+    TEST_F(InterconnectTest, P2PLinkTiming)
+    {
+        add_option("p2p_timed_test", "latency", 3);
+        add_option("p2p_timed_test", "width_bytes", 16);
+        add_option("p2p_timed_test", "queue_size", 2);
+        add_option("p2p_width_test", "width_bytes", 16);
+
+        TestLinkCont* upper = add_cont("upper");
+        TestLinkCont* lower = add_cont("lower");
+
+        P2PInterconnect* timed = add_interconnect(
+                new P2PInterconnect("p2p_timed_test", mem));
+        timed->register_controller(upper);
+        timed->register_controller(lower);
+
+        P2PInterconnect* direct = add_interconnect(
+                new P2PInterconnect("p2p_direct_test", mem));
+        direct->register_controller(upper);
+        direct->register_controller(lower);
+
+        P2PInterconnect* width = add_interconnect(
+                new P2PInterconnect("p2p_width_test", mem));
+        width->register_controller(upper);
+        width->register_controller(lower);
+
+        MemoryRequest* req = mem->get_free_request(0);
+        req->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+
+        Message msg;
+        msg.init();
+        msg.sender = upper;
+        msg.request = req;
+
+        /* Zero latency links deliver in the same call */
+        sim_cycle = 100;
+        ASSERT_TRUE(direct->controller_request_cb(&msg));
+        ASSERT_EQ(1, lower->arrived.count());
+        ASSERT_EQ(100, lower->arrived[0]);
+        ASSERT_EQ(3, direct->access_fast_path(upper, req));
+        ASSERT_EQ(-1, timed->access_fast_path(upper, req));
+        ASSERT_EQ(-1, width->access_fast_path(upper, req));
+        lower->arrived.clear();
+
+        /* One flit request, then a 4 flit line behind it. The request
+         * carries the line state it had when it was sent. */
+        W8 line_state = MESI_EXCLUSIVE;
+        msg.arg = &line_state;
+        msg.argIsState = true;
+        ASSERT_TRUE(timed->controller_request_cb(&msg));
+        line_state = MESI_INVALID;
+        msg.arg = NULL;
+        msg.argIsState = false;
+        msg.hasData = true;
+        ASSERT_TRUE(timed->controller_request_cb(&msg));
+
+        /* Queue is full until the first message is delivered */
+        ASSERT_FALSE(timed->controller_request_cb(&msg));
+        ASSERT_EQ(0, lower->arrived.count());
+
+        /* The line is rejected once, it is retried in the next cycle */
+        for (sim_cycle = 101; sim_cycle <= 120; sim_cycle++) {
+            if (sim_cycle == 107)
+                lower->rejects = 1;
+            mem->clock();
+        }
+
+        ASSERT_EQ(2, lower->arrived.count());
+        ASSERT_EQ(103, lower->arrived[0]);
+        ASSERT_EQ(108, lower->arrived[1]);
+        ASSERT_EQ(MESI_EXCLUSIVE, lower->states[0]);
+        ASSERT_EQ(-1, lower->states[1]);
+        ASSERT_EQ(0, req->get_ref_counter());
+
+        /* Annuled messages are dropped from the queue */
+        sim_cycle = 200;
+        ASSERT_TRUE(timed->controller_request_cb(&msg));
+        ASSERT_EQ(1, req->get_ref_counter());
+        timed->annul_request(req);
+        ASSERT_EQ(0, req->get_ref_counter());
+
+        for (sim_cycle = 201; sim_cycle <= 220; sim_cycle++) {
+            mem->clock();
+        }
+        ASSERT_EQ(2, lower->arrived.count());
+    }
+
+    TEST_F(InterconnectTest, SwitchVirtualChannels)
+    {
+        add_option("switch_age_test", "arbitration", "age");
+        add_option("switch_prio_test", "arbitration", "priority");
+
+        TestLinkCont* a = add_cont("sw_a");
+        TestLinkCont* b = add_cont("sw_b");
+        TestLinkCont* c = add_cont("sw_c");
+
+        SwitchInterconnect::Switch* rr = add_interconnect(
+                new SwitchInterconnect::Switch("switch_rr_test", mem));
+        SwitchInterconnect::Switch* age = add_interconnect(
+                new SwitchInterconnect::Switch("switch_age_test", mem));
+        SwitchInterconnect::Switch* prio = add_interconnect(
+                new SwitchInterconnect::Switch("switch_prio_test", mem));
+
+        rr->register_controller(a);
+        rr->register_controller(b);
+        rr->register_controller(c);
+        age->register_controller(a);
+        age->register_controller(c);
+        prio->register_controller(a);
+        prio->register_controller(c);
+
+        MemoryRequest* req = mem->get_free_request(0);
+        req->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+        MemoryRequest* other = mem->get_free_request(0);
+        other->init(0, 0, 0x2000, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+
+        Message msg;
+        msg.init();
+        msg.request = req;
+
+        /* A request stuck on a busy destination doesn't block the
+         * response queued behind it */
+        sim_cycle = 100;
+        b->rejects = 1000;
+        msg.sender = a;
+        msg.dest = b;
+        ASSERT_TRUE(rr->controller_request_cb(&msg));
+        msg.dest = c;
+        msg.hasData = true;
+        ASSERT_TRUE(rr->controller_request_cb(&msg));
+
+        for (sim_cycle = 101; sim_cycle <= 120; sim_cycle++) {
+            mem->clock();
+        }
+
+        ASSERT_EQ(0, b->arrived.count());
+        ASSERT_EQ(1, c->arrived.count());
+        ASSERT_TRUE(c->data[0]);
+
+        rr->annul_request(req);
+        ASSERT_EQ(0, req->get_ref_counter());
+        c->arrived.clear();
+        c->data.clear();
+
+        /* An older request and a newer response to the same port */
+        foreach (i, 2) {
+            SwitchInterconnect::Switch* sw = (i == 0) ? age : prio;
+
+            sim_cycle = 200 + i * 100;
+            msg.sender = a;
+            msg.dest = c;
+            msg.hasData = false;
+            ASSERT_TRUE(sw->controller_request_cb(&msg));
+
+            sim_cycle++;
+            msg.sender = c;
+            msg.dest = a;
+            msg.hasData = true;
+            ASSERT_TRUE(sw->controller_request_cb(&msg));
+            msg.sender = a;
+            msg.dest = c;
+            msg.request = other;
+            ASSERT_TRUE(sw->controller_request_cb(&msg));
+            msg.request = req;
+
+            for (; sim_cycle <= 220 + i * 100; sim_cycle++) {
+                mem->clock();
+            }
+        }
+
+        /* Age sends the request first, priority the response */
+        ASSERT_EQ(4, c->data.count());
+        ASSERT_FALSE(c->data[0]);
+        ASSERT_TRUE(c->data[1]);
+        ASSERT_TRUE(c->data[2]);
+        ASSERT_FALSE(c->data[3]);
+        ASSERT_EQ(2, a->arrived.count());
+        ASSERT_EQ(0, req->get_ref_counter());
+
+        /* An evict waits for the older response for its line, even when
+         * that response is stuck behind one to a busy port */
+        MemoryRequest* evict = mem->get_free_request(0);
+        evict->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_EVICT);
+        c->arrived.clear();
+        c->data.clear();
+
+        sim_cycle = 500;
+        b->rejects = 1000;
+        msg.sender = a;
+        msg.hasData = true;
+        msg.dest = b;
+        msg.request = other;
+        ASSERT_TRUE(rr->controller_request_cb(&msg));
+        msg.dest = c;
+        msg.request = req;
+        ASSERT_TRUE(rr->controller_request_cb(&msg));
+        msg.hasData = false;
+        msg.request = evict;
+        ASSERT_TRUE(rr->controller_request_cb(&msg));
+
+        for (; sim_cycle <= 520; sim_cycle++) {
+            mem->clock();
+        }
+
+        ASSERT_EQ(0, c->arrived.count());
+
+        b->rejects = 0;
+        for (; sim_cycle <= 540; sim_cycle++) {
+            mem->clock();
+        }
+
+        ASSERT_EQ(1, b->arrived.count());
+        ASSERT_EQ(2, c->data.count());
+        ASSERT_TRUE(c->data[0]);
+        ASSERT_FALSE(c->data[1]);
+        ASSERT_EQ(0, req->get_ref_counter());
+        ASSERT_EQ(0, other->get_ref_counter());
+        ASSERT_EQ(0, evict->get_ref_counter());
+    }
+
+    TEST_F(InterconnectTest, RingHopLatency)
+    {
+        add_option("ring_test", "hop_latency", 2);
+        add_option("ring_test", "queue_size", 3);
+
+        TestLinkCont* stop[4];
+        RingInterconnect::Ring* ring = add_interconnect(
+                new RingInterconnect::Ring("ring_test", mem));
+
+        foreach (i, 4) {
+            stringbuf name;
+            name << "ring_stop_" << i;
+            stop[i] = add_cont(name.buf);
+            ring->register_controller(stop[i]);
+        }
+
+        /* Shortest path, clockwise on a tie */
+        ASSERT_EQ(RingInterconnect::RING_CW, ring->get_direction(0, 1));
+        ASSERT_EQ(RingInterconnect::RING_CW, ring->get_direction(0, 2));
+        ASSERT_EQ(RingInterconnect::RING_CCW, ring->get_direction(0, 3));
+        ASSERT_EQ(1, ring->get_hops(0, 3, RingInterconnect::RING_CCW));
+
+        MemoryRequest* req = mem->get_free_request(0);
+        req->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+
+        Message msg;
+        msg.init();
+        msg.sender = stop[0];
+        msg.request = req;
+
+        sim_cycle = 100;
+        msg.dest = stop[1];
+        ASSERT_TRUE(ring->controller_request_cb(&msg));
+        msg.dest = stop[3];
+        ASSERT_TRUE(ring->controller_request_cb(&msg));
+        msg.dest = stop[2];
+        ASSERT_TRUE(ring->controller_request_cb(&msg));
+
+        /* Injection queue is full */
+        ASSERT_FALSE(ring->controller_request_cb(&msg));
+
+        for (sim_cycle = 101; sim_cycle <= 120; sim_cycle++) {
+            mem->clock();
+        }
+
+        /* One message injected per cycle, 2 cycles per hop */
+        ASSERT_EQ(1, stop[1]->arrived.count());
+        ASSERT_EQ(103, stop[1]->arrived[0]);
+        ASSERT_EQ(1, stop[3]->arrived.count());
+        ASSERT_EQ(104, stop[3]->arrived[0]);
+        ASSERT_EQ(1, stop[2]->arrived.count());
+        ASSERT_EQ(107, stop[2]->arrived[0]);
+        ASSERT_EQ(0, req->get_ref_counter());
+
+        /* A rejected message waits in the ejection queue */
+        sim_cycle = 200;
+        stop[2]->rejects = 2;
+        ASSERT_TRUE(ring->controller_request_cb(&msg));
+
+        for (sim_cycle = 201; sim_cycle <= 220; sim_cycle++) {
+            mem->clock();
+        }
+
+        ASSERT_EQ(2, stop[2]->arrived.count());
+        ASSERT_EQ(207, stop[2]->arrived[1]);
+
+        /* Annuled messages are dropped from the ring */
+        sim_cycle = 300;
+        ASSERT_TRUE(ring->controller_request_cb(&msg));
+        sim_cycle++;
+        mem->clock();
+        ring->annul_request(req);
+        ASSERT_EQ(0, req->get_ref_counter());
+
+        for (sim_cycle = 302; sim_cycle <= 320; sim_cycle++) {
+            mem->clock();
+        }
+        ASSERT_EQ(2, stop[2]->arrived.count());
+    }
+
+    TEST(ShadowCache, HitMissCounting)
+    {
+        BaseMachine* machine = (BaseMachine*)(PTLsimMachine::getmachine("base"));
+        MemoryHierarchy* mem = new MemoryHierarchy(*machine);
+        ShadowCache* shadow = new ShadowCache("shadow_test", 0, mem);
+        const ShadowCacheStats& stats = shadow->get_stats();
+
+        W64 hit_read = stats.hit.read(user_stats);
+        W64 hit_write = stats.hit.write(user_stats);
+        W64 miss_read = stats.miss.read(user_stats);
+        W64 miss_write = stats.miss.write(user_stats);
+
+        MemoryRequest* req = mem->get_free_request(0);
+        req->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+
+        /* The first read allocates the line, the rest of them hit */
+        shadow->access(req);
+        shadow->access(req);
+        req->init(0, 0, 0x1008, 0, 0, false, 0x400000, 0, MEMORY_OP_WRITE);
+        shadow->access(req);
+
+        ASSERT_EQ(miss_read + 1, stats.miss.read(user_stats));
+        ASSERT_EQ(hit_read + 1, stats.hit.read(user_stats));
+        ASSERT_EQ(hit_write + 1, stats.hit.write(user_stats));
+        ASSERT_EQ(miss_write, stats.miss.write(user_stats));
+
+        /* A write to another line misses, updates and evicts are ignored */
+        req->init(0, 0, 0x2000, 0, 0, false, 0x400000, 0, MEMORY_OP_WRITE);
+        shadow->access(req);
+        req->init(0, 0, 0x3000, 0, 0, false, 0x400000, 0, MEMORY_OP_UPDATE);
+        shadow->access(req);
+        req->init(0, 0, 0x1000, 0, 0, false, 0x400000, 0, MEMORY_OP_EVICT);
+        shadow->access(req);
+
+        ASSERT_EQ(miss_write + 1, stats.miss.write(user_stats));
+        ASSERT_EQ(miss_read + 1, stats.miss.read(user_stats));
+        ASSERT_EQ(hit_read + 1, stats.hit.read(user_stats));
+        ASSERT_EQ(hit_write + 1, stats.hit.write(user_stats));
+
+        delete shadow;
+        delete mem;
+    }
 };
@@ -5,6 +5,16 @@
 #include <ptlsim.h>
 #include <ptl-qemu.h>
 #include <superstl.h>
+#include <arena.h>
+#include <logic.h>
+#include <llcSlice.h>
+#include <memoryHierarchy.h>
+#include <cacheLines.h>
+#include <cacheController.h>
+#include <machine.h>
+#include <rtm.h>
+
+#include <pthread.h>
 
 void read_simpoint_file();
 int get_simpoint(int id);
@@ -111,4 +121,551 @@ namespace {
         EXPECT_STREQ("test_sp_0", name->buf);
         delete name;
     }
+
+    TEST(HostPhysPageMap, AddLookup)
+    {
+        HostPhysPageMap pmap;
+        Waddr paddr;
+
+        ASSERT_FALSE(pmap.lookup(0x7f0000001000ULL, paddr));
+
+        /* Enough pages to force a few resizes */
+        foreach (i, 100000) {
+            pmap.add(0x7f0000000000ULL + (i << TARGET_PAGE_BITS),
+                    (W64)i << TARGET_PAGE_BITS);
+        }
+
+        ASSERT_EQ(100000, pmap.count);
+
+        foreach (i, 100000) {
+            Waddr host = 0x7f0000000000ULL + (i << TARGET_PAGE_BITS) + 0x123;
+            ASSERT_TRUE(pmap.lookup(host, paddr));
+            ASSERT_EQ(((W64)i << TARGET_PAGE_BITS) + 0x123, paddr);
+        }
+
+        /* Remapping a host page replaces the old guest page */
+        pmap.add(0x7f0000000000ULL, 0x5000);
+        ASSERT_EQ(100000, pmap.count);
+        ASSERT_TRUE(pmap.lookup(0x7f0000000008ULL, paddr));
+        ASSERT_EQ(0x5008, paddr);
+
+        ASSERT_FALSE(pmap.lookup(0x7e0000000000ULL, paddr));
+
+        /* Removing pages keeps the rest of each probe run reachable */
+        for (int i = 0; i < 100000; i += 2) {
+            pmap.remove(0x7f0000000000ULL + (i << TARGET_PAGE_BITS));
+        }
+
+        ASSERT_EQ(50000, pmap.count);
+
+        foreach (i, 100000) {
+            Waddr host = 0x7f0000000000ULL + (i << TARGET_PAGE_BITS);
+            ASSERT_EQ((bool)(i & 1), pmap.lookup(host, paddr));
+        }
+
+        pmap.reset();
+        ASSERT_FALSE(pmap.lookup(0x7f0000000000ULL, paddr));
+    }
+
+    /*
+     * Not a correctness test: reports host cycles per check_and_translate()
+     * call, and per lookup in the std::map the translation used before
+     */
+    TEST(HostPhysPageMap, TranslateBenchmark)
+    {
+        Context& ctx = contextof(0);
+        int mmu_index = cpu_mmu_index((CPUState*)&ctx);
+        const int pages = 256;
+        const int iterations = 1000000;
+
+        byte* host = (byte*)malloc((pages + 1) << TARGET_PAGE_BITS);
+        Waddr host_base = ceil((Waddr)host, TARGET_PAGE_SIZE);
+        Waddr virt_base = 0x400000;
+        map<Waddr, Waddr> old_map;
+
+        CPUTLBEntry saved_tlb[CPU_TLB_SIZE];
+        memcpy(saved_tlb, ctx.tlb_table[mmu_index], sizeof(saved_tlb));
+
+        foreach (i, pages) {
+            Waddr virt = virt_base + (i << TARGET_PAGE_BITS);
+            Waddr hpage = host_base + (i << TARGET_PAGE_BITS);
+            int index = (virt >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+            ctx.tlb_table[mmu_index][index].addr_read = virt;
+            ctx.tlb_table[mmu_index][index].addend = hpage - virt;
+            hvirt_gphys_map.add(hpage, i << TARGET_PAGE_BITS);
+            old_map[hpage] = i << TARGET_PAGE_BITS;
+        }
+
+        int exception, mmio;
+        PageFaultErrorCode pfec;
+        Waddr sum = 0;
+        CycleTimer new_timer("check_and_translate");
+        CycleTimer old_timer("std::map lookup");
+
+        new_timer.start();
+        foreach (i, iterations) {
+            Waddr virt = virt_base + ((i * 7) % pages << TARGET_PAGE_BITS) + 8;
+            sum += ctx.check_and_translate(virt, 3, false, false, exception,
+                    mmio, pfec);
+        }
+        new_timer.stop();
+
+        old_timer.start();
+        foreach (i, iterations) {
+            Waddr hvirt = host_base + ((i * 7) % pages << TARGET_PAGE_BITS) + 8;
+            map<Waddr, Waddr>::iterator it = old_map.find(
+                    hvirt & TARGET_PAGE_MASK);
+            sum += it->second + (hvirt & ~TARGET_PAGE_MASK);
+        }
+        old_timer.stop();
+
+        ASSERT_EQ(0, exception);
+        ASSERT_EQ(0, mmio);
+        cout << "check_and_translate: ",
+             (double)new_timer.cycles() / iterations, " cycles/call, ",
+             "std::map lookup: ", (double)old_timer.cycles() / iterations,
+             " cycles/call (", sum & 1, ")", endl;
+
+        /* Don't leave the TLB or the map pointing at the freed pages */
+        foreach (i, pages) {
+            hvirt_gphys_map.remove(host_base + (i << TARGET_PAGE_BITS));
+        }
+        memcpy(ctx.tlb_table[mmu_index], saved_tlb, sizeof(saved_tlb));
+        free(host);
+    }
+
+    /*
+     * Not a correctness test: reports host cycles for a QEMU/PTLsim
+     * switch of all contexts with full conversion of every context and
+     * when unmodified state lets the conversions be skipped
+     */
+    TEST(ArchSync, SwitchBenchmark)
+    {
+        Context& ctx = contextof(0);
+        const int iterations = 100000;
+        CycleTimer full_timer("full switch");
+        CycleTimer lazy_timer("lazy switch");
+
+        W64 eip = ctx.eip;
+        W64 reg_flags = ctx.reg_flags;
+        W64 reg_fptag = ctx.reg_fptag;
+
+        full_timer.start();
+        foreach (i, iterations) {
+            foreach (c, contextcount) {
+                contextof(c).arch_sync.stable = false;
+            }
+            setup_qemu_switch_all_ctx(ctx);
+            setup_ptlsim_switch_all_ctx(ctx);
+        }
+        full_timer.stop();
+
+        lazy_timer.start();
+        foreach (i, iterations) {
+            setup_qemu_switch_all_ctx(ctx);
+            setup_ptlsim_switch_all_ctx(ctx);
+        }
+        lazy_timer.stop();
+
+        ASSERT_TRUE(ctx.arch_sync.stable);
+        ASSERT_EQ(eip, ctx.eip);
+        ASSERT_EQ(reg_flags & FLAG_NOT_WAIT_INV, ctx.reg_flags & FLAG_NOT_WAIT_INV);
+        ASSERT_EQ(reg_fptag, ctx.reg_fptag);
+
+        /* eip moves between switches without forcing a conversion */
+        ctx.eip = eip + 4;
+        setup_qemu_switch_all_ctx(ctx);
+        ASSERT_TRUE(ctx.arch_sync.stable);
+        setup_ptlsim_switch_all_ctx(ctx);
+        ASSERT_EQ(eip + 4, ctx.eip);
+        ctx.eip = eip;
+
+        /* A modified register group must be converted again */
+        ctx.reg_fptag ^= 1;
+        setup_qemu_switch_all_ctx(ctx);
+        ASSERT_EQ(!(ctx.reg_fptag & 1), ctx.fptags[0]);
+        setup_ptlsim_switch_all_ctx(ctx);
+        ctx.reg_fptag ^= 1;
+
+        cout << "switch all contexts (", contextcount, "): full ",
+             (double)full_timer.cycles() / iterations, " cycles, lazy ",
+             (double)lazy_timer.cycles() / iterations, " cycles", endl;
+    }
+
+    struct ArenaTracked {
+        int* destroyed;
+        ArenaTracked(int* d) : destroyed(d) { }
+        ~ArenaTracked() { (*destroyed)++; }
+    };
+
+    TEST(Arena, AllocAndReset)
+    {
+        Arena arena(4096);
+        int destroyed = 0;
+
+        byte* a = (byte*)arena.alloc(10);
+        byte* b = (byte*)arena.alloc_cache_aligned(100);
+        ASSERT_EQ(0, (Waddr)a % sizeof(W64));
+        ASSERT_EQ(0, (Waddr)b % ARENA_CACHE_LINE_SIZE);
+        ASSERT_TRUE(b >= a + 10);
+
+        /* Large objects must not waste the rest of the current chunk */
+        byte* big = (byte*)arena.alloc(64 * 1024);
+        byte* c = (byte*)arena.alloc(8);
+        ASSERT_TRUE(big != NULL);
+        ASSERT_EQ(b + 104, c);
+        ASSERT_EQ(2, arena.chunks_allocated());
+
+        char* s = arena.strdup("l1_d_0_signal");
+        ASSERT_STREQ("l1_d_0_signal", s);
+
+        foreach (i, 3) {
+            arena.track(new (arena) ArenaTracked(&destroyed));
+        }
+
+        W64 heap_allocs = heap_alloc_count;
+        foreach (i, 1000) {
+            arena.alloc(64);
+        }
+        ASSERT_EQ(heap_allocs, heap_alloc_count);
+
+        arena.reset();
+        ASSERT_EQ(3, destroyed);
+        ASSERT_EQ(0, arena.bytes_allocated());
+        ASSERT_EQ(0, arena.chunks_allocated());
+    }
+
+    typedef SPSCRing<W64, 64> TestRing;
+
+    static void* ring_producer(void* arg)
+    {
+        TestRing* ring = (TestRing*)arg;
+        for (W64 i = 0; i < 10000; ) {
+            if (ring->push(i)) i++;
+        }
+        return NULL;
+    }
+
+    TEST(SPSCRing, OrderAcrossThreads)
+    {
+        TestRing* ring = new TestRing();
+        W64 val;
+
+        ASSERT_TRUE(ring->empty());
+        foreach (i, 64) {
+            ASSERT_TRUE(ring->push(i));
+        }
+        ASSERT_FALSE(ring->push(64));
+        ASSERT_EQ(64, ring->count());
+        foreach (i, 64) {
+            ASSERT_TRUE(ring->pop(val));
+            ASSERT_EQ(i, val);
+        }
+        ASSERT_FALSE(ring->pop(val));
+
+        /* Consumer sees every value in the order it was pushed */
+        pthread_t producer;
+        pthread_create(&producer, NULL, ring_producer, ring);
+
+        for (W64 expected = 0; expected < 10000; ) {
+            if (ring->pop(val)) {
+                ASSERT_EQ(expected, val);
+                expected++;
+            }
+        }
+
+        pthread_join(producer, NULL);
+        ASSERT_TRUE(ring->empty());
+        delete ring;
+    }
+
+    struct EventRecorder {
+        dynarray<W64> args;
+
+        bool record(void* arg) {
+            args.push((W64)arg);
+            return true;
+        }
+    };
+
+    TEST(SPSCRing, CoreOverflowKeepsOrder)
+    {
+        using namespace Memory;
+
+        BaseMachine* machine = (BaseMachine*)(PTLsimMachine::getmachine("base"));
+        MemoryHierarchy* mem = new MemoryHierarchy(*machine);
+        EventRecorder recorder;
+        Signal signal("ring_overflow_test");
+        signal.connect(signal_mem_ptr(recorder, &EventRecorder::record));
+
+        bool old_rings = config.mem_event_rings;
+        W64 old_cycle = sim_cycle;
+        config.mem_event_rings = 1;
+
+        /* More events than the ring holds, the rest go to the overflow */
+        mem->begin_core_cycle(NUM_SIM_CORES - 1);
+        foreach (i, 600) {
+            mem->add_event(&signal, 1 + (i & 1), (void*)(W64)i);
+        }
+        mem->end_core_cycle();
+
+        sim_cycle++;
+        mem->clock();
+        sim_cycle++;
+        mem->clock();
+
+        ASSERT_EQ(600, recorder.args.size());
+        foreach (i, 300) {
+            ASSERT_EQ(2 * i, recorder.args[i]);
+            ASSERT_EQ(2 * i + 1, recorder.args[300 + i]);
+        }
+
+        config.mem_event_rings = old_rings;
+        sim_cycle = old_cycle;
+        delete mem;
+    }
+
+    TEST(LLCSlice, HashSpread)
+    {
+        using namespace Memory;
+
+        /* Low line address bits pick the slice with 'modulo' */
+        ASSERT_EQ(0, get_slice(0x0, 6, 4, SLICE_HASH_MODULO));
+        ASSERT_EQ(1, get_slice(0x40, 6, 4, SLICE_HASH_MODULO));
+        ASSERT_EQ(3, get_slice(0x7c0, 6, 4, SLICE_HASH_MODULO));
+        ASSERT_EQ(2, get_slice(0x80, 6, 3, SLICE_HASH_MODULO));
+
+        /* Address bits 6, 7 and 8 each feed a single 'xor' index bit */
+        ASSERT_EQ(0, get_slice(0x0, 6, 8, SLICE_HASH_XOR));
+        ASSERT_EQ(1, get_slice(0x40, 6, 8, SLICE_HASH_XOR));
+        ASSERT_EQ(2, get_slice(0x80, 6, 8, SLICE_HASH_XOR));
+        ASSERT_EQ(4, get_slice(0x100, 6, 8, SLICE_HASH_XOR));
+        ASSERT_EQ(0, get_slice(0x100, 6, 4, SLICE_HASH_XOR));
+
+        /* Both hashes spread a contiguous range evenly */
+        int hash[2] = {SLICE_HASH_MODULO, SLICE_HASH_XOR};
+        foreach (h, 2) {
+            int count[8] = {0};
+            foreach (line, 8192) {
+                count[get_slice(0x12340000ULL + line * 64, 6, 8, hash[h])]++;
+            }
+            foreach (i, 8) {
+                ASSERT_EQ(1024, count[i]);
+            }
+        }
+
+        /* A 'modulo' slice indexes its sets above the slice select bits */
+        CacheLines<256, 4, 64, 1> lines(1, 1);
+        lines.set_slice_stride(4);
+
+        foreach (slice, 4) {
+            int sets[256] = {0};
+            foreach (line, 4096) {
+                W64 addr = 0x12340000ULL + line * 64;
+                if (get_slice(addr, 6, 4, SLICE_HASH_MODULO) == slice)
+                    sets[lines.setOf(addr)]++;
+            }
+            foreach (i, 256) {
+                ASSERT_EQ(4, sets[i]);
+            }
+        }
+    }
+
+    TEST(LLCSlice, WriteBackSliceSets)
+    {
+        using namespace Memory;
+
+        BaseMachine* machine = (BaseMachine*)(PTLsimMachine::getmachine("base"));
+        MemoryHierarchy* mem = new MemoryHierarchy(*machine);
+
+        machine->add_option("L2_wb_slice_test", "slice_hash", "modulo");
+        machine->add_option("L2_wb_slice_test", "slices", 4);
+
+        /* Slice 1 of 4 holds as many of its own lines as it has ways */
+        CacheController* cont = new CacheController(1, "L2_wb_slice_test",
+                mem, L2_CACHE);
+        CacheLinesBase* lines = cont->get_cache_lines();
+        int capacity = lines->get_set_count() * lines->get_way_count();
+        ASSERT_TRUE(cont->is_slice());
+
+        MemoryRequest* req = mem->get_free_request(0);
+        dynarray<W64> addrs;
+        W64 oldTag;
+
+        for (W64 addr = 0x12340000ULL; addrs.size() < capacity;
+                addr += lines->get_line_size()) {
+            if (!cont->owns_address(addr))
+                continue;
+
+            req->init(0, 0, addr, 0, 0, false, 0x400000, 0, MEMORY_OP_READ);
+            lines->insert(req, oldTag);
+            addrs.push(addr);
+        }
+
+        foreach (i, addrs.size()) {
+            req->init(0, 0, addrs[i], 0, 0, false, 0x400000, 0,
+                    MEMORY_OP_READ);
+            ASSERT_TRUE(lines->probe(req) != NULL);
+        }
+
+        delete cont;
+        delete mem;
+
+        IntOptions* int_opts;
+        if (machine->int_options.remove("L2_wb_slice_test", int_opts))
+            delete int_opts;
+
+        StrOptions* str_opts;
+        if (machine->str_options.remove("L2_wb_slice_test", str_opts)) {
+            stringbuf* val;
+            if (str_opts->remove("slice_hash", val))
+                delete val;
+            delete str_opts;
+        }
+    }
+
+    /* Maps a host page at RTM_TEST_VIRT for loads and stores of the contexts */
+    #define RTM_TEST_VIRT 0x900000
+
+    class RTMTest : public ::testing::Test {
+        public:
+            byte* host;
+            W64* data;
+
+            void map(Context& ctx, byte* page) {
+                int mmu_idx = (ctx.kernel_mode) ? 0 : MMU_USER_IDX;
+                int index = (RTM_TEST_VIRT >> TARGET_PAGE_BITS) &
+                    (CPU_TLB_SIZE - 1);
+                CPUTLBEntry& entry = ctx.tlb_table[mmu_idx][index];
+
+                entry.addr_read = (page) ? RTM_TEST_VIRT : (target_ulong)-1;
+                entry.addr_write = entry.addr_read;
+                entry.addend = (Waddr)page - RTM_TEST_VIRT;
+            }
+
+            void SetUp() {
+                host = (byte*)malloc(2 << TARGET_PAGE_BITS);
+                data = (W64*)ceil((Waddr)host, TARGET_PAGE_SIZE);
+                *data = 0x1111;
+
+                foreach (i, contextcount) {
+                    map(contextof(i), (byte*)data);
+                }
+            }
+
+            void TearDown() {
+                foreach (i, contextcount) {
+                    map(contextof(i), NULL);
+                }
+                free(host);
+            }
+    };
+
+    TEST_F(RTMTest, CommitKeepsStores)
+    {
+        Context& ctx = contextof(0);
+
+        rtm_begin(ctx, 0x1000);
+        ASSERT_EQ(1, ctx.rtm_depth);
+        ASSERT_EQ(1, rtm_active_transactions);
+
+        ctx.storemask_virt(RTM_TEST_VIRT, 0x2222, 0xff, 3);
+        ASSERT_EQ(0x2222, *data);
+
+        ASSERT_TRUE(rtm_commit(ctx));
+        ASSERT_EQ(0, ctx.rtm_depth);
+        ASSERT_EQ(0, rtm_active_transactions);
+        ASSERT_EQ(0x2222, *data);
+    }
+
+    TEST_F(RTMTest, AbortRollback)
+    {
+        Context& ctx = contextof(0);
+        W64 rbx = ctx.regs[REG_rbx];
+        W64 eip = ctx.eip;
+
+        rtm_begin(ctx, 0x1000);
+        ctx.storemask_virt(RTM_TEST_VIRT, 0x2222, 0xff, 3);
+        ctx.regs[REG_rbx] = rbx + 1;
+
+        // Memory is restored at the abort, later stores are dropped
+        rtm_explicit_abort(ctx, 0x5a);
+        ASSERT_TRUE(ctx.rtm_doomed);
+        ASSERT_EQ(0, rtm_active_transactions);
+        ASSERT_EQ(0x1111, *data);
+
+        ctx.storemask_virt(RTM_TEST_VIRT, 0x3333, 0xff, 3);
+        ASSERT_EQ(0x1111, *data);
+
+        rtm_rollback(ctx);
+        ASSERT_FALSE(ctx.rtm_doomed);
+        ASSERT_EQ(0, ctx.rtm_depth);
+        ASSERT_EQ(rbx, ctx.regs[REG_rbx]);
+        ASSERT_EQ(RTM_STATUS_EXPLICIT | (0x5a << 24), ctx.regs[REG_rax]);
+        ASSERT_EQ(0x1000, ctx.eip);
+
+        ctx.eip = eip;
+    }
+
+    TEST_F(RTMTest, ConflictAtLoadCommit)
+    {
+        if (contextcount < 2)
+            return;
+
+        Context& ctx = contextof(0);
+        Context& other = contextof(1);
+        W64 eip = ctx.eip;
+
+        rtm_begin(ctx, 0x1000);
+        ctx.storemask_virt(RTM_TEST_VIRT, 0x2222, 0xff, 3);
+
+        // Executing the load doesn't touch the transaction, committing does
+        ASSERT_EQ(0x2222, other.loadvirt(RTM_TEST_VIRT, 3));
+        ASSERT_FALSE(ctx.rtm_doomed);
+
+        ASSERT_FALSE(rtm_load(other, RTM_TEST_VIRT, 8));
+        ASSERT_TRUE(ctx.rtm_doomed);
+        ASSERT_EQ(0x1111, other.loadvirt(RTM_TEST_VIRT, 3));
+        ASSERT_TRUE(rtm_load(other, RTM_TEST_VIRT, 8));
+
+        rtm_rollback(ctx);
+        ASSERT_EQ(RTM_STATUS_CONFLICT | RTM_STATUS_RETRY, ctx.regs[REG_rax]);
+
+        // A store of another CPU aborts a transaction that read the line
+        rtm_begin(ctx, 0x1000);
+        ASSERT_TRUE(rtm_load(ctx, RTM_TEST_VIRT, 8));
+        other.storemask_virt(RTM_TEST_VIRT, 0x4444, 0xff, 3);
+        ASSERT_TRUE(ctx.rtm_doomed);
+        ASSERT_EQ(0x4444, *data);
+
+        rtm_rollback(ctx);
+        ASSERT_EQ(0, rtm_active_transactions);
+
+        ctx.eip = eip;
+    }
+
+    TEST_F(RTMTest, StoreBeforeLoadCommit)
+    {
+        if (contextcount < 2)
+            return;
+
+        Context& ctx = contextof(0);
+        Context& other = contextof(1);
+        W64 eip = ctx.eip;
+
+        // The load has executed but not committed when the other CPU writes
+        rtm_begin(ctx, 0x1000);
+        ASSERT_EQ(0x1111, ctx.loadvirt(RTM_TEST_VIRT, 3));
+        ASSERT_FALSE(ctx.rtm_doomed);
+
+        other.storemask_virt(RTM_TEST_VIRT, 0x5555, 0xff, 3);
+        ASSERT_TRUE(ctx.rtm_doomed);
+        ASSERT_EQ(0x5555, *data);
+
+        rtm_rollback(ctx);
+        ASSERT_EQ(RTM_STATUS_CONFLICT | RTM_STATUS_RETRY, ctx.regs[REG_rax]);
+        ASSERT_EQ(0, rtm_active_transactions);
+
+        ctx.eip = eip;
+    }
 };
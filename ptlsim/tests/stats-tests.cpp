@@ -318,4 +318,127 @@ namespace {
 
 		ASSERT_EQ(ct1_val, 10);
 	}
+
+    TEST(Stats, BlockAddMatchesTree) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+
+        TestStat st;
+        Stats *fast = builder.get_new_stats();
+        Stats *tree = builder.get_new_stats();
+
+        user_stats->reset();
+        kernel_stats->reset();
+
+        foreach (i, 10) {
+            st.arr1(user_stats)[i] = i;
+            st.arr1(kernel_stats)[i] = 100 * i;
+        }
+        st.ct1(user_stats) = 5;
+        st.ct1(kernel_stats) = 7;
+        st.ct3(kernel_stats) = 1;
+        st.div(user_stats) = 0.5;
+        st.div(kernel_stats) = 0.25;
+
+        /* Flat loops over the counter runs ... */
+        *fast = *user_stats;
+        *fast += *kernel_stats;
+
+        /* ... against the per-object walk of the Statable tree */
+        *tree = *user_stats;
+        st.add_stats(*tree, *kernel_stats);
+
+        foreach (i, 10) {
+            ASSERT_EQ(st.arr1(tree)[i], st.arr1(fast)[i]);
+        }
+        ASSERT_EQ(12, st.ct1(fast));
+        ASSERT_EQ(1, st.ct3(fast));
+        ASSERT_EQ(st.div(tree), st.div(fast));
+
+        builder.sub_stats(*fast, *kernel_stats);
+        ASSERT_EQ(5, st.ct1(fast));
+        ASSERT_EQ(9, st.arr1(fast)[9]);
+
+        /* Only the part of the block holding registered stats is used */
+        ASSERT_TRUE(builder.get_used_size() > 0);
+        ASSERT_TRUE(builder.get_used_size() < STATS_SIZE);
+
+        builder.destroy_stats(fast);
+        builder.destroy_stats(tree);
+    }
+
+    TEST(Stats, WriterMatchesEmitter) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+
+        TestStat st;
+        user_stats->reset();
+
+        st.arr1(user_stats)[3] = 30;
+        st.ct1(user_stats) = 100;
+        st.ct2(user_stats) = 3;
+        st.st1.set(user_stats, "String: Test");
+        st.st2.set(user_stats, "a, b,c");
+        st.st2.set_split(",");
+
+        YAML::Emitter yaml;
+        builder.dump(user_stats, yaml);
+
+        ostringstream os;
+        {
+            StatsWriter out(os);
+            builder.dump(user_stats, out);
+        }
+
+        ASSERT_STREQ((std::string(yaml.c_str()) + "\n").c_str(),
+                os.str().c_str());
+
+        reset_stream(os);
+        {
+            StatsWriter out(os, StatsWriter::FORMAT_JSON);
+            builder.dump(user_stats, out);
+        }
+
+        ASSERT_STREQ("{\"test\": {\"arr1\": [0, 0, 0, 30, 0, 0, 0, 0, 0, 0], "
+                "\"ct1\": 100, \"ct2\": 3, \"ct3\": 0, "
+                "\"st1\": \"String: Test\", \"st2\": [\"a\", \" b\", \"c\"], "
+                "\"sum\": 103, \"div\": 33.3333, "
+                "\"time_arr\": [0, 0, 0]}}\n", os.str().c_str());
+
+        /* Raw blocks start on page boundaries after the header */
+        reset_stream(os);
+        Stats *blocks[] = {user_stats};
+        const char *names[] = {"user"};
+        builder.dump_raw(os, blocks, names, 1);
+
+        std::string raw = os.str();
+        RawStatsHeader *header = (RawStatsHeader*)raw.data();
+        ASSERT_EQ(0, memcmp(header->magic, RAW_STATS_MAGIC, 8));
+        ASSERT_EQ(1, header->block_count);
+        ASSERT_EQ(builder.get_used_size(), header->block_size);
+        ASSERT_EQ(0, header->block_offset[0] % RAW_STATS_ALIGN);
+        ASSERT_EQ(0, memcmp(raw.data() + header->block_offset[0],
+                    (char*)user_stats->base(), header->block_size));
+
+        /* Schema lists name, type, offset and element count */
+        std::string schema(raw.data() + header->schema_offset,
+                header->schema_size);
+        stringbuf line;
+        line << "test.arr1 w64 " <<
+            ((W64)&st.arr1(user_stats)[0] - user_stats->base()) << " 10\n";
+        ASSERT_NE(std::string::npos, schema.find(line.buf));
+        ASSERT_NE(std::string::npos, schema.find("test.div double "));
+        ASSERT_NE(std::string::npos, schema.find("test.st1 string "));
+
+        /* Equations are stored even if no other dump computed them */
+        st.ct1(user_stats) = 200;
+        reset_stream(os);
+        builder.dump_raw(os, blocks, names, 1);
+
+        raw = os.str();
+        header = (RawStatsHeader*)raw.data();
+        W64 sum_offset = (W64)&st.sum(user_stats) - user_stats->base();
+        ASSERT_EQ(203, *(W64*)(raw.data() + header->block_offset[0] +
+                    sum_offset));
+    }
 };
@@ -0,0 +1,116 @@
+
+/*
+ * assoc_bench.cpp : Microbenchmark for the associative tag arrays in logic.h
+ *
+ * Times match() and matchany() of issue queue sized 8 and 16 bit tag arrays
+ * and match() of TLB sized one-hot tag arrays. Build it once for the SSE
+ * path and once for the host's widest path to compare them:
+ *
+ *    $ FLAGS="-std=gnu++11 -O3 -DNEED_CPU_H -I../lib -I../sim -I../x86 \
+ *          -I../stats -I../cache -I../core -I../../qemu -I../../qemu/fpu \
+ *          -I../../qemu/target-i386 -I../../qemu/x86_64-softmmu"
+ *    $ g++ $FLAGS -mno-avx2 assoc_bench.cpp ../build/lib/superstl.o \
+ *          -o assoc_bench_sse
+ *    $ g++ $FLAGS -march=native assoc_bench.cpp ../build/lib/superstl.o \
+ *          -o assoc_bench_native
+ */
+
+#include <globals.h>
+#include <superstl.h>
+#include <logic.h>
+
+#include <sys/time.h>
+
+ofstream ptl_logfile;
+
+static const int ITERATIONS = 1 << 22;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* Keep the results alive so the searches are not optimized away */
+static volatile W64 sink;
+
+template <typename T>
+static void bench_issueq(const char *name, int size, int range)
+{
+    T *tags = new T();
+    typedef typename T::base_t base_t;
+
+    foreach (i, size) tags->insertslot(i, random() % range);
+
+    base_t targets[256];
+    foreach (i, 256) targets[i] = random() % range;
+
+    double start = now();
+    W64 acc = 0;
+    foreach (i, ITERATIONS) {
+        acc += tags->match(targets[i & 255]).integer();
+    }
+    double match_ns = (now() - start) * 1e9 / ITERATIONS;
+
+    start = now();
+    foreach (i, ITERATIONS) {
+        acc += tags->matchany(targets[i & 255]).integer();
+    }
+    double matchany_ns = (now() - start) * 1e9 / ITERATIONS;
+
+    sink = acc;
+    printf("%-22s %4d entries: match %6.2f ns  matchany %6.2f ns\n", name,
+            size, match_ns, matchany_ns);
+    delete tags;
+}
+
+template <int size>
+static void bench_tlb()
+{
+    FullyAssociativeTagsNbitOneHot<size, 40> *tags =
+        new FullyAssociativeTagsNbitOneHot<size, 40>();
+
+    foreach (i, size) tags->update(i, ((W64)random() << 8) ^ i);
+
+    /* Mix of hits spread over the array and misses */
+    W64 targets[256];
+    foreach (i, 256) {
+        targets[i] = (i & 3) ? tags->tagsmirror[random() % size] :
+            (W64)random() << 8 | 0xff;
+    }
+
+    double start = now();
+    W64 acc = 0;
+    foreach (i, ITERATIONS) {
+        acc += tags->match(targets[i & 255]);
+    }
+    double match_ns = (now() - start) * 1e9 / ITERATIONS;
+
+    sink = acc;
+    printf("%-22s %4d entries: match %6.2f ns\n", "OneHot 40bit (TLB)",
+            size, match_ns);
+    delete tags;
+}
+
+int main(int argc, char **argv)
+{
+#if defined(__AVX512BW__)
+    printf("Wide path: AVX-512BW\n");
+#elif defined(__AVX2__)
+    printf("Wide path: AVX2\n");
+#else
+    printf("Wide path: none (SSE)\n");
+#endif
+
+    srandom(1);
+
+    bench_issueq<FullyAssociativeTags8bit<64, 64> >("8bit (issue queue)", 64, 256);
+    bench_issueq<FullyAssociativeTags8bit<128, 128> >("8bit (issue queue)", 128, 256);
+    bench_issueq<FullyAssociativeTags16bit<64, 64> >("16bit (BIG_ROB queue)", 64, 65536);
+    bench_issueq<FullyAssociativeTags16bit<128, 128> >("16bit (BIG_ROB queue)", 128, 65536);
+    bench_tlb<32>();
+    bench_tlb<64>();
+
+    return 0;
+}
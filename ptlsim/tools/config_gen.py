@@ -112,6 +112,10 @@ machine_controller_create = '''
         ControllerBuilder::add_new_cont(machine, i, "%s", "%s", %s);
 '''
 
+machine_shadow_cache_create = '''
+        ControllerBuilder::add_shadow_cache(machine, i, "%s", "%s", %s);
+'''
+
 machine_connection_def = '''
         ConnectionDef* connDef = machine.get_new_connection_def("%s",
                 "%s", i);
@@ -255,7 +259,7 @@ handle_cpuid_cache_switch = '''
                             *ebx = ((%(L2_LINE_SIZE)d & 0xfff) |
                                     ((%(L2_LINE_SIZE)d << 12) & 0x3ff000) |
                                     ((%(L2_WAY_COUNT)d << 22) & 0xffc00000) );
-                            *ecx = %(L2_SET_COUNT)d;
+                            *ecx = %(L2_SET_COUNT)s;
                             *edx = 0x1;
                             break;
                         }
@@ -289,7 +293,7 @@ handle_cpuid_l3_cache_info = '''
                             *ebx = ((%(L3_LINE_SIZE)d & 0xfff) |
                                     ((%(L3_LINE_SIZE)d << 12) & 0x3ff000) |
                                     ((%(L3_WAY_COUNT)d << 22) & 0xffc00000) );
-                            *ecx = %(L3_SET_COUNT)d;
+                            *ecx = %(L3_SET_COUNT)s;
                             *edx = 0x1;
                             break;
                         }
@@ -393,6 +397,14 @@ def write_option_logic(st, of, name, opt, val):
         val = '%s' % str(val).lower()
     of.write(st % (name, opt, val))
 
+def get_insts_expr(insts, num_cores="machine.get_num_cores()"):
+    if insts == "$NUMCORES":
+        return num_cores
+    return "%d" % int(insts)
+
+def is_sliced(cache):
+    return cache.has_key("option") and cache["option"].has_key("slice_hash")
+
 def get_cache_cfg(config, name):
     for cache in config["caches"]:
         if cache["name_prefix"] == name:
@@ -440,6 +452,11 @@ def write_cont_logic(config, m_conf, of, n1, n2):
                 write_option_logic(machine_option_add_i, of, name_pfx,
                         key, val)
 
+            # All instances of a sliced cache need the slice count
+            if cache["option"].has_key("slice_hash"):
+                of.write(machine_option_add_i % (name_pfx, "slices",
+                    get_insts_expr(cache["insts"])))
+
         of.write(machine_controller_create %
                 (name_pfx, base, c_type))
         of.write(machine_loop_end)
@@ -450,6 +467,31 @@ def write_cache_cont_logic(config, m_conf, of):
 def write_mem_cont_logic(config, m_conf, of):
     write_cont_logic(config, m_conf, of, "memory", "memory")
 
+def write_shadow_cache_logic(config, m_conf, of):
+    if not m_conf.has_key("shadow_caches"):
+        return
+
+    for cache in m_conf["shadow_caches"]:
+        assert config["cache"].has_key(cache["type"]), \
+                "Can't find cache configuration %s" % cache["type"]
+        name_pfx = cache["name_prefix"]
+        assert cache.has_key("shadow_of"), \
+                "Shadow cache %s needs 'shadow_of'" % name_pfx
+        shadow_of = cache["shadow_of"]
+        assert get_cache_cfg(m_conf, shadow_of), \
+                "Can't find cache %s followed by shadow cache %s" % (
+                        shadow_of, name_pfx)
+
+        if cache["insts"] == "$NUMCORES":
+            of.write(machine_for_each_core_loop_i)
+        elif type(cache["insts"]) == int or cache["insts"].isdigit():
+            of.write(machine_for_each_num_loop_i %
+                    int(cache["insts"]))
+
+        of.write(machine_shadow_cache_create % (name_pfx, shadow_of,
+            cache["type"].upper()))
+        of.write(machine_loop_end)
+
 def get_cache_line_size(config, m_conf, cache_name):
     for cache in m_conf["caches"]:
         if cache["name_prefix"] in cache_name:
@@ -483,7 +525,9 @@ def write_interconn_logic(config, m_conf, of):
                     if 'core' not in cont:
                         c_cfg = get_cache_cfg(m_conf, cont.rstrip('*'))
                         assert c_cfg, "Can't find cache for %s" % cont
-                        assert c_cfg["insts"] == "$NUMCORES"
+                        assert c_cfg["insts"] == "$NUMCORES" or \
+                                is_sliced(c_cfg), \
+                                "Only per core or sliced caches can use *"
 
             if all_cores:
                 assert all_conts == False, \
@@ -540,7 +584,12 @@ def write_interconn_logic(config, m_conf, of):
                     conn_type = 'INTERCONN_TYPE_%s' % conn_type
                     if cont[-1] == '*':
                         cont = cont.rstrip('*')
-                        of.write(machine_for_each_core_loop_j)
+                        c_cfg = get_cache_cfg(m_conf, cont)
+                        if c_cfg and c_cfg["insts"] != "$NUMCORES":
+                            of.write(machine_for_each_num_loop_j %
+                                    int(c_cfg["insts"]))
+                        else:
+                            of.write(machine_for_each_core_loop_j)
                         of.write(machine_add_connection_j % (cont,
                             cont, cont, cont, conn_type))
                         of.write(machine_loop_end_j)
@@ -569,7 +618,7 @@ def write_interconn_logic(config, m_conf, of):
 
             count += 1
 
-def fill_cache_info(cfg, cache_info, pfx):
+def fill_cache_info(cfg, cache_info, pfx, cache=None):
     size = get_cache_size(cfg["params"]["SIZE"])
     assoc = cfg["params"]["ASSOC"]
     l_size = cfg["params"]["LINE_SIZE"]
@@ -579,6 +628,11 @@ def fill_cache_info(cfg, cache_info, pfx):
     cache_info["%s_WAY_COUNT" % pfx] = assoc
     cache_info["%s_SET_COUNT" % pfx] = sets
 
+    # Slices together are one cache of all their sets
+    if cache and is_sliced(cache):
+        cache_info["%s_SET_COUNT" % pfx] = "%d * %s" % (sets,
+                get_insts_expr(cache["insts"], "NUMBER_OF_CORES"))
+
 def gen_handle_cpuid_fn(config, m_conf, m_name, of):
 
     # Find all levels of cahces from machine configuration
@@ -595,15 +649,17 @@ def gen_handle_cpuid_fn(config, m_conf, m_name, of):
             elif "I" in cache["name_prefix"].upper():
                 fill_cache_info(cfg, cache_info, "L1I")
         elif "2" in cache["name_prefix"]:
-            fill_cache_info(cfg, cache_info, "L2")
-            if cache["insts"] == "$NUMCORES":
+            fill_cache_info(cfg, cache_info, "L2", cache)
+            if is_sliced(cache):
+                cache_info["CORES_PER_L2"] = "NUMBER_OF_CORES"
+            elif cache["insts"] == "$NUMCORES":
                 cache_info["CORES_PER_L2"] = "1"
             else:
                 num_l2_inst = int(cache["insts"])
                 cache_info["CORES_PER_L2"] = "(NUMBER_OF_CORES)/%d" % (
                         num_l2_inst)
         elif "3" in cache["name_prefix"]:
-            fill_cache_info(cfg, cache_info, "L3")
+            fill_cache_info(cfg, cache_info, "L3", cache)
             cache_info["l3_cache_info"] = handle_cpuid_l3_cache_info
 
     # Now write the function
@@ -642,6 +698,9 @@ def generate_machine(config, options):
         # Write memory controllers
         write_mem_cont_logic(config, m_conf, of)
 
+        # Write shadow caches, they follow caches created above
+        write_shadow_cache_logic(config, m_conf, of)
+
         # Write interconnect and connection logic
         write_interconn_logic(config, m_conf, of)
 
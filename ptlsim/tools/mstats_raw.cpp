@@ -0,0 +1,522 @@
+/*
+ * mstats_raw.cpp : Query and compare raw Stats files
+ *
+ * Reads the files written with the simulator's -rawstats option (see
+ * stats/rawStats.h) by mapping them into memory, so hundreds of result files
+ * can be summarized without parsing their YAML stats. Usage:
+ *
+ *    mstats_raw [-b block] [-l] [-a] [-d] -e expr [-e expr ...] file...
+ *
+ *    -b block :  Stats block to read: kernel, user or global (default)
+ *    -e expr  :  Expression to print for each file. Operands are counter
+ *                names as in the text stats format, array elements as
+ *                name[N] and numbers, combined with + - * / and ( ).
+ *                A name naming a whole array, or containing * or ?
+ *                wildcards, is the sum of all matching values, e.g.
+ *                'ooo_*.thread0.commit.insns / sim_cycle'. Put spaces
+ *                around '*' when it is used for multiplication.
+ *    -l       :  List the counters of the first file
+ *    -a       :  Also print sum, mean, min and max of each expression
+ *    -d       :  Print each value as difference from the first file
+ *
+ * To compile:
+ *    $ g++ -O2 -I../stats mstats_raw.cpp -o mstats_raw
+ */
+
+#include <rawStats.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+using namespace std;
+
+struct Counter {
+    string name;
+    string type;
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct Schema {
+    const char *text;
+    uint64_t size;
+    vector<Counter> counters;
+    map<string, int> index;
+};
+
+struct RawFile {
+    const char *name;
+    const char *data;
+    size_t size;
+    const RawStatsHeader *header;
+    Schema *schema;
+};
+
+/* A resolved operand: sum of 'count' values of 'type' at 'offset' */
+struct Operand {
+    uint64_t offset;
+    uint64_t count;
+    bool is_double;
+};
+
+struct Node {
+    char op;                    // 'n'umber, 'v'alue, or + - * /
+    double number;
+    string name;
+    vector<Operand> operands;   // resolved per schema
+    Node *left, *right;
+
+    Node(char op) : op(op), number(0), left(NULL), right(NULL) {}
+};
+
+static void fail(const string& msg)
+{
+    cerr << "mstats_raw: " << msg << endl;
+    exit(1);
+}
+
+/* Expression parser */
+
+struct Parser {
+    const char *p;
+    const char *expr;
+
+    Parser(const char *expr) : p(expr), expr(expr) {}
+
+    void skip() { while (isspace(*p)) p++; }
+
+    static bool is_name_char(char c)
+    {
+        return isalnum(c) || c == '_' || c == '.' || c == '*' || c == '?' ||
+            c == '[' || c == ']';
+    }
+
+    Node* factor()
+    {
+        skip();
+
+        if (*p == '(') {
+            p++;
+            Node *n = sum();
+            skip();
+            if (*p != ')')
+                fail(string("missing ')' in ") + expr);
+            p++;
+            return n;
+        }
+
+        if (*p == '-') {
+            p++;
+            Node *n = new Node('-');
+            n->left = new Node('n');
+            n->right = factor();
+            return n;
+        }
+
+        if (isdigit(*p)) {
+            char *end;
+            Node *n = new Node('n');
+            n->number = strtod(p, &end);
+            p = end;
+            return n;
+        }
+
+        const char *start = p;
+        while (is_name_char(*p)) p++;
+        if (p == start)
+            fail(string("unexpected '") + *p + "' in " + expr);
+
+        Node *n = new Node('v');
+        n->name = string(start, p - start);
+        return n;
+    }
+
+    Node* product()
+    {
+        Node *n = factor();
+        for (skip(); *p == '*' || *p == '/'; skip()) {
+            Node *op = new Node(*p++);
+            op->left = n;
+            op->right = factor();
+            n = op;
+        }
+        return n;
+    }
+
+    Node* sum()
+    {
+        Node *n = product();
+        for (skip(); *p == '+' || *p == '-'; skip()) {
+            Node *op = new Node(*p++);
+            op->left = n;
+            op->right = product();
+            n = op;
+        }
+        return n;
+    }
+
+    Node* parse()
+    {
+        Node *n = sum();
+        skip();
+        if (*p)
+            fail(string("unexpected '") + *p + "' in " + expr);
+        return n;
+    }
+};
+
+static void add_operand(Node *n, const Counter& c, uint64_t first,
+        uint64_t count)
+{
+    if (c.type != "w64" && c.type != "double")
+        fail(c.name + " is a " + c.type + ", not a number");
+
+    Operand op;
+    op.offset = c.offset + first * 8;
+    op.count = count;
+    op.is_double = (c.type == "double");
+    n->operands.push_back(op);
+}
+
+static void resolve(Node *n, Schema *schema)
+{
+    if (!n) return;
+
+    resolve(n->left, schema);
+    resolve(n->right, schema);
+
+    if (n->op != 'v')
+        return;
+
+    n->operands.clear();
+
+    if (strpbrk(n->name.c_str(), "*?")) {
+        for (size_t i = 0; i < schema->counters.size(); i++) {
+            const Counter& c = schema->counters[i];
+            if (fnmatch(n->name.c_str(), c.name.c_str(), 0) == 0 &&
+                    (c.type == "w64" || c.type == "double"))
+                add_operand(n, c, 0, c.count);
+        }
+        if (n->operands.empty())
+            fail("no counter matches " + n->name);
+        return;
+    }
+
+    string name = n->name;
+    uint64_t elem = 0;
+    bool has_elem = false;
+    size_t bracket = name.find('[');
+
+    if (bracket != string::npos) {
+        elem = strtoull(name.c_str() + bracket + 1, NULL, 10);
+        name = name.substr(0, bracket);
+        has_elem = true;
+    }
+
+    map<string, int>::iterator it = schema->index.find(name);
+    if (it == schema->index.end())
+        fail("unknown counter " + n->name);
+
+    const Counter& c = schema->counters[it->second];
+    if (has_elem) {
+        if (elem >= c.count)
+            fail(n->name + " is out of range");
+        add_operand(n, c, elem, 1);
+    } else {
+        add_operand(n, c, 0, c.count);
+    }
+}
+
+/* Values of the operands must lie inside the file's stats blocks */
+static void check_operands(const Node *n, const RawFile& file)
+{
+    if (!n) return;
+
+    check_operands(n->left, file);
+    check_operands(n->right, file);
+
+    uint64_t block_size = file.header->block_size;
+
+    for (size_t i = 0; i < n->operands.size(); i++) {
+        const Operand& op = n->operands[i];
+        if (op.offset > block_size ||
+                op.count > (block_size - op.offset) / 8)
+            fail(string(file.name) + ": " + n->name +
+                    " is outside of the stats block");
+    }
+}
+
+static double eval(const Node *n, const char *block)
+{
+    switch (n->op) {
+        case 'n':
+            return n->number;
+        case 'v': {
+            double v = 0;
+            for (size_t i = 0; i < n->operands.size(); i++) {
+                const Operand& op = n->operands[i];
+                const char *p = block + op.offset;
+                for (uint64_t j = 0; j < op.count; j++) {
+                    if (op.is_double)
+                        v += ((const double*)p)[j];
+                    else
+                        v += ((const uint64_t*)p)[j];
+                }
+            }
+            return v;
+        }
+        case '+': return eval(n->left, block) + eval(n->right, block);
+        case '-': return eval(n->left, block) - eval(n->right, block);
+        case '*': return eval(n->left, block) * eval(n->right, block);
+        case '/': {
+            double d = eval(n->right, block);
+            return d ? eval(n->left, block) / d : 0;
+        }
+    }
+
+    return 0;
+}
+
+/* Raw file loading */
+
+static vector<Schema*> schemas;
+
+static Schema* load_schema(const char *text, uint64_t size)
+{
+    /* Result files of one sweep share their schema, parse it only once */
+    for (size_t i = 0; i < schemas.size(); i++) {
+        if (schemas[i]->size == size && !memcmp(schemas[i]->text, text, size))
+            return schemas[i];
+    }
+
+    Schema *schema = new Schema();
+    schema->text = text;
+    schema->size = size;
+
+    const char *p = text;
+    const char *end = text + size;
+
+    while (p < end) {
+        const char *eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+
+        char name[1024], type[16];
+        unsigned long long offset, count;
+        string line(p, eol - p);
+
+        if (sscanf(line.c_str(), "%1023s %15s %llu %llu", name, type,
+                    &offset, &count) == 4) {
+            Counter c;
+            c.name = name;
+            c.type = type;
+            c.offset = offset;
+            c.count = count;
+            schema->index[c.name] = schema->counters.size();
+            schema->counters.push_back(c);
+        }
+
+        p = eol + 1;
+    }
+
+    schemas.push_back(schema);
+    return schema;
+}
+
+static bool load_file(const char *name, RawFile& file)
+{
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        perror(name);
+        return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+
+    file.name = name;
+    file.size = st.st_size;
+    file.data = (const char*)mmap(NULL, file.size, PROT_READ, MAP_SHARED,
+            fd, 0);
+    close(fd);
+
+    if (file.data == MAP_FAILED || file.size < sizeof(RawStatsHeader)) {
+        cerr << name << ": not a raw stats file" << endl;
+        return false;
+    }
+
+    file.header = (const RawStatsHeader*)file.data;
+    if (memcmp(file.header->magic, RAW_STATS_MAGIC, 8) ||
+            file.header->version != RAW_STATS_VERSION) {
+        cerr << name << ": not a raw stats file" << endl;
+        return false;
+    }
+
+    const RawStatsHeader *h = file.header;
+    if (h->schema_offset > file.size ||
+            h->schema_size > file.size - h->schema_offset ||
+            h->block_count > RAW_STATS_MAX_BLOCKS)
+        fail(string(name) + ": truncated or corrupt raw stats file");
+
+    file.schema = load_schema(file.data + h->schema_offset, h->schema_size);
+    return true;
+}
+
+static const char* find_block(const RawFile& file, const char *block_name)
+{
+    const RawStatsHeader *h = file.header;
+
+    for (uint32_t i = 0; i < h->block_count; i++) {
+        if (!strncmp(h->block_name[i], block_name, sizeof(h->block_name[i]))) {
+            if (h->block_offset[i] > file.size ||
+                    h->block_size > file.size - h->block_offset[i])
+                break;
+            return file.data + h->block_offset[i];
+        }
+    }
+
+    cerr << file.name << ": no '" << block_name << "' stats block" << endl;
+    return NULL;
+}
+
+static void print_value(double v)
+{
+    if (v == (double)(long long)v)
+        printf("\t%lld", (long long)v);
+    else
+        printf("\t%.4f", v);
+}
+
+static void usage()
+{
+    cerr << "Usage: mstats_raw [-b block] [-l] [-a] [-d] -e expr "
+        "[-e expr ...] file..." << endl;
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *block_name = "global";
+    vector<const char*> exprs;
+    bool list = false;
+    bool aggregate = false;
+    bool diff = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "b:e:lad")) != -1) {
+        switch (c) {
+            case 'b': block_name = optarg; break;
+            case 'e': exprs.push_back(optarg); break;
+            case 'l': list = true; break;
+            case 'a': aggregate = true; break;
+            case 'd': diff = true; break;
+            default: usage();
+        }
+    }
+
+    if (optind >= argc || (exprs.empty() && !list))
+        usage();
+
+    vector<RawFile> files;
+    for (int i = optind; i < argc; i++) {
+        RawFile file;
+        if (load_file(argv[i], file))
+            files.push_back(file);
+    }
+
+    if (files.empty())
+        return 1;
+
+    if (list) {
+        const Schema *schema = files[0].schema;
+        for (size_t i = 0; i < schema->counters.size(); i++) {
+            const Counter& c = schema->counters[i];
+            cout << c.name << " " << c.type;
+            if (c.count > 1) cout << "[" << c.count << "]";
+            cout << endl;
+        }
+        if (exprs.empty())
+            return 0;
+    }
+
+    /* Resolve names against the first schema to report errors early */
+    vector<Node*> nodes;
+    for (size_t i = 0; i < exprs.size(); i++) {
+        nodes.push_back(Parser(exprs[i]).parse());
+        resolve(nodes[i], files[0].schema);
+    }
+
+    printf("file");
+    for (size_t i = 0; i < exprs.size(); i++)
+        printf("\t%s", exprs[i]);
+    printf("\n");
+
+    vector<vector<double> > values(files.size());
+    Schema *resolved = files[0].schema;
+
+    for (size_t f = 0; f < files.size(); f++) {
+        const char *block = find_block(files[f], block_name);
+        if (!block) continue;
+
+        if (files[f].schema != resolved) {
+            for (size_t i = 0; i < nodes.size(); i++)
+                resolve(nodes[i], files[f].schema);
+            resolved = files[f].schema;
+        }
+
+        for (size_t i = 0; i < nodes.size(); i++) {
+            check_operands(nodes[i], files[f]);
+            values[f].push_back(eval(nodes[i], block));
+        }
+
+        printf("%s", files[f].name);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            double v = values[f][i];
+            if (diff && f > 0 && !values[0].empty()) {
+                double base = values[0][i];
+                print_value(v - base);
+                if (base) printf(" (%+.2f%%)", (v - base) * 100.0 / base);
+            } else {
+                print_value(v);
+            }
+        }
+        printf("\n");
+    }
+
+    if (aggregate) {
+        const char *names[] = {"sum", "mean", "min", "max"};
+
+        for (int a = 0; a < 4; a++) {
+            printf("%s", names[a]);
+            for (size_t i = 0; i < nodes.size(); i++) {
+                double sum = 0, min = 0, max = 0;
+                int n = 0;
+                for (size_t f = 0; f < files.size(); f++) {
+                    if (values[f].empty()) continue;
+                    double v = values[f][i];
+                    if (!n || v < min) min = v;
+                    if (!n || v > max) max = v;
+                    sum += v;
+                    n++;
+                }
+                double r[] = {sum, n ? sum / n : 0, min, max};
+                print_value(r[a]);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 //
 
 #include <decode.h>
+#include <rtm.h>
 
 // QEMU Helper functions
 extern "C" {
@@ -294,6 +295,140 @@ bool assist_enter(Context& ctx) {
     return true;
 }
 
+// Fast strings
+
+/*
+ * Make sure the 'bytes' at 'addr' are mapped for the access, returns the
+ * faulting address or 0.
+ */
+static Waddr rep_string_probe(Context& ctx, Waddr addr, int bytes, bool store) {
+    Waddr ends[2] = {addr, addr + bytes - 1};
+
+    foreach (i, 2) {
+        if (ctx.has_page_fault(ends[i], store) &&
+                !ctx.try_handle_fault(ends[i], store)) {
+            return ends[i];
+        }
+    }
+
+    return 0;
+}
+
+/* Write an rsi/rdi/rcx value with the instruction's address size */
+static inline void rep_string_update(target_ulong& reg, W64 value, int addrsizeshift) {
+    switch (addrsizeshift) {
+    case 1: reg = (reg & ~0xffffULL) | (value & 0xffff); break;
+    case 2: reg = (W32)value; break;
+    default: reg = value;
+    }
+}
+
+bool assist_rep_string(Context& ctx) {
+    int op = bits(ctx.reg_ar1, 0, 8);
+    int sizeshift = bits(ctx.reg_ar1, 8, 4);
+    int addrsizeshift = bits(ctx.reg_ar1, 12, 4);
+    bool movs = (op == 0xa4 || op == 0xa5);
+    int mmu_idx = (ctx.kernel_mode) ? 0 : MMU_USER_IDX;
+
+    W64 addrmask = (addrsizeshift == 3) ? (W64)-1 : bitmask(8 << addrsizeshift);
+    W64 count = ctx.regs[REG_rcx] & addrmask;
+    Waddr src = ctx.regs[REG_rsi] & addrmask;
+    Waddr dst = ctx.regs[REG_rdi] & addrmask;
+
+    ctx.fast_string_bytes = 0;
+
+    if (!count) {
+        ctx.eip = ctx.reg_nextrip;
+        return true;
+    }
+
+    /*
+     * Move up to the next page boundary of either string so each string is
+     * one host mapping; an element crossing a page is moved on its own.
+     */
+    W64 bytes = min(count << sizeshift,
+            (W64)(TARGET_PAGE_SIZE - lowbits(dst, TARGET_PAGE_BITS)));
+    if (movs) {
+        bytes = min(bytes,
+                (W64)(TARGET_PAGE_SIZE - lowbits(src, TARGET_PAGE_BITS)));
+    }
+
+    W64 n = max(bytes >> sizeshift, 1ULL);
+    bytes = n << sizeshift;
+
+    Waddr faultaddr = (movs) ? rep_string_probe(ctx, src, bytes, false) : 0;
+    bool store_fault = false;
+
+    if (!faultaddr) {
+        faultaddr = rep_string_probe(ctx, dst, bytes, true);
+        store_fault = true;
+    }
+
+    if (faultaddr) {
+        ctx.eip = ctx.reg_selfrip;
+        ctx.handle_page_fault(faultaddr, store_fault);
+        return true;
+    }
+
+    /* Transactions track and undo each element through the functional path */
+    bool fast = !(rtm_active_transactions | ctx.rtm_doomed);
+
+    byte* d = (fast) ? ctx.get_host_ram_ptr(dst, bytes, mmu_idx, true) : NULL;
+    byte* s = (movs && fast) ?
+        ctx.get_host_ram_ptr(src, bytes, mmu_idx, false) : NULL;
+
+    if (d && (s || !movs)) {
+        int elsize = 1 << sizeshift;
+        W64 value = ctx.regs[REG_rax];
+
+        if (!movs) {
+            foreach (i, n) memcpy(d + (i << sizeshift), &value, elsize);
+        } else if (d > s && d < s + bytes) {
+            /* Overlap repeats the source pattern, copy in x86 order */
+            foreach (i, n) memmove(d + (i << sizeshift), s + (i << sizeshift), elsize);
+        } else {
+            memmove(d, s, bytes);
+        }
+
+        /* The chunk is within one page */
+        smc_setdirty_host(d);
+
+        Waddr paddr = 0;
+        ctx.fast_string_src = 0;
+        if (movs && ctx.get_phys_memory_address((Waddr)s, paddr) == 0)
+            ctx.fast_string_src = paddr;
+        if (ctx.get_phys_memory_address((Waddr)d, paddr) == 0) {
+            ctx.fast_string_dst = paddr;
+            ctx.fast_string_bytes = bytes;
+        }
+    } else {
+        /*
+         * MMIO, watchpoint or code pages go through QEMU one element at a
+         * time. Assists run at commit, so the loads join the read set here.
+         */
+        foreach (i, n) {
+            W64 data = ctx.regs[REG_rax];
+
+            if (movs) {
+                Waddr addr = src + (i << sizeshift);
+                if unlikely (rtm_active_transactions)
+                    rtm_load(ctx, addr, 1 << sizeshift);
+                data = ctx.loadvirt(addr, sizeshift);
+            }
+
+            ctx.storemask_virt(dst + (i << sizeshift), data, 0xff, sizeshift);
+        }
+    }
+
+    if (movs) rep_string_update(ctx.regs[REG_rsi], src + bytes, addrsizeshift);
+    rep_string_update(ctx.regs[REG_rdi], dst + bytes, addrsizeshift);
+    rep_string_update(ctx.regs[REG_rcx], count - n, addrsizeshift);
+
+    ctx.eip = (count - n) ? ctx.reg_selfrip : ctx.reg_nextrip;
+
+    return true;
+}
+
 bool assist_ud2a(Context& ctx) {
 	// This instruction should never occur in simulation.
 	// Linux Kernel uses ud2a to trigger Bug in the code or
@@ -514,6 +649,32 @@ bool assist_pause(Context& ctx) {
 	return true;
 }
 
+// XBEGIN, ar1 has the fallback rip
+bool assist_xbegin(Context& ctx) {
+	ctx.eip = ctx.reg_nextrip;
+	rtm_begin(ctx, ctx.reg_ar1);
+	return true;
+}
+
+// XEND outside of a transaction is #GP(0)
+bool assist_xend(Context& ctx) {
+	if (!rtm_commit(ctx)) {
+		ctx.eip = ctx.reg_selfrip;
+		ctx.propagate_x86_exception(EXCEPTION_x86_gp_fault, 0);
+		return true;
+	}
+
+	ctx.eip = ctx.reg_nextrip;
+	return true;
+}
+
+// XABORT, ar1 has the imm8 abort code
+bool assist_xabort(Context& ctx) {
+	ctx.eip = ctx.reg_nextrip;
+	rtm_explicit_abort(ctx, ctx.reg_ar1);
+	return true;
+}
+
 // TODO : Convert RDTSC to Light Assist
 bool assist_rdtsc(Context& ctx) {
     ASSIST_IN_QEMU(helper_rdtsc);
@@ -1447,11 +1608,25 @@ bool TraceDecoder::decode_complex() {
     int addrsizeshift = (use64 ? (addrsize_prefix ? 2 : 3) : (addrsize_prefix ? 1 : 2));
     prefixes &= ~PFX_LOCK;
 
+    /* repne movs/stos repeat like rep, the prefix only matters to cmps/scas */
+    bool fast_string = (rep && config.fast_strings && !dirflag &&
+        (op == 0xa4 || op == 0xa5 || op == 0xaa || op == 0xab));
+
     //
     // Only support REP prefix if it is the very first
     // insn in the BB; otherwise emit a split branch.
     //
-    if (rep && (!first_insn_in_bb())) {
+    if (fast_string) {
+      //
+      // Fast strings: forward rep movs/stos moves a page bounded chunk per
+      // assist and restarts at the same rip until rcx is exhausted. The
+      // core models the timing as line sized memory requests.
+      //
+      this << TransOp(OP_mov, REG_ar1, REG_zero, REG_imm, REG_zero, 3,
+          op | (sizeshift << 8) | (addrsizeshift << 12));
+      microcode_assist(ASSIST_REP_STRING, ripstart, rip);
+      end_of_block = 1;
+    } else if (rep && (!first_insn_in_bb())) {
       split_before();
     } else {
       // This is the very first x86 insn in the block, so translate it as a loop!
@@ -1493,11 +1668,6 @@ bool TraceDecoder::decode_complex() {
         original value of %rsp at trace entry.
 
         */
-        if (rep && rep != PFX_REPZ) {
-			MakeInvalid();
-			break;
-		}
-
         this << TransOp(OP_ld,     REG_temp0, REG_rsi,    REG_imm,  REG_zero,  sizeshift, 0);
         this << TransOp(OP_st,     REG_mem,   REG_rdi,    REG_imm,  REG_temp0, sizeshift, 0);
         this << TransOp(OP_add,    REG_rsi,   REG_rsi,    REG_imm,   REG_zero,  addrsizeshift, increment);
@@ -1644,6 +1814,26 @@ bool TraceDecoder::decode_complex() {
     break;
   }
 
+  case 0xc6 ... 0xc7: {
+    // xabort imm8, xbegin rel16/rel32
+    if ((!config.rtm) | (modrm.mod != 3) | (modrm.rm != 0)) MakeInvalid();
+
+    if (op == 0xc6) {
+      DECODE(iform, ra, b_mode);
+      EndOfDecode();
+      immediate(REG_ar1, 0, ra.imm.imm & 0xff);
+      microcode_assist(ASSIST_XABORT, ripstart, rip);
+    } else {
+      DECODE(iform, ra, v_mode);
+      EndOfDecode();
+      abs_code_addr_immediate(REG_ar1, 3, (Waddr)rip + (W64s)ra.imm.imm);
+      microcode_assist(ASSIST_XBEGIN, ripstart, rip);
+    }
+
+    end_of_block = 1;
+    break;
+  }
+
   case 0xca ... 0xcb: {
     // ret far, with and without pop count (not supported)
     MakeInvalid();
@@ -2322,6 +2512,23 @@ bool TraceDecoder::decode_complex() {
 				EndOfDecode();
 				this << TransOp(OP_collcc, REG_temp0, REG_zf, REG_cf,
 						REG_of, 3, 0, 0, FLAGS_DEFAULT_ALU);
+				if (modrm.reg == 2 && (modrm.rm == 5 || modrm.rm == 6)) {
+					if (!config.rtm)
+						goto invalid_opcode;
+					if (modrm.rm == 5) { // XEND
+						microcode_assist(ASSIST_XEND, ripstart, rip);
+						end_of_block = 1;
+					} else { // XTEST: ZF set outside of a transaction
+						ldp = new TransOp(OP_ld, REG_temp0, REG_ctx, REG_imm,
+								REG_zero, 2, offsetof_t(Context, rtm_depth));
+						ldp->internal = 1;
+						this << *ldp;
+						delete ldp;
+						this << TransOp(OP_and, REG_temp0, REG_temp0, REG_temp0,
+								REG_zero, 2, 0, 0, FLAGS_DEFAULT_ALU);
+					}
+					break;
+				}
 				switch(modrm.rm) {
 					case 0: // VMRUN
 						if (!(hflags & HF_SVME_MASK) || !pe)
@@ -31,6 +31,8 @@ struct BasicBlockChunkListHashtableLinkManager {
 typedef SelfHashtable<W64, BasicBlockChunkList, 16384, BasicBlockChunkListHashtableLinkManager> BasicBlockPageCache;
 
 BasicBlockPageCache bbpages;
+
+CodePageBitmap smc_code_pages;
 CycleTimer translate_timer("translate");
 
 ofstream bbcache_dump_file;
@@ -109,6 +111,8 @@ const assist_func_t assistid_to_func[ASSIST_COUNT] = {
     assist_sti,
     assist_cli,
     assist_enter,
+    // Fast strings
+    assist_rep_string,
     // Control register updates
     assist_cpuid,
     assist_rdtsc,
@@ -170,6 +174,9 @@ const assist_func_t assistid_to_func[ASSIST_COUNT] = {
     // Halt
     assist_halt,
     assist_pause,
+    assist_xbegin,
+    assist_xend,
+    assist_xabort,
 };
 
 const char* assist_names[ASSIST_COUNT] = {
@@ -234,6 +241,8 @@ const char* assist_names[ASSIST_COUNT] = {
   "sti",
   "cli",
   "enter",
+  // Fast strings
+  "rep_string",
   // Control register updates
   "cpuid",
   "rdtsc",
@@ -295,6 +304,9 @@ const char* assist_names[ASSIST_COUNT] = {
   // HLT
   "halt",
   "pause",
+  "xbegin",
+  "xend",
+  "xabort",
 };
 
 int assist_index(assist_func_t assist) {
@@ -1699,6 +1711,7 @@ bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
     if (logable(10) | log_code_page_ops) ptl_logfile << "Remove bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) from low page list ", pagelist, ": loc ", bb->mfnlo_loc.chunk, ":", bb->mfnlo_loc.index, endl;
     assert(pagelist);
     pagelist->remove(bb->mfnlo_loc);
+    if (pagelist->empty()) smc_code_pages.remove(bb->rip.mfnlo);
 
     int page_crossing = ((lowbits(bb->rip, 12) + (bb->bytes-1)) >> 12);
     if (page_crossing) {
@@ -1706,6 +1719,7 @@ bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
         if (logable(10) | log_code_page_ops) ptl_logfile << "Remove bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) from high page list ", pagelist, ": loc ", bb->mfnhi_loc.chunk, ":", bb->mfnhi_loc.index, endl;
         assert(pagelist);
         pagelist->remove(bb->mfnhi_loc);
+        if (pagelist->empty()) smc_code_pages.remove(bb->rip.mfnhi);
     }
 
     remove(bb);
@@ -1747,6 +1761,7 @@ void BasicBlockCache::add_page(BasicBlock* bb)
         pagelist->refcount--;
     }
     pagelist->add(bb, bb->mfnlo_loc);
+    smc_code_pages.add(bb->rip.mfnlo);
 }
 
 //
@@ -1763,11 +1778,12 @@ bool BasicBlockCache::invalidate_page(Waddr mfn, int reason) {
 
     BasicBlockChunkList* pagelist = bbpages.get(mfn);
 
-    if (logable(3) | log_code_page_ops) ptl_logfile << "Invalidate page mfn ", mfn, ": pagelist ", pagelist, " has ", (pagelist ? pagelist->count() : 0), " entries", endl; // (dirty? ", smc_isdirty(mfn), ")", endl;
-
-    smc_cleardirty(mfn);
+    if (logable(3) | log_code_page_ops) ptl_logfile << "Invalidate page mfn ", mfn, ": pagelist ", pagelist, " has ", (pagelist ? pagelist->count() : 0), " entries (dirty? ", smc_isdirty(mfn), ")", endl;
 
-    if unlikely (!pagelist) return 0;
+    if unlikely (!pagelist) {
+        smc_code_pages.remove(mfn);
+        return 0;
+    }
 
     int n = 0;
     BasicBlockChunkList::Iterator iter(pagelist);
@@ -1785,7 +1801,12 @@ bool BasicBlockCache::invalidate_page(Waddr mfn, int reason) {
     //  assert(n == oldcount);
     //  assert(pagelist->count() == 0);
 
+    //
+    // The page stays dirty until all its blocks are gone, so a failed
+    // invalidation is retried by the next SMC check.
+    //
     pagelist->clear();
+    smc_code_pages.remove(mfn);
     W64 ct = bbpages.count;
     DECODERSTAT->pagecache.count = ct;
     DECODERSTAT->pagecache.invalidates[reason]++;
@@ -1952,6 +1973,58 @@ void BasicBlockCache::flush(int8_t context_id) {
     }
 }
 
+//
+// A guest TLB flush (CR3 write, INVLPG of a global page, ...) does not
+// change any code bytes: keep the decoded blocks and check each one
+// against the new translation the next time it is fetched.
+//
+void BasicBlockCache::flush_tlb(int8_t context_id) {
+    tlb_epoch++;
+
+    if (DECODERSTAT)
+        DECODERSTAT->tlb_flush.flushes++;
+}
+
+//
+// Check a block decoded before the last TLB flush: its rip must still map
+// to the same physical pages, in the same mode, and hold the same bytes.
+// Blocks that fail must be invalidated and decoded again.
+//
+bool BasicBlockCache::revalidate(Context& ctx, BasicBlock* bb, const RIPVirtPhys& rvp) {
+    bool valid = (bb->bytes > 0) & (bb->rip.mfnlo != RIPVirtPhys::INVALID) &
+        (bb->rip.use64 == rvp.use64) & (bb->rip.kernel == rvp.kernel) &
+        (bb->rip.df == rvp.df);
+
+    if likely (valid) {
+        byte insnbuf[MAX_BB_BYTES];
+        PageFaultErrorCode pfec;
+        Waddr faultaddr;
+
+        valid = (ctx.copy_from_vm(insnbuf, bb->rip, bb->bytes, pfec,
+                    faultaddr, true) == bb->bytes);
+
+        if likely (valid) {
+            CRC32 crc;
+            crc.update(insnbuf, bb->bytes);
+
+            valid = (ctx.code_mfn(bb->rip) == bb->rip.mfnlo) &
+                (ctx.code_mfn(bb->rip + bb->bytes - 1) == bb->rip.mfnhi) &
+                ((W32)crc == bb->code_crc);
+        }
+    }
+
+    if (logable(5) | log_code_page_ops) ptl_logfile << "Revalidate bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) after TLB flush: ", (valid ? "retained" : "remapped"), endl;
+
+    if unlikely (!valid) return false;
+
+    bb->tlb_epoch = tlb_epoch;
+
+    if (DECODERSTAT)
+        DECODERSTAT->tlb_flush.retained++;
+
+    return true;
+}
+
 bool assist_exec_page_fault(Context& ctx) {
     //
     // We need to check if faultaddr is now a valid page, since the page tables
@@ -2325,9 +2398,10 @@ ostream& printflags(ostream& os, W64 flags) {
 //
 // Translate one basic block. This function always returns
 // a BasicBlock, except in the very rare case where one or
-// both covered mfns are dirty and must be invalidated, and
-// the invalidation fails because some other object has
-// references to some of the basic blocks.
+// both covered mfns are dirty or remapped and must be
+// invalidated, and the invalidation fails because some other
+// object has references to some of the basic blocks: then
+// it sets 'busy' and the caller retries later.
 //
 BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     if unlikely ((rvp.rip == config.start_log_at_rip) && (rvp.rip != 0xffffffffffffffffULL)) {
@@ -2335,21 +2409,47 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
         logenable = 1;
     }
 
-    /*
-       if unlikely (smc_isdirty(rvp.mfnlo)) {
-       if (logable(5) | log_code_page_ops) ptl_logfile << "Pre-invalidate low mfn for ", rvp, endl;
-       if unlikely (!invalidate_page(rvp.mfnlo, INVALIDATE_REASON_DIRTY)) return NULL;
-       }
+    busy = false;
 
-       if unlikely (smc_isdirty(rvp.mfnhi)) {
-       if (logable(5) | log_code_page_ops) ptl_logfile << "Pre-invalidate high mfn for ", rvp, endl;
-       if unlikely (!invalidate_page(rvp.mfnhi, INVALIDATE_REASON_DIRTY)) return NULL;
-       }
-       */
+    //
+    // Stores wrote a page this block is decoded from. Cores that don't
+    // check the dirty bit at commit (Atom) only see the new code here.
+    // A page whose blocks are still in the pipeline stays dirty.
+    //
+    if unlikely (smc_isdirty(rvp.mfnlo)) {
+        if (logable(5) | log_code_page_ops) ptl_logfile << "Pre-invalidate low mfn for ", rvp, endl;
+        if unlikely (!invalidate_page(rvp.mfnlo, INVALIDATE_REASON_DIRTY) &&
+                smc_isdirty(rvp.mfnlo)) {
+            busy = true;
+            return NULL;
+        }
+    }
+
+    if unlikely (smc_isdirty(rvp.mfnhi)) {
+        if (logable(5) | log_code_page_ops) ptl_logfile << "Pre-invalidate high mfn for ", rvp, endl;
+        if unlikely (!invalidate_page(rvp.mfnhi, INVALIDATE_REASON_DIRTY) &&
+                smc_isdirty(rvp.mfnhi)) {
+            busy = true;
+            return NULL;
+        }
+    }
 
     BasicBlock* bb = get(rvp);
     if likely (bb && bb->context_id == ctx.cpu_index) {
-        return bb;
+        if likely (bb->tlb_epoch == tlb_epoch)
+            return bb;
+
+        if (revalidate(ctx, bb, rvp))
+            return bb;
+
+        //
+        // The stale block's uops must not run under the new mapping: if
+        // the pipeline still references it, fetch waits until it's freed.
+        //
+        if unlikely (!invalidate(bb, INVALIDATE_REASON_REMAP)) {
+            busy = true;
+            return NULL;
+        }
     }
 
     bb = NULL;
@@ -2387,6 +2487,20 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     trans.bb.hitcount = 0;
     trans.bb.predcount = 0;
     bb = trans.bb.clone();
+
+    //
+    // Record the physical pages and bytes the block was decoded from,
+    // so it can survive guest TLB flushes (see revalidate()).
+    //
+    {
+        CRC32 crc;
+        crc.update(insnbuf, bb->bytes);
+        bb->code_crc = crc;
+        bb->tlb_epoch = tlb_epoch;
+        bb->rip.mfnlo = ctx.code_mfn(bb->rip);
+        bb->rip.mfnhi = (bb->bytes) ?
+            ctx.code_mfn(bb->rip + bb->bytes - 1) : bb->rip.mfnlo;
+    }
     //
     // Acquire a reference to the new basic block right away,
     // since we make allocations below that might reclaim it
@@ -2421,6 +2535,7 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     // to somehow lock it with a refcount to prevent this.
     //
     pagelist->add(bb, bb->mfnlo_loc);
+    smc_code_pages.add(bb->rip.mfnlo);
     if (logable(5) | log_code_page_ops) ptl_logfile << "Add bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) to low page list ", pagelist, ": loc ", bb->mfnlo_loc.chunk, ":", bb->mfnlo_loc.index, endl;
 
     int page_crossing = ((lowbits(bb->rip, 12) + (bb->bytes-1)) >> 12);
@@ -2438,6 +2553,7 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
         }
         pagelisthi->refcount++;
         pagelisthi->add(bb, bb->mfnhi_loc);
+        smc_code_pages.add(bb->rip.mfnhi);
         if (logable(5) | log_code_page_ops) ptl_logfile << "Add bb ", bb, " (", bb->rip, ", ", bb->bytes, " bytes) to high page list ", pagelisthi, ": loc ", bb->mfnhi_loc.chunk, ":", bb->mfnhi_loc.index, endl;
         pagelisthi->refcount--;
     }
@@ -555,6 +555,9 @@ bool TraceDecoder::decode_fast() {
   }
 
   case 0xc6 ... 0xc7: {
+    /* COMPLEX: handle xabort and xbegin in the complex decoder */
+    if (modrm.reg == 7) return false;
+
     /* move reg_or_mem,imm8|imm16|imm32|imm64 (signed imm for 32-bit to 64-bit form) */
     int bytemode = bit(op, 0) ? v_mode : b_mode;
     DECODE(eform, rd, bytemode); DECODE(iform, ra, bytemode);
@@ -356,6 +356,8 @@ enum {
   ASSIST_STI,
   ASSIST_CLI,
   ASSIST_ENTER,
+  // Fast strings
+  ASSIST_REP_STRING,
   // Control register updates
   ASSIST_CPUID,
   ASSIST_RDTSC,
@@ -417,6 +419,10 @@ enum {
   // HLT
   ASSIST_HLT,
   ASSIST_PAUSE,
+  // RTM
+  ASSIST_XBEGIN,
+  ASSIST_XEND,
+  ASSIST_XABORT,
   ASSIST_COUNT,
 };
 
@@ -506,6 +512,8 @@ bool assist_iret64(Context& ctx);
 bool assist_sti(Context& ctx);
 bool assist_cli(Context& ctx);
 bool assist_enter(Context& ctx);
+// Fast strings
+bool assist_rep_string(Context& ctx);
 // Control registe rupdates
 bool assist_cpuid(Context& ctx);
 bool assist_rdtsc(Context& ctx);
@@ -567,6 +575,10 @@ bool assist_barrier(Context& ctx);
 // HLT
 bool assist_halt(Context& ctx);
 bool assist_pause(Context& ctx);
+// RTM
+bool assist_xbegin(Context& ctx);
+bool assist_xend(Context& ctx);
+bool assist_xabort(Context& ctx);
 
 // Light weight Assist
 W64 l_assist_sti(Context& ctx, W64 ra, W64 rb, W64 rc, W16 raflags, W16 rbflags, W16 rcflags, W16& flags);
@@ -624,12 +636,15 @@ enum {
   INVALIDATE_REASON_RECLAIM,
   INVALIDATE_REASON_DIRTY,
   INVALIDATE_REASON_EMPTY,
+  INVALIDATE_REASON_REMAP,
   INVALIDATE_REASON_COUNT
 };
 
 struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager> {
   BasicBlockCache(): SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager>() {
       cpuid = cpuid_counter++;
+      tlb_epoch = 0;
+      busy = false;
   }
 
   BasicBlock* translate(Context& ctx, const RIPVirtPhys& rvp);
@@ -642,7 +657,11 @@ struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_S
   void add_page(BasicBlock* bb);
   int reclaim(size_t reqbytes = 0, int urgency = 0);
   void flush(int8_t context_id);
+  void flush_tlb(int8_t context_id);
+  bool revalidate(Context& ctx, BasicBlock* bb, const RIPVirtPhys& rvp);
   W8 cpuid;
+  W32 tlb_epoch; // Bumped by each guest TLB flush
+  bool busy; // Last translate() waits for a stale or modified block still in use
   static W8 cpuid_counter;
 
   ostream& print(ostream& os);
@@ -657,7 +676,7 @@ static const char* decode_type_names[DECODE_TYPE_COUNT] = {
 };
 
 static const char* invalidate_reason_names[INVALIDATE_REASON_COUNT] = {
-  "smc", "dma", "spurious", "reclaim", "dirty", "empty"
+  "smc", "dma", "spurious", "reclaim", "dirty", "empty", "remap"
 };
 
 /* Decoder Stats */
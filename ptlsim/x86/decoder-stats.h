@@ -65,6 +65,18 @@ struct DecoderStats : public Statable
     cache bbcache;
     cache pagecache;
 
+    struct tlb_flush : public Statable
+    {
+        StatObj<W64> flushes;
+        StatObj<W64> retained;
+
+        tlb_flush(Statable *parent)
+            : Statable("tlb_flush", parent)
+              , flushes("flushes", this)
+              , retained("retained", this)
+        { }
+    } tlb_flush;
+
     StatObj<W64> reclaim_rounds;
 
     DecoderStats(Statable *parent)
@@ -75,6 +87,7 @@ struct DecoderStats : public Statable
           , page_crossings(this)
           , bbcache("bbcache", this)
           , pagecache("pagecache", this)
+          , tlb_flush(this)
           , reclaim_rounds("reclaim_rounds", this)
     { }
 };
@@ -799,6 +799,55 @@ enum {
 	CONTEXT_RUNNING = 1,
 };
 
+//
+// Host virtual page to guest physical page map, filled from QEMU's
+// tlb_set_page() and looked up on every translated simulator access.
+// A RAM page has the same guest physical address for all VCPUs, so a
+// single table is shared by all contexts. It is an open-addressing
+// table with linear probing; its size is bounded by twice the number
+// of host pages that ever back guest memory.
+//
+struct HostPhysPageMap {
+  struct Entry {
+    W64 hostpage;   // 0 marks an empty slot
+    W64 guestpage;
+  };
+
+  Entry* table;
+  W64 mask;
+  W64 count;
+
+  HostPhysPageMap() : table(NULL), mask(0), count(0) { }
+
+  static W64 slotof(W64 hostpage, W64 mask) {
+    return ((hostpage >> TARGET_PAGE_BITS) * 0x9e3779b97f4a7c15ULL >> 20) & mask;
+  }
+
+  bool lookup(Waddr host_vaddr, Waddr& guest_paddr) const {
+    W64 hostpage = host_vaddr & TARGET_PAGE_MASK;
+
+    if unlikely (!table) return false;
+
+    for (W64 slot = slotof(hostpage, mask);; slot = (slot + 1) & mask) {
+      const Entry& e = table[slot];
+      if likely (e.hostpage == hostpage) {
+        guest_paddr = e.guestpage + (host_vaddr & ~TARGET_PAGE_MASK);
+        return true;
+      }
+      if unlikely (!e.hostpage) return false;
+    }
+  }
+
+  void add(Waddr host_vaddr, Waddr guest_paddr);
+  void remove(Waddr host_vaddr);
+  void reset();
+
+private:
+  void resize(W64 slots);
+};
+
+extern HostPhysPageMap hvirt_gphys_map;
+
 struct Context: public CPUX86State {
 
   bool use32;
@@ -814,6 +863,7 @@ struct Context: public CPUX86State {
   W64 insns_at_last_mode_switch;
   W64 user_instructions_commited;
   W64 kernel_instructions_commited;
+  W64 l1_read_misses; // loads and fetches that missed the L1 caches
   W64 exception;
   W64 reg_trace;
   W64 reg_selfrip;
@@ -829,8 +879,16 @@ struct Context: public CPUX86State {
   W64 reg_fpstack;
   W64 page_fault_addr;
   W64 exec_fault_addr;
-  map<Waddr, Waddr> hvirt_gphys_map;
 
+  // Guest physical range moved by the last fast-string assist, for the
+  // core's timing model (fast_string_bytes is 0 if nothing was moved)
+  W64 fast_string_src;
+  W64 fast_string_dst;
+  W32 fast_string_bytes;
+
+  // Restricted transactional memory, see sim/rtm.cpp
+  W32 rtm_depth; // XBEGIN nesting, 0 outside of a transaction
+  byte rtm_doomed; // aborted, registers are not rolled back yet
 
   void change_runstate(int new_state) { running = new_state; }
 
@@ -844,10 +902,72 @@ struct Context: public CPUX86State {
 	  eip = eip - segs[R_CS].base;
   }
 
+  //
+  // Register groups that setup_qemu_switch() and setup_ptlsim_switch()
+  // convert between QEMU and PTLsim formats (flags, x87 top/tags and
+  // the CPL/CS derived mode), as left by the last full conversion to
+  // PTLsim format. While both sides still match this snapshot the
+  // conversions are no-ops and are skipped. eip moves on every switch,
+  // so it is not part of the snapshot and is always converted. Flags are
+  // still converted between reg_flags and cc_src/cc_op, both sides don't
+  // share one lazy flags format.
+  //
+  struct ArchSyncState {
+    W64 cs_base;
+    W64 reg_flags;
+    W64 reg_fptos;
+    W64 reg_fptag;
+    W64 cc_src;
+    W64 fptags;
+    W32 internal_eflags;
+    W32 cc_op;
+    W32 df;
+    W32 fpstt;
+    W32 hflags;
+    bool kernel_mode;
+    bool stable; // setup_qemu_switch() reproduces the QEMU side as well
+  } arch_sync;
+
+  W64 fptags_word() const {
+      return *(W64*)fptags;
+  }
+
+  bool arch_sync_matches() const {
+      const ArchSyncState& s = arch_sync;
+      return (s.cs_base == segs[R_CS].base) &
+          (s.reg_flags == reg_flags) & (s.reg_fptos == reg_fptos) &
+          (s.reg_fptag == reg_fptag) & (s.cc_src == cc_src) &
+          (s.fptags == fptags_word()) &
+          (s.internal_eflags == internal_eflags) & (s.cc_op == cc_op) &
+          (s.df == (W32)df) & (s.fpstt == fpstt) & (s.hflags == hflags) &
+          (s.kernel_mode == kernel_mode);
+  }
+
+  void arch_sync_save() {
+      ArchSyncState& s = arch_sync;
+      s.cs_base = segs[R_CS].base;
+      s.reg_flags = reg_flags;
+      s.reg_fptos = reg_fptos;
+      s.reg_fptag = reg_fptag;
+      s.cc_src = cc_src;
+      s.fptags = fptags_word();
+      s.internal_eflags = internal_eflags;
+      s.cc_op = cc_op;
+      s.df = df;
+      s.fpstt = fpstt;
+      s.hflags = hflags;
+      s.kernel_mode = kernel_mode;
+      s.stable = false;
+  }
+
   void setup_qemu_switch() {
 	  old_eip = eip;
 	  set_eip_qemu();
 	  set_cpu_env((CPUX86State*)this);
+
+      if likely (arch_sync.stable && arch_sync_matches())
+          return;
+
 	  W64 flags = reg_flags;
 	  // Set the 2nd bit to 1 for compatibility
 	  flags = (flags | FLAG_INV);
@@ -855,14 +975,25 @@ struct Context: public CPUX86State {
           // load_eflags(flags, 0x00);
           cc_op = CC_OP_EFLAGS;
 	  fpstt = reg_fptos >> 3;
-	  foreach(i, 8) {
-          fptags[i] = !((reg_fptag >> (8*i)) & 0x1);
-	  }
+      // fptags[i] is 1 for an empty register, reg_fptag byte i is 1 if valid
+      *(W64*)fptags = ~reg_fptag & 0x0101010101010101ULL;
+
+      // Converting back would give the same PTLsim state again
+      arch_sync.stable = arch_sync_matches();
   }
 
   void setup_ptlsim_switch() {
 
 	  set_cpu_env((CPUX86State*)this);
+	  eip = eip + segs[R_CS].base;
+	  reg_fpstack = ((W64)&(fpregs[0].mmx.q));
+	  reg_trace = 0;
+
+      if likely (arch_sync.stable && arch_sync_matches()) {
+          update_mode(kernel_mode);
+          return;
+      }
+
 	  // W64 flags = compute_eflags();
 
 	  // Clear the 2nd and 3rd bit as its used by PTLSim to indicate if
@@ -872,16 +1003,12 @@ struct Context: public CPUX86State {
           internal_eflags = cc_src & (FLAG_NOT_WAIT_INV);
           internal_eflags |= (df & DF_MASK);
           reg_flags = internal_eflags;
-	  eip = eip + segs[R_CS].base;
       cs_segment_updated();
 	  update_mode((hflags & HF_CPL_MASK) == 0);
 	  reg_fptos = fpstt << 3;
-	  reg_fpstack = ((W64)&(fpregs[0].mmx.q));
-	  reg_trace = 0;
-      reg_fptag = 0;
-	  foreach(i, 8) {
-          reg_fptag |= ((W64(!fptags[i])) << (8*i));
-	  }
+      reg_fptag = ~fptags_word() & 0x0101010101010101ULL;
+
+      arch_sync_save();
 
       // by default disable the interrupt handling flag
       // When the core detects the interrupt and calls
@@ -912,19 +1039,61 @@ struct Context: public CPUX86State {
 	  return &tlb_table[mmu_idx][index];
   }
 
+  /*
+   * Return the host pointer backing 'bytes' bytes of guest memory at
+   * 'virtaddr' if QEMU's softmmu TLB for 'mmu_idx' maps that page to
+   * plain guest RAM. Returns NULL on a TLB miss, for MMIO, watchpoint
+   * or not-dirty (code) pages, and for accesses crossing a page; such
+   * accesses must take the normal QEMU path. QEMU invalidates these
+   * entries itself on TLB flush and memory map changes, so the
+   * pointer is only valid until the next switch to QEMU.
+   */
+  byte* get_host_ram_ptr(Waddr virtaddr, int bytes, int mmu_idx,
+          bool store, bool is_code = false) {
+      if unlikely ((lowbits(virtaddr, TARGET_PAGE_BITS) + bytes) >
+              TARGET_PAGE_SIZE)
+          return NULL;
+
+      int index = (virtaddr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
+      CPUTLBEntry& entry = tlb_table[mmu_idx][index];
+      target_ulong tlb_addr = (store) ? entry.addr_write :
+          ((is_code) ? entry.addr_code : entry.addr_read);
+
+      /* Any flag bit in tlb_addr means QEMU has to handle this access */
+      if likely ((virtaddr & TARGET_PAGE_MASK) == tlb_addr)
+          return (byte*)(virtaddr + entry.addend);
+
+      return NULL;
+  }
+
   int get_phys_memory_address(Waddr host_vaddr, Waddr &guest_paddr)
   {
-    map<Waddr, Waddr>::iterator it;
-    if ((it = hvirt_gphys_map.find(host_vaddr & TARGET_PAGE_MASK)) == hvirt_gphys_map.end())
+    if unlikely (!hvirt_gphys_map.lookup(host_vaddr, guest_paddr))
     {
       guest_paddr=0;
       return -1;
     }
 
-    guest_paddr = it->second + (host_vaddr & ~TARGET_PAGE_MASK);
     return 0;
   }
 
+  // Physical page of the code byte at virtaddr, RIPVirtPhys::INVALID if
+  // QEMU's TLB has no RAM mapping for it
+  Waddr code_mfn(Waddr virtaddr) {
+      byte* host = get_host_ram_ptr(virtaddr, 1,
+              cpu_mmu_index((CPUState*)this), false, true);
+      Waddr paddr;
+
+      if unlikely (!host || get_phys_memory_address((Waddr)host, paddr) < 0)
+          return RIPVirtPhys::INVALID;
+
+      Waddr mfn = paddr >> TARGET_PAGE_BITS;
+      if unlikely (mfn >= RIPVirtPhys::INVALID)
+          return RIPVirtPhys::INVALID;
+
+      return mfn;
+  }
+
   int copy_from_vm(void* target, Waddr source, int bytes) ;
 
   W64 loadvirt(Waddr virtaddr, int sizeshift=3);
@@ -935,59 +1104,12 @@ struct Context: public CPUX86State {
   W64 storemask(Waddr paddr, W64 data, byte bytemask) ;
   W64 store_internal(Waddr addr, W64 data, byte bytemask);
 
-  // SMC code support
-  bool smc_isdirty(Waddr virtaddr) {
-
-	  CPUTLBEntry *tlb_entry = get_tlb_entry(virtaddr);;
-	  W64 tlb_addr = tlb_entry->addr_code;
-
-	  if((virtaddr & TARGET_PAGE_MASK) != tlb_addr) {
-		  // if not tlb entry found assume we are not modifying
-		  // and code
-		  return false;
-	  }
-
-	  target_ulong ram_addr;
-	  ram_addr = (tlb_addr & TARGET_PAGE_MASK) + tlb_entry->addend;
-      ram_addr = qemu_ram_addr_from_host_nofail((void*)ram_addr);
-		  // (unsigned long)(phys_ram_base);
-
-	  bool dirty = false;
-	  setup_qemu_switch();
-	  dirty = cpu_physical_memory_is_dirty(ram_addr);
-	  setup_ptlsim_switch();
-
-	  return dirty;
-  }
-
-  void smc_setdirty(Waddr virtaddr) {
-
-	  CPUTLBEntry *tlb_entry = get_tlb_entry(virtaddr);;
-	  W64 tlb_addr = tlb_entry->addr_code;
-
-	  if((virtaddr & TARGET_PAGE_MASK) != tlb_addr) {
-		  // if not tlb entry found assume we are not modifying
-		  // and code
-		  return ;
-	  }
-
-	  target_ulong ram_addr;
-	  ram_addr = (tlb_addr & TARGET_PAGE_MASK) + tlb_entry->addend;
-      ram_addr = qemu_ram_addr_from_host_nofail((void*)ram_addr);
-		  // (unsigned long)(phys_ram_base);
-
-	  setup_qemu_switch();
-	  cpu_physical_memory_set_dirty(ram_addr);
-	  setup_ptlsim_switch();
-  }
-
-  void smc_cleardirty(Waddr virtaddr) {
-	  //TODO
-  }
-
   void init();
 
-  Context() : invalid_reg(-1), reg_zero(0), reg_ctx((Waddr)this) { }
+  Context() : invalid_reg(-1), reg_zero(0), reg_ctx((Waddr)this),
+    rtm_depth(0), rtm_doomed(0) {
+      arch_sync.stable = false;
+  }
 
   W64 virt_to_pte_phys_addr(Waddr virtaddr, byte& level);
 
@@ -1706,6 +1828,8 @@ struct BasicBlockBase {
   W64 lastused;
   W64 lasttarget;
   W16 context_id;
+  W32 code_crc;   // CRC32 of the x86 bytes, checked after TLB flushes
+  W32 tlb_epoch;  // BasicBlockCache::tlb_epoch it was last checked at
 
   void acquire() {
     refcount++;
@@ -1775,20 +1899,88 @@ const char* light_assist_name(light_assist_func_t func);
 int light_assist_index(assist_func_t func);
 void update_light_assist_stats(int idx);
 
-// Self Modifying code Support with QEMU
-static inline bool smc_isdirty(Waddr page_addr) {
-	return cpu_physical_memory_is_dirty(page_addr);
+//
+// Self modifying code support: the physical pages that hold decoded basic
+// blocks (i.e. have a BasicBlockChunkList entry), and which of them were
+// written since their blocks were last invalidated. Committed stores check
+// this directly, without switching to QEMU's dirty bitmap.
+//
+struct CodePageBitmap {
+  // Leaves of 32768 pages (128 MB) are only allocated for code
+  static const int LEAF_SHIFT = 15;
+  static const int ROOT_SIZE = 1 << (28 - LEAF_SHIFT);
+
+  struct Leaf {
+    bitvec<1 << LEAF_SHIFT> code;
+    bitvec<1 << LEAF_SHIFT> dirty;
+  };
+
+  Leaf* leaves[ROOT_SIZE];
+
+  CodePageBitmap() { setzero(leaves); }
+
+  Leaf* leafof(Waddr mfn) const {
+    return (mfn < RIPVirtPhys::INVALID) ? leaves[mfn >> LEAF_SHIFT] : NULL;
+  }
+
+  void add(Waddr mfn) {
+    if unlikely (mfn >= RIPVirtPhys::INVALID) return;
+
+    Leaf*& leaf = leaves[mfn >> LEAF_SHIFT];
+    if unlikely (!leaf) leaf = new Leaf();
+    leaf->code.set(lowbits(mfn, LEAF_SHIFT));
+  }
+
+  void remove(Waddr mfn) {
+    Leaf* leaf = leafof(mfn);
+    if (!leaf) return;
+    leaf->code.reset(lowbits(mfn, LEAF_SHIFT));
+    leaf->dirty.reset(lowbits(mfn, LEAF_SHIFT));
+  }
+
+  bool iscode(Waddr mfn) const {
+    Leaf* leaf = leafof(mfn);
+    return (leaf) ? leaf->code.test(lowbits(mfn, LEAF_SHIFT)) : false;
+  }
+
+  bool isdirty(Waddr mfn) const {
+    Leaf* leaf = leafof(mfn);
+    return (leaf) ? leaf->dirty.test(lowbits(mfn, LEAF_SHIFT)) : false;
+  }
+
+  // Only pages with decoded code become dirty
+  void setdirty(Waddr mfn) {
+    Leaf* leaf = leafof(mfn);
+    if likely (!leaf) return;
+    if (leaf->code.test(lowbits(mfn, LEAF_SHIFT)))
+      leaf->dirty.set(lowbits(mfn, LEAF_SHIFT));
+  }
+
+  void cleardirty(Waddr mfn) {
+    Leaf* leaf = leafof(mfn);
+    if (leaf) leaf->dirty.reset(lowbits(mfn, LEAF_SHIFT));
+  }
+};
+
+extern CodePageBitmap smc_code_pages;
+
+static inline bool smc_isdirty(Waddr mfn) {
+  return smc_code_pages.isdirty(mfn);
+}
+
+// Called with the physical address of every committed store
+static inline void smc_setdirty(Waddr physaddr) {
+  smc_code_pages.setdirty(physaddr >> 12);
 }
 
-static inline void smc_setdirty(Waddr page_addr) {
-	cpu_physical_memory_set_dirty(page_addr);
+// Same for stores written straight to the host address of guest RAM
+static inline void smc_setdirty_host(const void* host) {
+  Waddr paddr;
+  if likely (hvirt_gphys_map.lookup((Waddr)host, paddr)) smc_setdirty(paddr);
 }
 
-static inline void smc_cleardirty(Waddr page_addr) {
-	// This function will reset the page flags to be
-	// mark as protected for modification so that
-	// next write to code page will be detected
-	tlb_protect_code(page_addr);
+static inline void smc_cleardirty(Waddr mfn) {
+  smc_code_pages.cleardirty(mfn);
 }
 
 extern const char* sizeshift_names[4];
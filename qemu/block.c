@@ -697,6 +697,37 @@ void bdrv_close_all(void)
     }
 }
 
+#ifdef MARSS_QEMU
+/* Close and open every image again, so that a forked simulation job reads
+ * the image metadata from disk instead of using the copy cached by its
+ * parent. Temporary -snapshot images are already unlinked and are kept. */
+int bdrv_reopen_all(void)
+{
+    BlockDriverState *bs;
+    char filename[sizeof(bs->filename)];
+    BlockDriver *drv;
+    int flags, ret = 0;
+
+    QTAILQ_FOREACH(bs, &bdrv_states, list) {
+        if (!bs->drv || bs->is_temporary) {
+            continue;
+        }
+
+        pstrcpy(filename, sizeof(filename), bs->filename);
+        flags = bs->open_flags;
+        drv = bs->drv;
+
+        bdrv_close(bs);
+        if (bdrv_open(bs, filename, flags, drv) < 0) {
+            fprintf(stderr, "qemu: could not reopen '%s'\n", filename);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+#endif
+
 /* make a BlockDriverState anonymous by removing from bdrv_state list.
    Also, NULL terminate the device_name to prevent double remove */
 void bdrv_make_anon(BlockDriverState *bs)
@@ -146,6 +146,9 @@ BlockDriverAIOCB *bdrv_aio_ioctl(BlockDriverState *bs,
 int bdrv_flush(BlockDriverState *bs);
 void bdrv_flush_all(void);
 void bdrv_close_all(void);
+#ifdef MARSS_QEMU
+int bdrv_reopen_all(void);
+#endif
 
 int bdrv_discard(BlockDriverState *bs, int64_t sector_num, int nb_sectors);
 int bdrv_has_zero_init(BlockDriverState *bs);
@@ -2602,6 +2602,10 @@ void cpu_register_physical_memory_offset(target_phys_addr_t start_addr,
     ram_addr_t orig_size = size;
     subpage_t *subpage;
 
+#ifdef MARSS_QEMU
+    ptl_register_io_mem_base(phys_offset, start_addr);
+#endif
+
     cpu_notify_set_memory(start_addr, size, phys_offset);
 
     if (phys_offset == IO_MEM_UNASSIGNED) {
@@ -2868,6 +2872,7 @@ ram_addr_t qemu_ram_alloc_from_ptr(DeviceState *dev, const char *name,
             if (!new_block->host) {
                 new_block->host = qemu_vmalloc(size);
                 qemu_madvise(new_block->host, size, QEMU_MADV_MERGEABLE);
+                qemu_madvise(new_block->host, size, QEMU_MADV_HUGEPAGE);
             }
 #else
             fprintf(stderr, "-mem-path option unsupported\n");
@@ -2883,6 +2888,9 @@ ram_addr_t qemu_ram_alloc_from_ptr(DeviceState *dev, const char *name,
             new_block->host = qemu_vmalloc(size);
 #endif
             qemu_madvise(new_block->host, size, QEMU_MADV_MERGEABLE);
+            /* Transparent huge pages for anonymous RAM only, file backed
+             * blocks use the page size of their -mem-path mount */
+            qemu_madvise(new_block->host, size, QEMU_MADV_HUGEPAGE);
         }
     }
 
@@ -3096,6 +3104,9 @@ static void notdirty_mem_writeb(void *opaque, target_phys_addr_t ram_addr,
 #endif
     }
     stb_p(qemu_get_ram_ptr(ram_addr), val);
+#ifdef MARSS_QEMU
+    ptl_phys_memory_written(qemu_get_ram_ptr(ram_addr), 1);
+#endif
     dirty_flags |= (0xff & ~CODE_DIRTY_FLAG);
     cpu_physical_memory_set_dirty_flags(ram_addr, dirty_flags);
     /* we remove the notdirty callback only if the code has been
@@ -3116,6 +3127,9 @@ static void notdirty_mem_writew(void *opaque, target_phys_addr_t ram_addr,
 #endif
     }
     stw_p(qemu_get_ram_ptr(ram_addr), val);
+#ifdef MARSS_QEMU
+    ptl_phys_memory_written(qemu_get_ram_ptr(ram_addr), 2);
+#endif
     dirty_flags |= (0xff & ~CODE_DIRTY_FLAG);
     cpu_physical_memory_set_dirty_flags(ram_addr, dirty_flags);
     /* we remove the notdirty callback only if the code has been
@@ -3136,6 +3150,9 @@ static void notdirty_mem_writel(void *opaque, target_phys_addr_t ram_addr,
 #endif
     }
     stl_p(qemu_get_ram_ptr(ram_addr), val);
+#ifdef MARSS_QEMU
+    ptl_phys_memory_written(qemu_get_ram_ptr(ram_addr), 4);
+#endif
     dirty_flags |= (0xff & ~CODE_DIRTY_FLAG);
     cpu_physical_memory_set_dirty_flags(ram_addr, dirty_flags);
     /* we remove the notdirty callback only if the code has been
@@ -3680,6 +3697,9 @@ void cpu_physical_memory_rw(target_phys_addr_t addr, uint8_t *buf,
                 /* RAM case */
                 ptr = qemu_get_ram_ptr(addr1);
                 memcpy(ptr, buf, l);
+#ifdef MARSS_QEMU
+                ptl_phys_memory_written(ptr, l);
+#endif
                 if (!cpu_physical_memory_is_dirty(addr1)) {
                     /* invalidate code */
                     tb_invalidate_phys_page_range(addr1, addr1 + l, 0);
@@ -3882,6 +3902,9 @@ void cpu_physical_memory_unmap(void *buffer, target_phys_addr_t len,
     if (buffer != bounce.buffer) {
         if (is_write) {
             ram_addr_t addr1 = qemu_ram_addr_from_host_nofail(buffer);
+#ifdef MARSS_QEMU
+            ptl_phys_memory_written(buffer, access_len);
+#endif
             while (access_len) {
                 unsigned l;
                 l = TARGET_PAGE_SIZE;
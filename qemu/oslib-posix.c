@@ -60,10 +60,23 @@ void *qemu_memalign(size_t alignment, size_t size)
     return ptr;
 }
 
+#if defined(__linux__) && defined(__x86_64__)
+   /* Use 2MB alignment so transparent hugepages can be used by KVM
+      and by the simulator's accesses to guest RAM */
+#  define QEMU_VMALLOC_ALIGN (2 * 1024 * 1024)
+#else
+#  define QEMU_VMALLOC_ALIGN getpagesize()
+#endif
+
 /* alloc shared memory pages */
 void *qemu_vmalloc(size_t size)
 {
-    return qemu_memalign(getpagesize(), size);
+    size_t align = QEMU_VMALLOC_ALIGN;
+
+    if (size < align) {
+        align = getpagesize();
+    }
+    return qemu_memalign(align, size);
 }
 
 void qemu_vfree(void *ptr)
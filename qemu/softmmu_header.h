@@ -16,6 +16,10 @@
  * You should have received a copy of the GNU Lesser General Public
  * License along with this library; if not, see <http://www.gnu.org/licenses/>.
  */
+#ifdef MARSS_QEMU
+#include <ptl-qemu.h>
+#endif
+
 #if DATA_SIZE == 8
 #define SUFFIX q
 #define USUFFIX q
@@ -142,6 +146,11 @@ static inline void glue(glue(st, SUFFIX), MEMSUFFIX)(target_ulong ptr, RES_TYPE
     } else {
         physaddr = addr + env->tlb_table[mmu_idx][page_index].addend;
         glue(glue(st, SUFFIX), _raw)((uint8_t *)physaddr, v);
+#ifdef MARSS_QEMU
+        /* Helpers of simulated instructions may write decoded code */
+        if (unlikely(in_simulation))
+            ptl_phys_memory_written((void *)physaddr, DATA_SIZE);
+#endif
     }
 }
 
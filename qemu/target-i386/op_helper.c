@@ -1041,6 +1041,9 @@ void helper_syscall(int next_eip_addend)
     if (!(env->efer & MSR_EFER_SCE)) {
         raise_exception_err(EXCP06_ILLOP, 0);
     }
+#ifdef MARSS_QEMU
+    ptl_kernel_syscall(env);
+#endif
     selector = (env->star >> 32) & 0xffff;
     if (env->hflags & HF_LMA_MASK) {
         int code64;
@@ -1141,6 +1144,9 @@ void helper_sysret(int dflag)
         env->eflags |= IF_MASK;
         cpu_x86_set_cpl(env, 3);
     }
+#ifdef MARSS_QEMU
+    ptl_kernel_exit(env);
+#endif
 }
 #endif
 
@@ -1241,6 +1247,12 @@ static void handle_even_inj(int intno, int is_int, int error_code,
 void do_interrupt(int intno, int is_int, int error_code,
                   target_ulong next_eip, int is_hw)
 {
+#ifdef MARSS_QEMU
+    /* An exception inside a transaction only aborts it */
+    if (ptl_rtm_interrupt(env, is_hw))
+        return;
+    ptl_kernel_interrupt(env, intno, is_int, is_hw);
+#endif
     if (qemu_loglevel_mask(CPU_LOG_INT)) {
         if ((env->cr[0] & CR0_PE_MASK)) {
             static int count;
@@ -2813,6 +2825,9 @@ void helper_iret_protected(int shift, int next_eip)
         helper_ret_protected(shift, 1, 0);
     }
     env->hflags2 &= ~HF2_NMI_MASK;
+#ifdef MARSS_QEMU
+    ptl_kernel_exit(env);
+#endif
 }
 
 void helper_lret_protected(int shift, int addend)
@@ -2825,6 +2840,9 @@ void helper_sysenter(void)
     if (env->sysenter_cs == 0) {
         raise_exception_err(EXCP0D_GPF, 0);
     }
+#ifdef MARSS_QEMU
+    ptl_kernel_syscall(env);
+#endif
     env->eflags &= ~(VM_MASK | IF_MASK | RF_MASK);
     cpu_x86_set_cpl(env, 0);
 
@@ -2890,6 +2908,9 @@ void helper_sysexit(int dflag)
     }
     ESP = ECX;
     EIP = EDX;
+#ifdef MARSS_QEMU
+    ptl_kernel_exit(env);
+#endif
 }
 
 #if defined(CONFIG_USER_ONLY)
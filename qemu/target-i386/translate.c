@@ -5084,6 +5084,34 @@ static target_ulong disas_insn(DisasContext *s, target_ulong pc_start)
             ot = dflag + OT_WORD;
         modrm = ldub_code(s->pc++);
         mod = (modrm >> 6) & 3;
+#ifdef MARSS_QEMU
+        /*
+         * xabort and xbegin. Transactions are only simulated: in emulation
+         * xbegin aborts at once with status 0 and xabort is a nop. Without
+         * -rtm they are undefined, like on CPUs without RTM.
+         */
+        if (modrm == 0xf8) {
+            if (!ptl_rtm_enabled())
+                goto illegal_op;
+            if ((b & 1) == 0) {
+                insn_get(s, OT_BYTE);
+                break;
+            }
+            if (dflag)
+                tval = (int32_t)insn_get(s, OT_LONG);
+            else
+                tval = (int16_t)insn_get(s, OT_WORD);
+            tval += s->pc - s->cs_base;
+            if (s->dflag == 0)
+                tval &= 0xffff;
+            else if (!CODE64(s))
+                tval &= 0xffffffff;
+            gen_op_movl_T0_0();
+            gen_op_mov_reg_T0(OT_LONG, R_EAX);
+            gen_jmp(s, tval);
+            break;
+        }
+#endif
         if (mod != 3) {
             s->rip_offset = insn_const_size(ot);
             gen_lea_modrm(s, modrm, &reg_addr, &offset_addr);
@@ -7082,6 +7110,20 @@ static target_ulong disas_insn(DisasContext *s, target_ulong pc_start)
         case 2: /* lgdt */
         case 3: /* lidt */
             if (mod == 3) {
+#ifdef MARSS_QEMU
+                /* Emulation never has a transaction open, see xbegin */
+                if ((op == 2) && (rm == 5 || rm == 6) && !ptl_rtm_enabled())
+                    goto illegal_op;
+                if (op == 2 && rm == 5) { /* xend */
+                    gen_exception(s, EXCP0D_GPF, pc_start - s->cs_base);
+                    break;
+                }
+                if (op == 2 && rm == 6) { /* xtest */
+                    tcg_gen_movi_tl(cpu_cc_src, CC_Z);
+                    s->cc_op = CC_OP_EFLAGS;
+                    break;
+                }
+#endif
                 if (s->cc_op != CC_OP_DYNAMIC)
                     gen_op_set_cc_op(s->cc_op);
                 gen_jmp_im(pc_start - s->cs_base);